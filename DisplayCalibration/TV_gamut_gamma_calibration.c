@@ -1,11 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
-
-// 데이터 구조체 정의
-typedef struct { float matrix[3][3]; } GamutTable;
-typedef struct { int entries[256]; } GammaTable;
-typedef struct { double x, y, Y; } Measurement;
+#include "TV_gamut_gamma_calibration.h"
 
 // ---------------------------------------------------------
 // 보조 함수: 3x3 행렬 역산 (Cramer's Rule)
@@ -86,49 +82,340 @@ GamutTable set_tv_gamut(Measurement measured[4]) {
 }
 
 // ---------------------------------------------------------
-// 2. Gamma 교정 함수: 11점 측정 기반 256 LUT 생성
+// 2. Gamma 교정 함수: 측정점 기반 256 LUT 생성
 // ---------------------------------------------------------
-GammaTable set_tv_gamma(Measurement steps[11]) {
+#define GAMMA_TARGET 2.2
+
+// 목표 감마 곡선의 상대 휘도 (level: 0~255)
+static double gamma_target_shape(double level) {
+    return pow(level / 255.0, GAMMA_TARGET);
+}
+
+// Fritsch-Carlson 기울기: 데이터가 단조이면 보간 곡선도 단조 (오버슈트 없음)
+static void monotone_slopes(const double x[], const double y[], int n, double m[]) {
+    double d[GAMMA_MAX_PATCHES];
+    if (n < 2) return;
+    for (int k = 0; k < n - 1; k++) d[k] = (y[k + 1] - y[k]) / (x[k + 1] - x[k]);
+
+    // (1) 내부 점은 양쪽 기울기 평균, 극값(부호 변화)에서는 0
+    m[0] = d[0];
+    m[n - 1] = d[n - 2];
+    for (int k = 1; k < n - 1; k++) {
+        m[k] = (d[k - 1] * d[k] <= 0) ? 0.0 : 0.5 * (d[k - 1] + d[k]);
+    }
+
+    // (2) 구간별로 alpha^2 + beta^2 <= 9 가 되도록 기울기 축소
+    for (int k = 0; k < n - 1; k++) {
+        if (d[k] == 0.0) {
+            m[k] = m[k + 1] = 0.0;
+            continue;
+        }
+        double a = m[k] / d[k], b = m[k + 1] / d[k];
+        double r = a * a + b * b;
+        if (r > 9.0) {
+            double tau = 3.0 / sqrt(r);
+            m[k] = tau * a * d[k];
+            m[k + 1] = tau * b * d[k];
+        }
+    }
+}
+
+// 구간 k의 3차 Hermite 값
+static double hermite(const double x[], const double y[], const double m[], int k, double xv) {
+    double h = x[k + 1] - x[k], t = (xv - x[k]) / h, t2 = t * t, t3 = t2 * t;
+    return (2 * t3 - 3 * t2 + 1) * y[k] + (t3 - 2 * t2 + t) * h * m[k]
+         + (-2 * t3 + 3 * t2) * y[k + 1] + (t3 - t2) * h * m[k + 1];
+}
+
+// 측정점 정리: 계조순 정렬, 같은 계조는 마지막 값 사용, 휘도는 단조 증가로 보정 (노이즈로 인한 역전 제거)
+static int prepare_points(const double levels[], const Measurement steps[], int n, double x[], double y[]) {
+    int count = 0;
+    for (int i = 0; i < n && count < GAMMA_MAX_PATCHES; i++) {
+        int k = count;
+        while (k > 0 && x[k - 1] > levels[i]) {
+            x[k] = x[k - 1];
+            y[k] = y[k - 1];
+            k--;
+        }
+        if (k > 0 && x[k - 1] == levels[i]) { // 같은 계조 재측정: 덮어쓰고 밀어둔 점을 되돌림
+            y[k - 1] = steps[i].Y;
+            for (int j = k; j < count; j++) { x[j] = x[j + 1]; y[j] = y[j + 1]; }
+            continue;
+        }
+        x[k] = levels[i];
+        y[k] = steps[i].Y;
+        count++;
+    }
+    for (int k = 1; k < count; k++) {
+        if (y[k] < y[k - 1]) y[k] = y[k - 1];
+    }
+    return count;
+}
+
+// 단조 3차 곡선의 역함수를 한 번의 순방향 탐색으로 계산하는 커서
+// 목표 휘도가 감소하지 않는 순서로 호출하면 구간 탐색이 앞으로만 진행되어 측정점을 한 번만 훑음
+typedef struct {
+    const double *x, *y;
+    double m[GAMMA_MAX_PATCHES];
+    int n, seg;
+    double c1, c2, c3; // 구간 곡선 y(t) = y[seg] + c1 t + c2 t^2 + c3 t^3, t = 0~1
+} MonotoneInverse;
+
+static void monotone_inverse_init(MonotoneInverse *inv, const double x[], const double y[], int n) {
+    inv->x = x;
+    inv->y = y;
+    inv->n = n;
+    inv->seg = -1;
+    monotone_slopes(x, y, n, inv->m);
+}
+
+// 목표 휘도를 내는 입력 계조 (측정 범위 밖은 끝점으로 제한)
+static double monotone_inverse(MonotoneInverse *inv, double target_Y) {
+    const double *x = inv->x, *y = inv->y;
+    int n = inv->n;
+    if (target_Y <= y[0]) return x[0];
+    if (target_Y >= y[n - 1]) return x[n - 1];
+
+    // (1) 목표 휘도가 속한 구간: 현재 구간부터 앞으로만 이동
+    int k = (inv->seg < 0) ? 0 : inv->seg;
+    while (k < n - 2 && y[k + 1] < target_Y) k++;
+    if (k != inv->seg) {
+        double h = x[k + 1] - x[k], dy = y[k + 1] - y[k];
+        inv->seg = k;
+        inv->c1 = h * inv->m[k];
+        inv->c2 = 3 * dy - h * (2 * inv->m[k] + inv->m[k + 1]);
+        inv->c3 = -2 * dy + h * (inv->m[k] + inv->m[k + 1]);
+    }
+
+    // (2) 구간 안에서 Newton 반복으로 역산 (구간을 벗어나면 이분법)
+    double c1 = inv->c1, c2 = inv->c2, c3 = inv->c3;
+    double r = target_Y - y[k];
+    double lo = 0.0, hi = 1.0, t = r / (y[k + 1] - y[k]);
+    for (int iter = 0; iter < 30; iter++) {
+        double f = ((c3 * t + c2) * t + c1) * t - r;
+        if (f > 0) hi = t; else lo = t;
+        double df = (3 * c3 * t + 2 * c2) * t + c1;
+        double next = (df > 0) ? t - f / df : 0.5 * (lo + hi);
+        if (next <= lo || next >= hi) next = 0.5 * (lo + hi);
+        if (fabs(next - t) < 1e-9) break; // 16비트 출력에도 충분한 정밀도
+        t = next;
+    }
+    return x[k] + t * (x[k + 1] - x[k]);
+}
+
+// 정리된 측정점의 보간 곡선을 역산하여 LUT 생성: 목표 휘도를 내는 입력 계조
+static GammaTable build_gamma_lut(const double x[], const double y[], int n) {
     GammaTable lut;
-    double target_gamma = 2.2;
-    double L_max = steps[10].Y; // 100% White 휘도
+    MonotoneInverse inv;
+    double L_max = y[n - 1]; // 100% White 휘도
 
+    monotone_inverse_init(&inv, x, y, n);
     for (int i = 0; i < 256; i++) {
-        // (1) 해당 계조의 목표 휘도 계산
-        double target_Y = pow((double)i / 255.0, target_gamma) * L_max;
-
-        // (2) 측정 데이터 구간 찾기
-        int seg = 0;
-        for (int j = 0; j < 10; j++) {
-            if (target_Y >= steps[j].Y && target_Y <= steps[j+1].Y) {
-                seg = j;
-                break;
+        // 목표 휘도 -> 입력 계조, 반올림, 범위 제한 및 저장
+        double corrected_val = monotone_inverse(&inv, gamma_target_shape(i) * L_max);
+        lut.entries[i] = (int)fmax(0, fmin(255, floor(corrected_val + 0.5)));
+    }
+    return lut;
+}
+
+GammaTable set_tv_gamma_points(const double levels[], const Measurement steps[], int n) {
+    double x[GAMMA_MAX_PATCHES], y[GAMMA_MAX_PATCHES];
+    int count = prepare_points(levels, steps, n, x, y);
+    if (count < 2) { // 보간 불가: 보정 없음
+        GammaTable identity;
+        for (int i = 0; i < 256; i++) identity.entries[i] = i;
+        return identity;
+    }
+    return build_gamma_lut(x, y, count);
+}
+
+GammaTable set_tv_gamma(Measurement steps[11]) {
+    double levels[11];
+    for (int j = 0; j <= 10; j++) levels[j] = j * 25.5; // 10% 단위 계조
+    return set_tv_gamma_points(levels, steps, 11);
+}
+
+// 구간 [x[k], x[k+1]]의 LUT 오차 추정 (코드값)과 다음 측정 계조
+// 구간 중점에서 단조 3차 보간과 "목표 감마 모양" 보간을 비교: 패널이 목표 곡선을 따르는(잔차가 평탄한)
+// 구간은 두 값이 같아 건너뛰고, 잔차가 휘는 구간일수록 차이가 커짐. 휘도 차이를 기울기로 나누어 코드값으로 환산
+static double segment_error(const double x[], const double y[], const double m[], int k, int *level) {
+    int a = (int)x[k], b = (int)x[k + 1];
+    if (b - a < 2) return 0.0; // 사이에 측정할 계조가 없음
+    *level = (a + b) / 2;
+
+    double rise = y[k + 1] - y[k];
+    if (rise <= 0) return 0.0; // 휘도 변화 없는 평탄 구간: 보정 불가하므로 측정하지 않음
+    double cubic = hermite(x, y, m, k, *level);
+    double ta = gamma_target_shape(a), tb = gamma_target_shape(b);
+    double shaped = y[k] + rise * (gamma_target_shape(*level) - ta) / (tb - ta);
+    return fabs(cubic - shaped) / (rise / (b - a));
+}
+
+int set_tv_gamma_adaptive(GammaMeasureFn measure, void *user, int max_patches, double tolerance, GammaTable *lut) {
+    double x[GAMMA_MAX_PATCHES], y[GAMMA_MAX_PATCHES], m[GAMMA_MAX_PATCHES];
+    Measurement meas;
+    if (measure == NULL || lut == NULL || max_patches < 2 || max_patches > GAMMA_MAX_PATCHES || tolerance < 0) return 0;
+
+    // (1) 0%, 100%부터 측정
+    if (!measure(user, 0, &meas)) return 0;
+    x[0] = 0;
+    y[0] = meas.Y;
+    if (!measure(user, 255, &meas)) return 0;
+    x[1] = 255;
+    y[1] = meas.Y;
+    int n = 2;
+
+    // (2) 추정 오차가 가장 큰 구간의 중점을 측정하여 삽입
+    while (n < max_patches) {
+        double ys[GAMMA_MAX_PATCHES];
+        for (int k = 0; k < n; k++) ys[k] = (k > 0 && y[k] < ys[k - 1]) ? ys[k - 1] : y[k];
+        monotone_slopes(x, ys, n, m);
+
+        int worst = -1, level = 0;
+        double worst_error = tolerance;
+        for (int k = 0; k < n - 1; k++) {
+            int candidate = 0;
+            double e = segment_error(x, ys, m, k, &candidate);
+            if (e > worst_error) {
+                worst_error = e;
+                worst = k;
+                level = candidate;
             }
         }
+        if (worst < 0) break; // 모든 구간이 허용 오차 이내
 
-        // (3) 선형 보간 (Linear Interpolation)
-        // x축: 10% 단위 index (0, 25.5, 51 ... 255)
-        double x0 = seg * 25.5;
-        double x1 = (seg + 1) * 25.5;
-        double y0 = steps[seg].Y;
-        double y1 = steps[seg + 1].Y;
-
-        double corrected_val;
-        if (fabs(y1 - y0) < 1e-9) {
-            corrected_val = x0;
-        } else {
-            corrected_val = x0 + (target_Y - y0) * (x1 - x0) / (y1 - y0);
+        if (!measure(user, level, &meas)) return 0;
+        for (int k = n; k > worst + 1; k--) {
+            x[k] = x[k - 1];
+            y[k] = y[k - 1];
         }
+        x[worst + 1] = level;
+        y[worst + 1] = meas.Y;
+        n++;
+    }
 
-        // (4) 범위 제한 및 저장
-        lut.entries[i] = (int)fmax(0, fmin(255, corrected_val));
+    // (3) 측정점으로 LUT 생성
+    for (int k = 1; k < n; k++) {
+        if (y[k] < y[k - 1]) y[k] = y[k - 1];
     }
-    return lut;
+    *lut = build_gamma_lut(x, y, n);
+    return n;
 }
 
 // ---------------------------------------------------------
-// 메인 테스트 함수
+// 3. 고정밀 1D LUT: 채널별, 다중 EOTF 목표, 10/12/16비트 출력
 // ---------------------------------------------------------
+#define PQ_M1 0.1593017578125 // SMPTE ST 2084
+#define PQ_M2 78.84375
+#define PQ_C1 0.8359375
+#define PQ_C2 18.8515625
+#define PQ_C3 18.6875
+#define HLG_A 0.17883277      // ITU-R BT.2100 HLG
+#define HLG_B 0.28466892
+#define HLG_C 0.55991073
+
+// PQ 신호 -> 절대 휘도 (cd/m2)
+static double pq_eotf(double e) {
+    double p = pow(e, 1.0 / PQ_M2);
+    double num = fmax(p - PQ_C1, 0.0), den = PQ_C2 - PQ_C3 * p;
+    return 10000.0 * pow(num / den, 1.0 / PQ_M1);
+}
+
+// HLG 신호 -> 장면 선형광 (0~1)
+static double hlg_inverse_oetf(double e) {
+    return (e <= 0.5) ? e * e / 3.0 : (exp((e - HLG_C) / HLG_A) + HLG_B) / 12.0;
+}
+
+// 목표 곡선 파라미터 (측정 램프의 블랙/화이트 휘도로 결정)
+typedef struct {
+    LutEotf eotf;
+    double gamma;
+    double black, white; // 측정 램프의 0%, 100% 휘도
+    double peak;         // PQ/HLG 기준 피크 휘도
+    double a, b;         // BT.1886 계수
+    double beta;         // HLG 블랙 리프트
+} LutTarget;
+
+static int lut_target_init(LutTarget *t, const LutConfig *cfg, double black, double white) {
+    *t = (LutTarget){0};
+    t->eotf = cfg->eotf;
+    t->black = black;
+    t->white = white;
+    t->peak = (cfg->peak > 0) ? cfg->peak : white;
+    switch (cfg->eotf) {
+        case LUT_EOTF_POWER:
+            t->gamma = (cfg->gamma > 0) ? cfg->gamma : 2.2;
+            return 1;
+        case LUT_EOTF_BT1886: { // ITU-R BT.1886 Annex 1: L = a * max(V + b, 0)^gamma
+            t->gamma = (cfg->gamma > 0) ? cfg->gamma : 2.4;
+            double lw = pow(white, 1.0 / t->gamma), lb = pow(fmax(black, 0.0), 1.0 / t->gamma);
+            if (lw <= lb) return 0;
+            t->a = pow(lw - lb, t->gamma);
+            t->b = lb / (lw - lb);
+            return 1;
+        }
+        case LUT_EOTF_PQ:
+            return 1;
+        case LUT_EOTF_HLG: // BT.2100: 시스템 감마는 피크 휘도로 결정, 블랙 리프트로 0% 신호가 패널 블랙에 맞춰짐
+            t->gamma = (cfg->gamma > 0) ? cfg->gamma : 1.2 + 0.42 * log10(t->peak / 1000.0);
+            t->beta = sqrt(3.0 * pow(fmax(black, 0.0) / t->peak, 1.0 / t->gamma));
+            return t->gamma > 0;
+    }
+    return 0;
+}
+
+// 입력 신호 s(0~1)의 목표 휘도 (s에 대해 단조 증가)
+static double lut_target_Y(const LutTarget *t, double s) {
+    switch (t->eotf) {
+        case LUT_EOTF_POWER:
+            return pow(s, t->gamma) * t->white;
+        case LUT_EOTF_BT1886:
+            return t->a * pow(fmax(s + t->b, 0.0), t->gamma);
+        case LUT_EOTF_PQ: // 절대 휘도; 피크를 넘는 신호는 램프 최대값으로 제한
+            return fmin(pq_eotf(s) / t->peak, 1.0) * t->white;
+        case LUT_EOTF_HLG:
+            return pow(hlg_inverse_oetf((1.0 - t->beta) * s + t->beta), t->gamma) * t->white;
+    }
+    return 0.0;
+}
+
+int generate_channel_lut(const LutConfig *cfg, const double levels[], const Measurement steps[], int n, uint16_t entries[]) {
+    double x[GAMMA_MAX_PATCHES], y[GAMMA_MAX_PATCHES];
+    MonotoneInverse inv;
+    LutTarget target;
+
+    if (cfg == NULL || levels == NULL || steps == NULL || entries == NULL) return 0;
+    if (cfg->size < 2 || cfg->size > LUT_MAX_SIZE || cfg->bits < 8 || cfg->bits > 16) return 0;
+
+    // (1) 측정점 정렬·단조 보정 후 목표 곡선 결정
+    int count = prepare_points(levels, steps, n, x, y);
+    if (count < 2 || y[count - 1] <= 0 || !lut_target_init(&target, cfg, y[0], y[count - 1])) return 0;
+
+    // (2) 입력 신호 순서대로 목표 휘도 -> 구동 신호 (목표가 단조 증가하므로 측정점을 한 번만 훑음)
+    double code_max = (double)((1 << cfg->bits) - 1);
+    monotone_inverse_init(&inv, x, y, count);
+    for (int i = 0; i < cfg->size; i++) {
+        double s = (double)i / (cfg->size - 1);
+        double drive = monotone_inverse(&inv, lut_target_Y(&target, s));
+        entries[i] = (uint16_t)fmax(0.0, fmin(code_max, floor(drive * code_max + 0.5)));
+    }
+    return 1;
+}
+
+// ---------------------------------------------------------
+// 메인 테스트 함수 (벤치마크 등 라이브러리로 링크할 때는 TV_GAMUT_GAMMA_NO_MAIN 정의)
+// ---------------------------------------------------------
+#ifndef TV_GAMUT_GAMMA_NO_MAIN
+// 예시 패널: 감마 2.4, 블랙 0.1 cd/m2, 80% 이상 하이라이트 압축 (실제로는 패치 표시 후 센서 측정)
+static int example_panel(void *user, int level, Measurement *out) {
+    (void)user;
+    double L = pow(level / 255.0, 2.4);
+    if (L > 0.8) L = 0.8 + (L - 0.8) * 0.5;
+    out->x = 0.3127; out->y = 0.3290;
+    out->Y = 0.1 + L * 100.0;
+    return 1;
+}
+
 int main() {
     // 예시 데이터: 실제로는 센서 측정값이 들어감
     Measurement gamut_meas[4] = {
@@ -148,9 +435,29 @@ int main() {
     GamutTable gmt = set_tv_gamut(gamut_meas);
     GammaTable gma = set_tv_gamma(gamma_meas);
 
+    // 적응형 측정: 최대 11패치, LUT 오차 0.5 코드 이내
+    GammaTable adaptive;
+    int patches = set_tv_gamma_adaptive(example_panel, NULL, 11, 0.5, &adaptive);
+
+    // 고정밀 LUT: 같은 11점 램프(0.1~100 cd/m2)로 10비트 BT.1886 1024, 12비트 PQ 4096 항목
+    double levels[11];
+    for(int i=0; i<=10; i++) {
+        levels[i] = i / 10.0;
+        gamma_meas[i].Y = 0.1 + pow(i/10.0, 2.2) * 99.9;
+    }
+    static uint16_t bt1886[1024], pq[4096];
+    LutConfig bt1886_cfg = { LUT_EOTF_BT1886, 0, 0, 1024, 10 };
+    LutConfig pq_cfg = { LUT_EOTF_PQ, 0, 100.0, 4096, 12 };
+    int bt1886_ok = generate_channel_lut(&bt1886_cfg, levels, gamma_meas, 11, bt1886);
+    int pq_ok = generate_channel_lut(&pq_cfg, levels, gamma_meas, 11, pq);
+
     // 결과 확인 (샘플)
     printf("Gamut Matrix [0][0]: %f\n", gmt.matrix[0][0]);
     printf("Gamma LUT [128]: %d\n", gma.entries[128]);
+    printf("Adaptive Gamma LUT [128]: %d (%d patches)\n", adaptive.entries[128], patches);
+    if (bt1886_ok) printf("BT.1886 10-bit LUT [512]: %u\n", bt1886[512]);
+    if (pq_ok) printf("PQ 12-bit LUT [2048]: %u\n", pq[2048]);
 
     return 0;
 }
+#endif // TV_GAMUT_GAMMA_NO_MAIN
@@ -0,0 +1,58 @@
+#ifndef TV_GAMUT_GAMMA_CALIBRATION_H
+#define TV_GAMUT_GAMMA_CALIBRATION_H
+
+#include <stdint.h>
+
+// 데이터 구조체 정의
+typedef struct { float matrix[3][3]; } GamutTable;
+typedef struct { int entries[256]; } GammaTable;
+typedef struct { double x, y, Y; } Measurement;
+
+#define GAMMA_MAX_PATCHES 256 // 감마 측정에 쓸 수 있는 최대 패치 수 (계조 0~255 각 1회)
+#define LUT_MAX_SIZE 65536    // generate_channel_lut()의 최대 LUT 항목 수
+
+// 고정밀 LUT 목표 곡선
+typedef enum {
+    LUT_EOTF_POWER = 0,  // 순수 감마: Y = s^gamma * White (gamma 기본 2.2, set_tv_gamma와 동일)
+    LUT_EOTF_BT1886 = 1, // ITU-R BT.1886: 패널 블랙/화이트 기준 감마 곡선 (gamma 기본 2.4)
+    LUT_EOTF_PQ = 2,     // SMPTE ST 2084: 절대 휘도, 피크를 넘는 신호는 패널 최대로 제한
+    LUT_EOTF_HLG = 3     // ITU-R BT.2100 HLG: 피크 휘도로 시스템 감마 결정 (gamma 0이면 1.2 + 0.42 log10(peak/1000))
+} LutEotf;
+
+// 고정밀 LUT 설정
+typedef struct {
+    LutEotf eotf;
+    double gamma; // POWER/BT.1886/HLG 지수, 0 = 기본값
+    double peak;  // PQ/HLG: 100% White 휘도 (cd/m2), 0 = 측정 램프의 최대값. 채널별 램프에는 White 휘도를 지정
+    int size;     // LUT 항목 수 (2~LUT_MAX_SIZE), 예: 1024, 4096
+    int bits;     // 출력 비트 수 (8~16), 예: 10, 12
+} LutConfig;
+
+// 3x3 행렬 역산 (성공 시 1, 특이 행렬이면 0)
+int invert_matrix_3x3(float m[3][3], float inv[3][3]);
+
+// R, G, B, White 측정값(x, y, Y)으로 BT.709 교정 행렬 산출
+GamutTable set_tv_gamut(Measurement measured[4]);
+
+// 0~100% 11점 측정값으로 감마 2.2 목표 256 LUT 생성
+GammaTable set_tv_gamma(Measurement steps[11]);
+
+// 임의 계조 n점 측정값으로 감마 2.2 목표 256 LUT 생성
+// levels: 패치 계조(0~255, 오름차순, 마지막 점이 100% White), 점 사이는 Fritsch-Carlson 단조 3차 보간
+GammaTable set_tv_gamma_points(const double levels[], const Measurement steps[], int n);
+
+// 패치 측정 콜백: 계조 level(0~255) 패치를 표시하고 측정 (성공 시 1, 실패 시 0)
+typedef int (*GammaMeasureFn)(void *user, int level, Measurement *out);
+
+// 적응형 감마 측정: 0%, 100%에서 시작해 LUT 추정 오차가 가장 큰 구간에 패치를 추가
+// 추정 오차(코드값)가 tolerance 이하가 되거나 max_patches(2~GAMMA_MAX_PATCHES)에 도달하면 종료
+// 반환: 측정한 패치 수, 인자 오류나 측정 실패 시 0 (lut는 변경하지 않음)
+int set_tv_gamma_adaptive(GammaMeasureFn measure, void *user, int max_patches, double tolerance, GammaTable *lut);
+
+// 한 채널(또는 Gray) 램프 측정값으로 고정밀 1D LUT 생성
+// levels: 패치 신호(0~1, 0과 1 포함), steps: 해당 패치의 측정 휘도 (cd/m2), n: 2~GAMMA_MAX_PATCHES
+// entries[i]: 입력 신호 i/(size-1)에서 목표 휘도를 내는 구동 신호 (0 ~ 2^bits-1)
+// 반환: 성공 시 1, 설정 오류나 측정값 부족 시 0
+int generate_channel_lut(const LutConfig *cfg, const double levels[], const Measurement steps[], int n, uint16_t entries[]);
+
+#endif // TV_GAMUT_GAMMA_CALIBRATION_H
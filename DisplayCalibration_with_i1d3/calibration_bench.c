@@ -0,0 +1,223 @@
+/* Microbenchmarks for the calibration control paths. Output: CSV "name,ns_per_op,ops_per_s" */
+#define _DEFAULT_SOURCE // clock_gettime()
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "display_calibration_api.h"
+#include "panel_sim.h"
+#include "TV_gamut_gamma_calibration.h"
+
+#define BENCH_MIN_NS 50000000.0 // Grow the iteration count until one run takes 50 ms
+#define BENCH_RUNS 5            // Report the fastest of this many runs
+
+typedef void (*bench_fn)(void *arg, long iterations);
+
+static volatile double bench_sink; // Keeps results observable so loops are not optimized away
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void run_bench(const char *name, bench_fn fn, void *arg) {
+    long iterations = 1;
+    double elapsed;
+
+    for (;;) {
+        double start = now_ns();
+        fn(arg, iterations);
+        elapsed = now_ns() - start;
+        if (elapsed >= BENCH_MIN_NS || iterations > (1L << 40)) break;
+        iterations *= (elapsed > BENCH_MIN_NS / 100) ? 2 : 10;
+    }
+
+    double best = elapsed / iterations;
+    for (int run = 1; run < BENCH_RUNS; run++) {
+        double start = now_ns();
+        fn(arg, iterations);
+        double ns = (now_ns() - start) / iterations;
+        if (ns < best) best = ns;
+    }
+    printf("%s,%.2f,%.0f\n", name, best, 1e9 / best);
+}
+
+// --- Calibration step against the emulator ---
+
+typedef struct {
+    i1d3_emulator *emu;
+    Calibrator cal;
+    CalibratorMode mode;
+    double matrix[3][3];
+} step_fixture;
+
+// Panel model: BT.709 primaries scaled by the Calibrator's current RGB gains
+static void gain_panel(void *user, double xyz[3]) {
+    const Calibrator *cal = user;
+    static const double m709[3][3] = {
+        {0.4124, 0.3576, 0.1805},
+        {0.2126, 0.7152, 0.0722},
+        {0.0193, 0.1192, 0.9505}
+    };
+    for (int i = 0; i < 3; i++) {
+        xyz[i] = 0;
+        for (int j = 0; j < 3; j++) xyz[i] += m709[i][j] * cal->current_gain[j] * (100.0 / 192.0);
+    }
+}
+
+// One Calibrator_perform_calibration_step without the TV write and settle sleep:
+// measure reply -> XYZ -> xyY -> gain update
+static void bench_calibrator_step(void *arg, long iterations) {
+    step_fixture *f = arg;
+    uint8_t cmd[64] = {0x04, 0x00, 0x9F, 0x24, 0x00, 0x00, 0x07, 0xE8, 0x03}; // 0.2 s
+    uint8_t reply[64];
+    int64_t delay_us;
+    double xyz[3], sum = 0;
+    i1d3_color_results res;
+    CalibratedColorValue color;
+
+    for (long i = 0; i < iterations; i++) {
+        if ((i & 63) == 0) {
+            Calibrator_init(&f->cal, 0.3127, 0.3290, 150, 170, 110);
+            Calibrator_set_mode(&f->cal, f->mode);
+        }
+        i1d3_emulator_process(f->emu, cmd, reply, &delay_us);
+        i1d3_counts_to_xyz(reply, (const double (*)[3])f->matrix, xyz);
+        i1d3_xyz_to_color(xyz[0], xyz[1], xyz[2], &res);
+        color.x = res.x;
+        color.y = res.y;
+        color.Y = res.Y;
+        color.X = res.X;
+        color.Z = res.Z;
+        sum += Calibrator_update_gains(&f->cal, &color);
+    }
+    bench_sink = sum;
+}
+
+// --- Panel simulator: one 0.2 s reading of a random panel while it settles after a gain change ---
+
+static void bench_panel_sim_read(void *arg, long iterations) {
+    PanelSim *sim = arg;
+    double xyz[3], sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        double t = i * 0.25;
+        if ((i & 7) == 0) PanelSim_set_gain_at(sim, t, 192, 170 + (int)(i & 15), 160);
+        PanelSim_read_at(sim, t, 0.2, xyz);
+        sum += xyz[1];
+    }
+    bench_sink = sum;
+}
+
+// --- TV gamut / gamma table generation ---
+
+static void bench_set_tv_gamut(void *arg, long iterations) {
+    Measurement *meas = arg;
+    double sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        meas[3].Y = 100.0 + (i & 15) * 0.01;
+        GamutTable gmt = set_tv_gamut(meas);
+        sum += gmt.matrix[0][0];
+    }
+    bench_sink = sum;
+}
+
+static void bench_set_tv_gamma(void *arg, long iterations) {
+    Measurement *steps = arg;
+    double sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        steps[10].Y = 100.0 + (i & 15) * 0.01;
+        GammaTable lut = set_tv_gamma(steps);
+        sum += lut.entries[128];
+    }
+    bench_sink = sum;
+}
+
+// Gamma 2.4 panel with compressed highlights, measured instantly
+static int gamma_panel(void *user, int level, Measurement *out) {
+    double L = pow(level / 255.0, *(const double *)user);
+    if (L > 0.8) L = 0.8 + (L - 0.8) * 0.5;
+    out->x = 0.3127;
+    out->y = 0.3290;
+    out->Y = 0.1 + L * 100.0;
+    return 1;
+}
+
+static void bench_set_tv_gamma_adaptive(void *arg, long iterations) {
+    double gamma = *(const double *)arg;
+    double sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        double g = gamma + (i & 15) * 0.001;
+        GammaTable lut;
+        sum += set_tv_gamma_adaptive(gamma_panel, &g, 11, 0.5, &lut) + lut.entries[128];
+    }
+    bench_sink = sum;
+}
+
+// Per-channel 12-bit PQ LUT with 4096 entries from the 11-point ramp
+static void bench_generate_channel_lut(void *arg, long iterations) {
+    Measurement *steps = arg;
+    static const double levels[11] = {0, 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 1};
+    static uint16_t entries[4096];
+    LutConfig cfg = {LUT_EOTF_PQ, 0, 100.0, 4096, 12};
+    double sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        steps[10].Y = 100.0 + (i & 15) * 0.01;
+        sum += generate_channel_lut(&cfg, levels, steps, 11, entries) + entries[2048];
+    }
+    bench_sink = sum;
+}
+
+int main(void) {
+    static step_fixture fixture;
+    i1d3_emulator_config cfg;
+    i1d3_emulator_default_config(&cfg);
+    cfg.panel = gain_panel;
+    cfg.panel_user = &fixture.cal;
+    fixture.emu = i1d3_emulator_create(&cfg);
+    if (!fixture.emu) {
+        fprintf(stderr, "[FATAL] Failed to create emulator\n");
+        return 1;
+    }
+    i1d3_get_default_matrix(fixture.matrix);
+
+    // Unlock the emulator the way the driver does so it answers measure commands
+    uint8_t challenge_cmd[64] = {0x99}, challenge[64], response[64], reply[64];
+    const uint32_t retail[2] = {0xe9622e9f, 0x8d63e133};
+    int64_t delay_us;
+    i1d3_emulator_process(fixture.emu, challenge_cmd, challenge, &delay_us);
+    i1d3_unlock_response(retail, challenge, response);
+    i1d3_emulator_process(fixture.emu, response, reply, &delay_us);
+
+    Measurement gamut_meas[4] = {
+        {0.640, 0.330, 21.26},  // Red
+        {0.300, 0.600, 71.52},  // Green
+        {0.150, 0.060, 7.22},   // Blue
+        {0.3127, 0.3290, 100.0} // White
+    };
+    Measurement gamma_meas[11];
+    for (int i = 0; i <= 10; i++) {
+        gamma_meas[i].x = 0.3127;
+        gamma_meas[i].y = 0.3290;
+        gamma_meas[i].Y = pow(i / 10.0, 2.4) * 100.0;
+    }
+
+    printf("name,ns_per_op,ops_per_s\n");
+    fixture.mode = CALIBRATOR_MODE_DIAGONAL;
+    run_bench("calibrator_step_emulated", bench_calibrator_step, &fixture);
+    fixture.mode = CALIBRATOR_MODE_BROYDEN;
+    run_bench("calibrator_step_broyden_emulated", bench_calibrator_step, &fixture);
+    PanelSimConfig panel_cfg;
+    PanelSim_random_config(&panel_cfg, 1);
+    PanelSim *panel = PanelSim_create(&panel_cfg);
+    if (panel) run_bench("panel_sim_read", bench_panel_sim_read, panel);
+    PanelSim_destroy(panel);
+    run_bench("set_tv_gamut", bench_set_tv_gamut, gamut_meas);
+    run_bench("set_tv_gamma", bench_set_tv_gamma, gamma_meas);
+    double panel_gamma = 2.4;
+    run_bench("set_tv_gamma_adaptive", bench_set_tv_gamma_adaptive, &panel_gamma);
+    run_bench("generate_channel_lut_pq_4096", bench_generate_channel_lut, gamma_meas);
+
+    i1d3_emulator_destroy(fixture.emu);
+    return 0;
+}
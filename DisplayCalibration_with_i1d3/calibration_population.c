@@ -0,0 +1,561 @@
+/*
+ * Calibration controller benchmark over a population of simulated panels.
+ *
+ * Every panel is PanelSim_random_config(seed + i) in front of an emulated sensor, calibrated from
+ * gain 192/192/192 by each controller mode the way the debug menu does it (sensitivity check, then
+ * Calibrator_run() with the default options). Runs use a virtual clock, so a panel takes well under
+ * a millisecond of wall time while its simulated sensor and settle times stay realistic. Panels are
+ * spread over one worker process per core; each worker owns its driver clock.
+ *
+ * Per mode it reports the failure rate (runs that did not converge), steps to converge, simulated
+ * time of the whole run, sensor integration time and the CIEDE2000 of the settled panel white
+ * against the target. --write-baseline stores the summary; --baseline compares against one and
+ * exits with status 2 when a metric got worse than the tolerance allows.
+ */
+#define _DEFAULT_SOURCE // fork(), setenv() and clock_gettime() under -std=c99
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "display_calibration_api.h"
+#include "panel_sim.h"
+
+#define POPULATION_PANELS_DEFAULT 1000
+#define POPULATION_SEED_DEFAULT 1
+#define POPULATION_TOLERANCE_DEFAULT 0.02 // Allowed regression: relative, failure rate in absolute terms
+#define POPULATION_SETTLED_AFTER 10.0     // Final white is read this long after the last write (s)
+#define POPULATION_MAX_JOBS 256
+
+static const double target_x = 0.3127, target_y = 0.3290; // D65
+
+// Controllers under test; a new CalibratorMode only needs a row here
+static const struct {
+    const char *name;
+    CalibratorMode mode;
+} population_modes[] = {
+    { "diagonal", CALIBRATOR_MODE_DIAGONAL },
+    { "broyden", CALIBRATOR_MODE_BROYDEN },
+};
+#define POPULATION_MODE_COUNT ((int)(sizeof(population_modes) / sizeof(population_modes[0])))
+
+// One calibration, sent from a worker to the parent through a pipe (smaller than PIPE_BUF)
+typedef struct {
+    int panel;
+    int mode;                   // Index into population_modes
+    int setup_failed;           // Sensor or TV could not be brought up; the run did not happen
+    CalibratorStopReason reason;
+    int steps;                  // Readings taken by Calibrator_run()
+    double sim_seconds;         // Simulated time from the sensitivity check to the end of the run
+    double sensor_seconds;      // Simulated time the sensor spent measuring in that span
+    double final_de;            // CIEDE2000 of the settled white at the best gains against the target
+} population_result;
+
+typedef struct {
+    int panels;
+    uint64_t seed;
+    int max_steps;
+    int jobs;
+    int mode_mask;              // Bit i set = run population_modes[i]
+} population_options;
+
+// Summary of one mode, also the baseline record
+typedef struct {
+    int runs;
+    int failures;
+    int by_reason[CALIBRATOR_STOP_ERROR + 2]; // Last slot: setup failures
+    double failure_rate;
+    double steps_mean, steps_p50, steps_p90, steps_p99, steps_max;
+    double sim_seconds_mean, sim_seconds_p90;
+    double sensor_seconds_mean;
+    double de_mean, de_p50, de_p90, de_max;
+} population_summary;
+
+// Baseline metrics: all lower-is-better
+static const struct {
+    const char *name;
+    size_t offset;
+} population_metrics[] = {
+    { "failure_rate", offsetof(population_summary, failure_rate) },
+    { "steps_mean", offsetof(population_summary, steps_mean) },
+    { "steps_p90", offsetof(population_summary, steps_p90) },
+    { "steps_p99", offsetof(population_summary, steps_p99) },
+    { "sim_seconds_mean", offsetof(population_summary, sim_seconds_mean) },
+    { "sim_seconds_p90", offsetof(population_summary, sim_seconds_p90) },
+    { "sensor_seconds_mean", offsetof(population_summary, sensor_seconds_mean) },
+    { "de_mean", offsetof(population_summary, de_mean) },
+    { "de_p90", offsetof(population_summary, de_p90) },
+};
+#define POPULATION_METRIC_COUNT ((int)(sizeof(population_metrics) / sizeof(population_metrics[0])))
+
+static double *metric_field(population_summary *s, int metric) {
+    return (double *)((char *)s + population_metrics[metric].offset);
+}
+
+static double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// --- One panel, one controller ---
+
+static void calibrate_panel(int panel, int mode, const population_options *opts, population_result *out) {
+    memset(out, 0, sizeof(*out));
+    out->panel = panel;
+    out->mode = mode;
+    out->setup_failed = 1;
+
+    // Fresh virtual time per run: panel warm-up drift starts at zero for every controller
+    i1d3_virtual_clock clock = {0};
+    i1d3_set_clock(&i1d3_virtual_clock_ops, &clock);
+
+    PanelSimConfig panel_cfg;
+    PanelSim_random_config(&panel_cfg, opts->seed + (uint64_t)panel);
+    PanelSim *sim = PanelSim_create(&panel_cfg);
+    i1d3_emulator_config emu_cfg;
+    i1d3_emulator_default_config(&emu_cfg);
+    emu_cfg.panel = PanelSim_emulator_panel;
+    emu_cfg.panel_user = sim;
+    emu_cfg.seed = opts->seed + (uint64_t)panel;
+    i1d3_emulator *emu = sim ? i1d3_emulator_create(&emu_cfg) : NULL;
+    i1d3_device *dev = emu ? i1d3_emulator_open(emu, I1D3_TRANSPORT_INPROC, NULL) : NULL;
+    TvControl *tv = dev ? PanelSim_open_tv(sim) : NULL;
+    int fd = dev ? i1d3_device_fd(dev) : -1;
+
+    if (tv != NULL && i1d3_init_sequence(fd) == I1D3_SUCCESS && i1d3_unlock(fd, emu_cfg.key) == I1D3_SUCCESS) {
+        Calibrator cal;
+        Calibrator_init(&cal, target_x, target_y, 192, 192, 192);
+        cal.tv = tv;
+        Calibrator_set_mode(&cal, population_modes[mode].mode);
+
+        CalibratorRunOptions run_opts;
+        CalibratorRunResult run;
+        Calibrator_default_run_options(&run_opts);
+        run_opts.max_steps = opts->max_steps;
+
+        i1d3_reset_stats();
+        int64_t started = i1d3_clock_now_us();
+        if (Calibrator_check_sensitivity(&cal, fd) == 0) {
+            Calibrator_run(&cal, fd, &run_opts, &run);
+            out->reason = run.reason;
+            out->steps = run.steps;
+        } else {
+            out->reason = CALIBRATOR_STOP_ERROR;
+        }
+        out->sim_seconds = (i1d3_clock_now_us() - started) * 1e-6;
+        i1d3_stats stats;
+        i1d3_get_stats(&stats);
+        out->sensor_seconds = stats.op[I1D3_OP_MEASURE].total_us * 1e-6;
+
+        // Judge the gains the controller settled on by the panel's own noiseless, settled output
+        int best[3];
+        Calibrator_get_best_gain(&cal, &best[0], &best[1], &best[2]);
+        double t = PanelSim_now(sim);
+        PanelSim_set_gain_at(sim, t, best[0], best[1], best[2]);
+        double xyz[3], ref[3];
+        PanelSim_xyz_at(sim, t + POPULATION_SETTLED_AFTER, xyz);
+        ref[1] = xyz[1];
+        ref[0] = target_x / target_y * xyz[1];
+        ref[2] = (1.0 - target_x - target_y) / target_y * xyz[1];
+        if (i1d3_delta_e(I1D3_DE2000, ref, xyz, ref, &out->final_de) != I1D3_SUCCESS) out->final_de = NAN;
+        out->setup_failed = 0;
+    }
+
+    TvControl_close(tv);
+    if (fd >= 0) i1d3_close(fd);
+    i1d3_emulator_destroy(emu);
+    PanelSim_destroy(sim);
+    i1d3_set_clock(NULL, NULL);
+}
+
+// Worker: panels worker, worker + jobs, ... for every selected mode, results to out_fd
+static void population_worker(int worker, const population_options *opts, int out_fd) {
+    // The controller logs every step; only results leave the worker
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) {
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        close(null_fd);
+    }
+    setenv("I1D3_CACHE_DIR", "", 1); // Every run starts from a cold sensor, independent of the disk
+
+    for (int panel = worker; panel < opts->panels; panel += opts->jobs) {
+        for (int mode = 0; mode < POPULATION_MODE_COUNT; mode++) {
+            if (!(opts->mode_mask & (1 << mode))) continue;
+            population_result r;
+            calibrate_panel(panel, mode, opts, &r);
+            if (write(out_fd, &r, sizeof(r)) != (ssize_t)sizeof(r)) _exit(1);
+        }
+    }
+    _exit(0);
+}
+
+// Forks the workers and collects their results into results[panel * POPULATION_MODE_COUNT + mode]
+static int run_population(const population_options *opts, population_result *results, int *received) {
+    struct pollfd pfds[POPULATION_MAX_JOBS];
+    pid_t pids[POPULATION_MAX_JOBS];
+    int jobs = opts->jobs;
+
+    fflush(stdout);
+    for (int w = 0; w < jobs; w++) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            fprintf(stderr, "[FATAL] pipe: %s\n", strerror(errno));
+            return -1;
+        }
+        pids[w] = fork();
+        if (pids[w] < 0) {
+            fprintf(stderr, "[FATAL] fork: %s\n", strerror(errno));
+            return -1;
+        }
+        if (pids[w] == 0) {
+            close(fds[0]);
+            for (int k = 0; k < w; k++) close(pfds[k].fd);
+            population_worker(w, opts, fds[1]);
+        }
+        close(fds[1]);
+        pfds[w].fd = fds[0];
+        pfds[w].events = POLLIN;
+    }
+
+    // Results are fixed-size records below PIPE_BUF, so each read returns whole ones
+    int open_pipes = jobs;
+    *received = 0;
+    while (open_pipes > 0) {
+        if (poll(pfds, jobs, -1) < 0 && errno != EINTR) break;
+        for (int w = 0; w < jobs; w++) {
+            if (pfds[w].fd < 0 || !(pfds[w].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            population_result r;
+            ssize_t n = read(pfds[w].fd, &r, sizeof(r));
+            if (n == (ssize_t)sizeof(r) && r.panel >= 0 && r.panel < opts->panels && r.mode >= 0 && r.mode < POPULATION_MODE_COUNT) {
+                results[r.panel * POPULATION_MODE_COUNT + r.mode] = r;
+                (*received)++;
+            } else if (n <= 0) {
+                close(pfds[w].fd);
+                pfds[w].fd = -1;
+                open_pipes--;
+            }
+        }
+    }
+
+    int failed_workers = 0;
+    for (int w = 0; w < jobs; w++) {
+        int status;
+        if (waitpid(pids[w], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) failed_workers++;
+    }
+    return failed_workers;
+}
+
+// --- Statistics ---
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const double *sorted, int n, double fraction) {
+    if (n == 0) return NAN;
+    int rank = (int)ceil(fraction * n);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+static double mean(const double *values, int n) {
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) sum += values[i];
+    return n ? sum / n : NAN;
+}
+
+// Steps and times are taken over converged runs (a failure is counted once, as a failure); the
+// final error covers every run that happened
+static void summarize(const population_result *results, int panels, int mode, population_summary *s) {
+    double *steps = malloc(panels * sizeof(double));
+    double *sim = malloc(panels * sizeof(double));
+    double *sensor = malloc(panels * sizeof(double));
+    double *de = malloc(panels * sizeof(double));
+    int converged = 0, measured = 0;
+
+    memset(s, 0, sizeof(*s));
+    for (int p = 0; p < panels; p++) {
+        const population_result *r = &results[p * POPULATION_MODE_COUNT + mode];
+        s->runs++;
+        if (r->setup_failed) {
+            s->failures++;
+            s->by_reason[CALIBRATOR_STOP_ERROR + 1]++;
+            continue;
+        }
+        s->by_reason[r->reason]++;
+        de[measured++] = r->final_de;
+        if (r->reason != CALIBRATOR_STOP_CONVERGED) {
+            s->failures++;
+            continue;
+        }
+        steps[converged] = r->steps;
+        sim[converged] = r->sim_seconds;
+        sensor[converged] = r->sensor_seconds;
+        converged++;
+    }
+
+    s->failure_rate = s->runs ? (double)s->failures / s->runs : 0.0;
+    s->steps_mean = mean(steps, converged);
+    s->sim_seconds_mean = mean(sim, converged);
+    s->sensor_seconds_mean = mean(sensor, converged);
+    s->de_mean = mean(de, measured);
+    qsort(steps, converged, sizeof(double), compare_double);
+    qsort(sim, converged, sizeof(double), compare_double);
+    qsort(de, measured, sizeof(double), compare_double);
+    s->steps_p50 = percentile(steps, converged, 0.5);
+    s->steps_p90 = percentile(steps, converged, 0.9);
+    s->steps_p99 = percentile(steps, converged, 0.99);
+    s->steps_max = percentile(steps, converged, 1.0);
+    s->sim_seconds_p90 = percentile(sim, converged, 0.9);
+    s->de_p50 = percentile(de, measured, 0.5);
+    s->de_p90 = percentile(de, measured, 0.9);
+    s->de_max = percentile(de, measured, 1.0);
+
+    free(steps);
+    free(sim);
+    free(sensor);
+    free(de);
+}
+
+static void print_summary(const char *name, const population_summary *s) {
+    printf("\n[%s] %d runs, %d failed (%.1f%%)\n", name, s->runs, s->failures, 100.0 * s->failure_rate);
+    printf("  stop reasons:");
+    for (int r = 0; r <= CALIBRATOR_STOP_ERROR; r++) {
+        if (s->by_reason[r]) printf(" %s=%d", Calibrator_stop_reason_string((CalibratorStopReason)r), s->by_reason[r]);
+    }
+    if (s->by_reason[CALIBRATOR_STOP_ERROR + 1]) printf(" setup failed=%d", s->by_reason[CALIBRATOR_STOP_ERROR + 1]);
+    printf("\n");
+    printf("  steps to converge:   mean %.2f  p50 %.0f  p90 %.0f  p99 %.0f  max %.0f\n",
+           s->steps_mean, s->steps_p50, s->steps_p90, s->steps_p99, s->steps_max);
+    printf("  simulated time (s):  mean %.2f  p90 %.2f  (sensor integrating: mean %.2f)\n",
+           s->sim_seconds_mean, s->sim_seconds_p90, s->sensor_seconds_mean);
+    printf("  final dE2000:        mean %.3f  p50 %.3f  p90 %.3f  max %.3f\n",
+           s->de_mean, s->de_p50, s->de_p90, s->de_max);
+}
+
+// --- Baseline file: "# comment", "population <panels> <seed> <max_steps>", "<mode>.<metric> <value>" ---
+
+static int write_baseline(const char *path, const population_options *opts, const population_summary *summaries) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "[ERROR] Cannot write baseline %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    fprintf(f, "# calibration_population baseline; all metrics are lower-is-better\n");
+    fprintf(f, "population %d %llu %d\n", opts->panels, (unsigned long long)opts->seed, opts->max_steps);
+    for (int m = 0; m < POPULATION_MODE_COUNT; m++) {
+        if (!(opts->mode_mask & (1 << m))) continue;
+        for (int k = 0; k < POPULATION_METRIC_COUNT; k++) {
+            fprintf(f, "%s.%s %.6g\n", population_modes[m].name, population_metrics[k].name,
+                    *metric_field((population_summary *)&summaries[m], k));
+        }
+    }
+    return fclose(f);
+}
+
+// Returns the number of regressions, or -1 if the baseline cannot be used
+static int check_baseline(const char *path, const population_options *opts, const population_summary *summaries,
+                          double tolerance) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "[ERROR] Cannot read baseline %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    char line[256];
+    int regressions = 0, compared = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char key[128];
+        double value;
+        int panels, max_steps;
+        unsigned long long seed;
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (sscanf(line, "population %d %llu %d", &panels, &seed, &max_steps) == 3) {
+            if (panels != opts->panels || seed != opts->seed || max_steps != opts->max_steps) {
+                fprintf(stderr, "[ERROR] Baseline was recorded with --panels %d --seed %llu --max-steps %d.\n",
+                        panels, seed, max_steps);
+                fclose(f);
+                return -1;
+            }
+            continue;
+        }
+        if (sscanf(line, "%127s %lf", key, &value) != 2) continue;
+
+        char *dot = strchr(key, '.');
+        if (dot == NULL) continue;
+        *dot = '\0';
+        for (int m = 0; m < POPULATION_MODE_COUNT; m++) {
+            if (strcmp(key, population_modes[m].name) != 0 || !(opts->mode_mask & (1 << m))) continue;
+            for (int k = 0; k < POPULATION_METRIC_COUNT; k++) {
+                if (strcmp(dot + 1, population_metrics[k].name) != 0) continue;
+                double current = *metric_field((population_summary *)&summaries[m], k);
+                double limit = (k == 0) ? value + tolerance : value * (1.0 + tolerance) + 1e-9;
+                compared++;
+                if (!(current <= limit)) { // NaN (no converged run) counts as worse
+                    printf("[REGRESSION] %s.%s: %.6g, baseline %.6g (limit %.6g)\n", key, dot + 1, current, value, limit);
+                    regressions++;
+                }
+            }
+        }
+    }
+    fclose(f);
+    if (compared == 0) {
+        fprintf(stderr, "[ERROR] Baseline %s has no metrics for the selected modes.\n", path);
+        return -1;
+    }
+    printf("\nBaseline %s: %d metrics compared, %d regressed (tolerance %.1f%%).\n", path, compared, regressions,
+           100.0 * tolerance);
+    return regressions;
+}
+
+static int write_csv(const char *path, const population_options *opts, const population_result *results) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "[ERROR] Cannot write %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    fprintf(f, "panel,seed,mode,reason,steps,sim_seconds,sensor_seconds,final_de2000\n");
+    for (int p = 0; p < opts->panels; p++) {
+        for (int m = 0; m < POPULATION_MODE_COUNT; m++) {
+            const population_result *r = &results[p * POPULATION_MODE_COUNT + m];
+            if (!(opts->mode_mask & (1 << m))) continue;
+            fprintf(f, "%d,%llu,%s,%s,%d,%.4f,%.4f,%.4f\n", p, (unsigned long long)(opts->seed + p),
+                    population_modes[m].name,
+                    r->setup_failed ? "setup failed" : Calibrator_stop_reason_string(r->reason),
+                    r->steps, r->sim_seconds, r->sensor_seconds, r->final_de);
+        }
+    }
+    return fclose(f);
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --panels N             Population size (default %d)\n", POPULATION_PANELS_DEFAULT);
+    printf("  --seed S               Seed of panel 0; panel i uses S + i (default %d)\n", POPULATION_SEED_DEFAULT);
+    printf("  --mode NAME|all        Controller to run: diagonal, broyden or all (default all)\n");
+    printf("  --max-steps N          Calibrator_run() reading budget (default: Calibrator_default_run_options)\n");
+    printf("  --jobs N               Worker processes (default: online CPUs)\n");
+    printf("  --baseline FILE        Compare with a baseline; exit 2 on regression\n");
+    printf("  --write-baseline FILE  Store this run as the baseline\n");
+    printf("  --tolerance T          Allowed regression (default %.2f: relative, failure rate absolute)\n",
+           POPULATION_TOLERANCE_DEFAULT);
+    printf("  --csv FILE             Per-run results\n");
+}
+
+int main(int argc, char *argv[]) {
+    population_options opts;
+    CalibratorRunOptions defaults;
+    Calibrator_default_run_options(&defaults);
+    opts.panels = POPULATION_PANELS_DEFAULT;
+    opts.seed = POPULATION_SEED_DEFAULT;
+    opts.max_steps = defaults.max_steps;
+    opts.jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    opts.mode_mask = (1 << POPULATION_MODE_COUNT) - 1;
+    const char *baseline = NULL, *write_path = NULL, *csv = NULL;
+    double tolerance = POPULATION_TOLERANCE_DEFAULT;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i], *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            usage(argv[0]);
+            return 0;
+        }
+        if (value == NULL) {
+            fprintf(stderr, "[ERROR] Unknown option or missing value: %s\n", arg);
+            return 1;
+        }
+        i++;
+        if (strcmp(arg, "--panels") == 0) {
+            opts.panels = atoi(value);
+        } else if (strcmp(arg, "--seed") == 0) {
+            opts.seed = strtoull(value, NULL, 0);
+        } else if (strcmp(arg, "--max-steps") == 0) {
+            opts.max_steps = atoi(value);
+        } else if (strcmp(arg, "--jobs") == 0) {
+            opts.jobs = atoi(value);
+        } else if (strcmp(arg, "--tolerance") == 0) {
+            tolerance = atof(value);
+        } else if (strcmp(arg, "--baseline") == 0) {
+            baseline = value;
+        } else if (strcmp(arg, "--write-baseline") == 0) {
+            write_path = value;
+        } else if (strcmp(arg, "--csv") == 0) {
+            csv = value;
+        } else if (strcmp(arg, "--mode") == 0) {
+            opts.mode_mask = 0;
+            for (int m = 0; m < POPULATION_MODE_COUNT; m++) {
+                if (strcmp(value, "all") == 0 || strcmp(value, population_modes[m].name) == 0) opts.mode_mask |= 1 << m;
+            }
+            if (opts.mode_mask == 0) {
+                fprintf(stderr, "[ERROR] Unknown mode: %s\n", value);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "[ERROR] Unknown option: %s\n", arg);
+            return 1;
+        }
+    }
+    if (opts.panels <= 0 || opts.max_steps <= 0 || tolerance < 0) {
+        fprintf(stderr, "[ERROR] --panels and --max-steps must be positive, --tolerance not negative.\n");
+        return 1;
+    }
+    if (opts.jobs < 1) opts.jobs = 1;
+    if (opts.jobs > POPULATION_MAX_JOBS) opts.jobs = POPULATION_MAX_JOBS;
+    if (opts.jobs > opts.panels) opts.jobs = opts.panels;
+
+    population_result *results = calloc((size_t)opts.panels * POPULATION_MODE_COUNT, sizeof(population_result));
+    if (results == NULL) {
+        fprintf(stderr, "[FATAL] Out of memory\n");
+        return 1;
+    }
+    int expected = 0;
+    for (int m = 0; m < POPULATION_MODE_COUNT; m++) {
+        if (opts.mode_mask & (1 << m)) expected += opts.panels;
+    }
+
+    printf("Calibrating %d panels (seed %llu, up to %d steps) on %d workers...\n", opts.panels,
+           (unsigned long long)opts.seed, opts.max_steps, opts.jobs);
+    double started = wall_seconds();
+    int received = 0;
+    int failed_workers = run_population(&opts, results, &received);
+    double wall = wall_seconds() - started;
+    if (failed_workers != 0 || received != expected) {
+        fprintf(stderr, "[FATAL] %d of %d runs reported (%d workers failed)\n", received, expected, failed_workers);
+        free(results);
+        return 1;
+    }
+
+    population_summary summaries[POPULATION_MODE_COUNT];
+    double simulated = 0.0;
+    for (int i = 0; i < opts.panels * POPULATION_MODE_COUNT; i++) simulated += results[i].sim_seconds;
+    for (int m = 0; m < POPULATION_MODE_COUNT; m++) {
+        if (!(opts.mode_mask & (1 << m))) continue;
+        summarize(results, opts.panels, m, &summaries[m]);
+        print_summary(population_modes[m].name, &summaries[m]);
+    }
+    printf("\n%d runs, %.0f s simulated in %.2f s wall time.\n", received, simulated, wall);
+
+    int status = 0;
+    if (csv != NULL && write_csv(csv, &opts, results) != 0) status = 1;
+    if (write_path != NULL) {
+        if (write_baseline(write_path, &opts, summaries) != 0) status = 1;
+        else printf("Baseline written to %s.\n", write_path);
+    }
+    if (baseline != NULL) {
+        int regressions = check_baseline(baseline, &opts, summaries, tolerance);
+        if (regressions < 0) status = 1;
+        else if (regressions > 0) status = 2;
+    }
+    free(results);
+    return status;
+}
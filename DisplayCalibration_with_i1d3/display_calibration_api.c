@@ -3,7 +3,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-#include <unistd.h>
 
 // Private helper to clamp gain values
 static int clamp_gain(int gain) {
@@ -12,6 +11,29 @@ static int clamp_gain(int gain) {
     return gain;
 }
 
+#define CALIBRATOR_SETTLE_PROBE 0.02     // Integration time of a settle probe (s)
+#define CALIBRATOR_SETTLE_TIMEOUT 1.0    // Give up waiting this long after a write (s)
+#define CALIBRATOR_SETTLE_XY 0.0002      // Settled when the remaining drift in x and y ...
+#define CALIBRATOR_SETTLE_Y 0.005        // ... and in relative Y is below these ...
+#define CALIBRATOR_SETTLE_NOISE 2.0      // ... or below this many standard deviations of probe noise
+#define CALIBRATOR_SETTLE_WINDOW 5       // Probes judged together: the last three for the trend, all for the span
+#define CALIBRATOR_SETTLE_NOISE_E2 8.45  // Mean squared second difference of alternating pure-noise steps, in variances
+#define CALIBRATOR_SETTLE_HEADSTART 0.75 // Sleep this fraction of the learned settle time before probing
+#define CALIBRATOR_SETTLE_DEAD_TIME 0.1  // Until the panel is seen moving, only probes this long after the write count (s)
+#define CALIBRATOR_SETTLE_MOTION 5.0     // Moving once a probe is this many tolerances from the pre-write reading
+#define CALIBRATOR_ACK_TIMEOUT_MS 1000   // Longest wait for the TV to acknowledge a gain command
+
+// Time and sleeps follow the driver clock, so emulated runs under a virtual clock take no wall time
+static double monotonic_seconds(void) {
+    return i1d3_clock_now_us() * 1e-6;
+}
+
+// Stores a controller-requested gain, noting when the 0-192 range cut it short
+static void set_gain(Calibrator *cal, int channel, int requested) {
+    cal->current_gain[channel] = clamp_gain(requested);
+    if (cal->current_gain[channel] != requested) cal->clamped = 1;
+}
+
 void Calibrator_init(Calibrator *cal, double target_x, double target_y, int initial_r, int initial_g, int initial_b) {
     if (cal == NULL) return;
 
@@ -29,16 +51,196 @@ void Calibrator_init(Calibrator *cal, double target_x, double target_y, int init
     // Initial sensitivity values (can be refined by Calibrator_check_sensitivity)
     cal->r_sens = 0.0006;
     cal->g_sens = 0.0005;
-    cal->tv_fd = -1; // Initialize TV control handle as invalid
+    cal->tv = NULL; // No TV backend: gains are only printed
+
+    cal->mode = CALIBRATOR_MODE_DIAGONAL;
+    cal->target_Y = 0.0;
+    cal->have_jacobian = 0;
+    cal->have_last = 0;
+    cal->clamped = 0;
+
+    cal->have_applied = 0;
+    cal->settled = 1;
+    cal->applied_at = 0.0;
+    cal->settle_time = 0.0;
+    cal->have_settle_ref = 0;
+    memset(cal->settle_noise, 0, sizeof(cal->settle_noise));
 }
 
+void Calibrator_set_mode(Calibrator *cal, CalibratorMode mode) {
+    if (cal == NULL) return;
+    cal->mode = mode;
+    cal->have_jacobian = 0;
+    cal->have_last = 0;
+}
+
+// Gain output without a TV backend (cal->tv == NULL): the gains are only logged
 void Calibrator_set_tv_gain(int r, int g, int b) {
-    // TODO: Implement actual hardware communication here (Serial/I2C/Network etc.)
-    // For now, it's a printf for simulation.
-    // In a real scenario, this might involve writing to a device file or sending commands.
     printf("[HW SIM] Set Gain: R=%d, G=%d, B=%d\n", r, g, b);
-    // Example: write(cal->tv_fd, command_buffer, command_len);
-    usleep(50000); // Simulate some delay for hardware response
+}
+
+int Calibrator_apply_gain(Calibrator *cal, int r, int g, int b) {
+    if (cal == NULL) return -1;
+    if (cal->have_applied && cal->applied_gain[0] == r && cal->applied_gain[1] == g && cal->applied_gain[2] == b) {
+        return 0;
+    }
+    if (cal->tv != NULL) {
+        TvControl_set_gain(cal->tv, r, g, b);
+    } else {
+        Calibrator_set_tv_gain(r, g, b);
+    }
+    cal->applied_gain[0] = r;
+    cal->applied_gain[1] = g;
+    cal->applied_gain[2] = b;
+    cal->have_applied = 1;
+    cal->settled = 0;
+    cal->applied_at = monotonic_seconds();
+    return 1;
+}
+
+int Calibrator_flush_gain(Calibrator *cal) {
+    if (cal == NULL) return -1;
+    if (cal->tv == NULL) return 0;
+    if (TvControl_flush(cal->tv) < 0) return -1;
+    return TvControl_wait_acks(cal->tv, CALIBRATOR_ACK_TIMEOUT_MS) < 0 ? -1 : 0;
+}
+
+// Drift still to come after q0, q1, q2 (equally spaced probes), extrapolating a decaying
+// exponential from the ratio of the last two differences. A step can vanish below the probe
+// resolution while the panel still moves, so the larger step is a lower bound as well.
+static double settle_remaining(double q0, double q1, double q2) {
+    double d1 = q1 - q0, d2 = q2 - q1;
+    if (d1 * d2 < 0) return fmax(fabs(d1), fabs(d2)); // Noise if both steps are small; ringing is not settled
+    if (fabs(d2) < fabs(d1)) {
+        double r = d2 / d1;
+        return fmax(fabs(d1), fabs(d2) * (1.0 + r / (1.0 - r)));
+    }
+    return fabs(d2); // Not decaying yet
+}
+
+// Settle coordinates of a probe: x, y and Y relative to the reference luminance
+static void settle_coords(const i1d3_color_results *p, double ref_Y, double q[3]) {
+    q[0] = p->x;
+    q[1] = p->y;
+    q[2] = p->Y / (ref_Y > 0 ? ref_Y : 1.0);
+}
+
+// Allowed drift in coordinate k: the fixed tolerance, raised to the probe noise on a noisy panel,
+// where a fixed limit below the noise would only be met by chance
+static double settle_tolerance(const Calibrator *cal, int k) {
+    double fixed = k < 2 ? CALIBRATOR_SETTLE_XY : CALIBRATOR_SETTLE_Y;
+    return fmax(fixed, CALIBRATOR_SETTLE_NOISE * sqrt(cal->settle_noise[k]));
+}
+
+// Learns the probe noise from windows whose steps alternate in sign: there the noise outweighs
+// any motion, and the second difference q0 - 2 q1 + q2 measures its scatter
+static void settle_learn_noise(Calibrator *cal, const i1d3_color_results p[3]) {
+    double q[3][3];
+    for (int i = 0; i < 3; i++) settle_coords(&p[i], p[2].Y, q[i]);
+    for (int k = 0; k < 3; k++) {
+        double d1 = q[1][k] - q[0][k], d2 = q[2][k] - q[1][k];
+        if (d1 * d2 >= 0) continue;
+        double var = (d2 - d1) * (d2 - d1) / CALIBRATOR_SETTLE_NOISE_E2;
+        cal->settle_noise[k] = cal->settle_noise[k] > 0 ? 0.8 * cal->settle_noise[k] + 0.2 * var : var;
+    }
+}
+
+static int settle_done(const Calibrator *cal, const i1d3_color_results p[CALIBRATOR_SETTLE_WINDOW]) {
+    const int w = CALIBRATOR_SETTLE_WINDOW;
+    double q[CALIBRATOR_SETTLE_WINDOW][3];
+    for (int i = 0; i < w; i++) settle_coords(&p[i], p[w - 1].Y, q[i]);
+    for (int k = 0; k < 3; k++) {
+        double tol = settle_tolerance(cal, k);
+        if (settle_remaining(q[w - 3][k], q[w - 2][k], q[w - 1][k]) >= tol) return 0;
+        if (fabs(q[w - 1][k] - q[0][k]) >= tol) return 0;
+    }
+    return 1;
+}
+
+// Whether a probe has left the last settled reading by clearly more than noise
+static int settle_moved(const Calibrator *cal, const i1d3_color_results *p) {
+    double q[3];
+    settle_coords(p, cal->settle_ref[2], q);
+    for (int k = 0; k < 3; k++) {
+        double ref = k < 2 ? cal->settle_ref[k] : 1.0;
+        if (fabs(q[k] - ref) > CALIBRATOR_SETTLE_MOTION * settle_tolerance(cal, k)) return 1;
+    }
+    return 0;
+}
+
+int Calibrator_wait_settled(Calibrator *cal, int sensor_fd) {
+    if (cal == NULL) return -1;
+    if (cal->settled) return 0;
+    if (cal->tv != NULL) {
+        int sent = TvControl_flush(cal->tv);
+        if (sent < 0) return -1;
+        if (sent == 0) { // Writes since the last flush cancelled out: the panel never changed
+            cal->settled = 1;
+            return 0;
+        }
+        cal->applied_at = monotonic_seconds();
+    }
+
+    i1d3_clock_sleep_until_us((int64_t)((cal->applied_at + CALIBRATOR_SETTLE_HEADSTART * cal->settle_time) * 1e6));
+
+    // Short probes until the window shows no drift beyond the tolerance. During the panel's
+    // dead time the probes are flat too, so a window only counts once the panel has left the
+    // pre-write reading, or once the longest expected dead time has passed.
+    i1d3_color_results probe[CALIBRATOR_SETTLE_WINDOW];
+    double started[CALIBRATOR_SETTLE_WINDOW], observed;
+    const int w = CALIBRATOR_SETTLE_WINDOW;
+    int n = 0, rejected = 0, moved = 0;
+    for (;;) {
+        double start = monotonic_seconds();
+        if (start - cal->applied_at > CALIBRATOR_SETTLE_TIMEOUT) {
+            fprintf(stderr, "[WARNING] Display did not settle within %.1f s.\n", CALIBRATOR_SETTLE_TIMEOUT);
+            observed = CALIBRATOR_SETTLE_TIMEOUT;
+            rejected++;
+            break;
+        }
+        if (n == w) {
+            memmove(probe, probe + 1, (w - 1) * sizeof(probe[0]));
+            memmove(started, started + 1, (w - 1) * sizeof(started[0]));
+            n = w - 1;
+        }
+        if (i1d3_aio_measure_ex(sensor_fd, CALIBRATOR_SETTLE_PROBE, &probe[n]) != I1D3_SUCCESS) return -1;
+        if (!moved && cal->have_settle_ref) moved = settle_moved(cal, &probe[n]);
+        started[n++] = start;
+        if (n >= 3) settle_learn_noise(cal, probe + n - 3);
+        if (n == w) {
+            if ((moved || started[0] - cal->applied_at >= CALIBRATOR_SETTLE_DEAD_TIME) && settle_done(cal, probe)) {
+                observed = started[w - 2] - cal->applied_at;
+                break;
+            }
+            rejected++;
+        }
+    }
+    if (n > 0) {
+        cal->settle_ref[0] = probe[n - 1].x;
+        cal->settle_ref[1] = probe[n - 1].y;
+        cal->settle_ref[2] = probe[n - 1].Y;
+        cal->have_settle_ref = 1;
+    }
+
+    // When the first window already agrees, the panel settled some time before it: observed is
+    // only an upper bound, and learning from it would walk the head start into the dead time
+    if (cal->settle_time <= 0) {
+        cal->settle_time = observed;
+    } else if (rejected > 0) {
+        cal->settle_time = 0.7 * cal->settle_time + 0.3 * observed;
+    }
+    cal->settled = 1;
+    return 0;
+}
+
+// Applies the gains, waits for the panel and takes a full reading. The TV's acknowledgement is
+// collected last: a reading is only kept if the TV accepted the gains it was taken at.
+static int measure_at(Calibrator *cal, int sensor_fd, int r, int g, int b, CalibratedColorValue *cv) {
+    if (Calibrator_apply_gain(cal, r, g, b) < 0) return -1;
+    if (Calibrator_wait_settled(cal, sensor_fd) != 0) return -1;
+    if (Calibrator_get_current_color_from_sensor(sensor_fd, cv) != 0) return -1;
+    if (cal->tv != NULL && TvControl_wait_acks(cal->tv, CALIBRATOR_ACK_TIMEOUT_MS) < 0) return -1;
+    return 0;
 }
 
 int Calibrator_get_current_color_from_sensor(int fd, CalibratedColorValue *measured_color) {
@@ -76,8 +278,7 @@ int Calibrator_check_sensitivity(Calibrator *cal, int sensor_fd) {
     printf(">>> Checking Display Sensitivity (collecting actual data)...\n");
     
     CalibratedColorValue base_cv;
-    Calibrator_set_tv_gain(cal->current_gain[0], cal->current_gain[1], cal->current_gain[2]);
-    if (Calibrator_get_current_color_from_sensor(sensor_fd, &base_cv) != 0) return -1;
+    if (measure_at(cal, sensor_fd, cal->current_gain[0], cal->current_gain[1], cal->current_gain[2], &base_cv) != 0) return -1;
     printf("Base Measurement: x=%.4f, y=%.4f\n", base_cv.x, base_cv.y);
 
     int test_step = 15; // Amount to change gain for sensitivity test
@@ -85,24 +286,46 @@ int Calibrator_check_sensitivity(Calibrator *cal, int sensor_fd) {
     int original_g = cal->current_gain[1];
 
     // Measure R sensitivity
-    Calibrator_set_tv_gain(clamp_gain(original_r - test_step), original_g, cal->current_gain[2]);
     CalibratedColorValue r_test_cv;
-    if (Calibrator_get_current_color_from_sensor(sensor_fd, &r_test_cv) != 0) return -1;
+    if (measure_at(cal, sensor_fd, clamp_gain(original_r - test_step), original_g, cal->current_gain[2], &r_test_cv) != 0) return -1;
     cal->r_sens = fabs(r_test_cv.x - base_cv.x) / test_step; // Sensitivity based on x change
     printf("R Test Measurement: x=%.4f, y=%.4f, dX=%.6f\n", r_test_cv.x, r_test_cv.y, fabs(r_test_cv.x - base_cv.x));
 
     // Measure G sensitivity
-    Calibrator_set_tv_gain(original_r, clamp_gain(original_g - test_step), cal->current_gain[2]);
     CalibratedColorValue g_test_cv;
-    if (Calibrator_get_current_color_from_sensor(sensor_fd, &g_test_cv) != 0) return -1;
+    if (measure_at(cal, sensor_fd, original_r, clamp_gain(original_g - test_step), cal->current_gain[2], &g_test_cv) != 0) return -1;
     cal->g_sens = fabs(g_test_cv.y - base_cv.y) / test_step; // Sensitivity based on y change
     printf("G Test Measurement: x=%.4f, y=%.4f, dY=%.6f\n", g_test_cv.x, g_test_cv.y, fabs(g_test_cv.y - base_cv.y));
 
-    // Restore original gain
-    Calibrator_set_tv_gain(original_r, original_g, cal->current_gain[2]);
-    usleep(100000); // Wait for TV to settle
+    if (cal->mode == CALIBRATOR_MODE_BROYDEN) {
+        // Measure B as well; the three steps are finite-difference columns of the Jacobian
+        int original_b = cal->current_gain[2];
+        CalibratedColorValue b_test_cv;
+        if (measure_at(cal, sensor_fd, original_r, original_g, clamp_gain(original_b - test_step), &b_test_cv) != 0) return -1;
+        printf("B Test Measurement: x=%.4f, y=%.4f\n", b_test_cv.x, b_test_cv.y);
 
-    printf("Sensitivity analysis complete: R_Sens=%.6f, G_Sens=%.6f\n\n", cal->r_sens, cal->r_sens);
+        const CalibratedColorValue *tests[3] = {&r_test_cv, &g_test_cv, &b_test_cv};
+        int original[3] = {original_r, original_g, original_b};
+        cal->have_jacobian = 1;
+        for (int c = 0; c < 3; c++) {
+            double step = clamp_gain(original[c] - test_step) - original[c];
+            if (step == 0) { // Gain already at 0: seed from the panel model at the first step instead
+                cal->have_jacobian = 0;
+                break;
+            }
+            cal->jacobian[0][c] = (tests[c]->x - base_cv.x) / step;
+            cal->jacobian[1][c] = (tests[c]->y - base_cv.y) / step;
+            cal->jacobian[2][c] = (tests[c]->Y - base_cv.Y) / step;
+        }
+        memcpy(cal->last_gain, original, sizeof(original));
+        cal->last_xyY[0] = base_cv.x; cal->last_xyY[1] = base_cv.y; cal->last_xyY[2] = base_cv.Y;
+        cal->have_last = 1;
+    }
+
+    // Restore original gain; the next measurement waits for the panel
+    Calibrator_apply_gain(cal, original_r, original_g, cal->current_gain[2]);
+
+    printf("Sensitivity analysis complete: R_Sens=%.6f, G_Sens=%.6f\n\n", cal->r_sens, cal->g_sens);
     if (cal->r_sens < 1e-7 || cal->g_sens < 1e-7) { // Prevent division by zero or very small sensitivity
         fprintf(stderr, "[WARNING] Sensitivity too low. Using default values.\n");
         cal->r_sens = 0.0006;
@@ -112,20 +335,130 @@ int Calibrator_check_sensitivity(Calibrator *cal, int sensor_fd) {
     return 0;
 }
 
-int Calibrator_perform_calibration_step(Calibrator *cal, int sensor_fd, int step_num) {
-    if (cal == NULL) return -1;
+// Seed the Jacobian from one measurement: assume BT.709 primaries, each scaled so that the
+// current gains reproduce the measured XYZ, and differentiate x = X/S, y = Y/S analytically
+static int seed_jacobian_from_model(Calibrator *cal, const CalibratedColorValue *m) {
+    static const double m709[3][3] = {
+        {0.4124, 0.3576, 0.1805},
+        {0.2126, 0.7152, 0.0722},
+        {0.0193, 0.1192, 0.9505}
+    };
+    static const double m709_inv[3][3] = {
+        {3.2406, -1.5372, -0.4986},
+        {-0.9689, 1.8758, 0.0415},
+        {0.0557, -0.2040, 1.0570}
+    };
+    double xyz[3] = {m->X, m->Y, m->Z}, P[3][3];
+    for (int c = 0; c < 3; c++) {
+        double rgb = m709_inv[c][0] * xyz[0] + m709_inv[c][1] * xyz[1] + m709_inv[c][2] * xyz[2];
+        if (rgb <= 0 || cal->current_gain[c] <= 0) return 0;
+        double k = rgb / cal->current_gain[c]; // Light of primary c per gain step
+        for (int r = 0; r < 3; r++) P[r][c] = m709[r][c] * k;
+    }
+    double S = xyz[0] + xyz[1] + xyz[2];
+    if (S <= 0) return 0;
+    for (int c = 0; c < 3; c++) {
+        double s_c = P[0][c] + P[1][c] + P[2][c];
+        cal->jacobian[0][c] = (P[0][c] * S - xyz[0] * s_c) / (S * S);
+        cal->jacobian[1][c] = (P[1][c] * S - xyz[1] * s_c) / (S * S);
+        cal->jacobian[2][c] = P[1][c];
+    }
+    cal->have_jacobian = 1;
+    return 1;
+}
 
-    CalibratedColorValue current_measured_color;
-    // 1. Measure current state
-    Calibrator_set_tv_gain(cal->current_gain[0], cal->current_gain[1], cal->current_gain[2]);
-    if (Calibrator_get_current_color_from_sensor(sensor_fd, &current_measured_color) != 0) {
-        fprintf(stderr, "[ERROR] Failed to get sensor data during calibration step.\n");
-        return -1;
+static int invert3(const double m[3][3], double inv[3][3]) {
+    double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+               - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+               + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    if (fabs(det) < 1e-300) return 0;
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            int r1 = (c + 1) % 3, r2 = (c + 2) % 3, c1 = (r + 1) % 3, c2 = (r + 2) % 3;
+            inv[r][c] = (m[r1][c1] * m[r2][c2] - m[r1][c2] * m[r2][c1]) / det;
+        }
+    }
+    return 1;
+}
+
+// Next gains from the Jacobian. The light adds linearly in XYZ, not in xy, so the step is solved
+// in XYZ: the (x, y, Y) Jacobian is mapped through the differential of X = xY/y, Z = (1-x-y)Y/y at
+// the measured point. Every gain vector g - u + Yt * v then has the target chromaticity (to first
+// order); Yt is target_Y, or the largest luminance that keeps every gain within 192.
+static void broyden_step(Calibrator *cal, const CalibratedColorValue *m) {
+    const double (*J)[3] = (const double (*)[3])cal->jacobian;
+    double x = m->x, y = m->y, Y = m->Y, A[3][3], inv[3][3];
+    if (y <= 0 || cal->target_y <= 0) return;
+
+    for (int c = 0; c < 3; c++) {
+        A[0][c] = (Y / y) * J[0][c] + (x / y) * J[2][c] - (x * Y / (y * y)) * J[1][c];
+        A[1][c] = J[2][c];
+        A[2][c] = ((1.0 - x - y) / y) * J[2][c] - (Y / y) * (J[0][c] + J[1][c]) - ((1.0 - x - y) * Y / (y * y)) * J[1][c];
+    }
+    if (!invert3((const double (*)[3])A, inv)) return;
+
+    double xyz[3] = {x * Y / y, Y, (1.0 - x - y) * Y / y};
+    double white[3] = {cal->target_x / cal->target_y, 1.0, (1.0 - cal->target_x - cal->target_y) / cal->target_y};
+    double base[3], v[3];
+    for (int c = 0; c < 3; c++) {
+        base[c] = cal->current_gain[c] - (inv[c][0] * xyz[0] + inv[c][1] * xyz[1] + inv[c][2] * xyz[2]);
+        v[c] = inv[c][0] * white[0] + inv[c][1] * white[1] + inv[c][2] * white[2];
+    }
+
+    double Yt = cal->target_Y;
+    if (Yt <= 0) {
+        Yt = HUGE_VAL;
+        for (int c = 0; c < 3; c++) {
+            if (v[c] > 0 && (192.0 - base[c]) / v[c] < Yt) Yt = (192.0 - base[c]) / v[c];
+        }
+        if (Yt == HUGE_VAL) return;
+    }
+    for (int c = 0; c < 3; c++) set_gain(cal, c, (int)round(base[c] + Yt * v[c]));
+}
+
+double Calibrator_update_gains(Calibrator *cal, const CalibratedColorValue *measured_color) {
+    if (cal == NULL || measured_color == NULL) return HUGE_VAL;
+    cal->clamped = 0;
+
+    if (cal->mode == CALIBRATOR_MODE_BROYDEN) {
+        double dx = cal->target_x - measured_color->x;
+        double dy = cal->target_y - measured_color->y;
+        double dist = sqrt(dx * dx + dy * dy);
+        double f[3] = {measured_color->x, measured_color->y, measured_color->Y};
+
+        if (dist < cal->min_dist) {
+            cal->min_dist = dist;
+            memcpy(cal->best_gain, cal->current_gain, sizeof(cal->current_gain));
+        }
+
+        if (cal->have_jacobian && cal->have_last) {
+            // Broyden: J += (df - J dg) dg^T / (dg^T dg), the smallest change that explains the last step
+            double s[3], ss = 0;
+            for (int c = 0; c < 3; c++) {
+                s[c] = cal->current_gain[c] - cal->last_gain[c];
+                ss += s[c] * s[c];
+            }
+            if (ss > 0) {
+                for (int r = 0; r < 3; r++) {
+                    double residual = f[r] - cal->last_xyY[r];
+                    for (int c = 0; c < 3; c++) residual -= cal->jacobian[r][c] * s[c];
+                    for (int c = 0; c < 3; c++) cal->jacobian[r][c] += residual * s[c] / ss;
+                }
+            }
+        } else if (!cal->have_jacobian) {
+            seed_jacobian_from_model(cal, measured_color);
+        }
+        memcpy(cal->last_gain, cal->current_gain, sizeof(cal->current_gain));
+        memcpy(cal->last_xyY, f, sizeof(f));
+        cal->have_last = 1;
+
+        if (cal->have_jacobian) broyden_step(cal, measured_color);
+        return dist;
     }
 
     // 2. Calculate distance to target
-    double dx = cal->target_x - current_measured_color.x;
-    double dy = cal->target_y - current_measured_color.y;
+    double dx = cal->target_x - measured_color->x;
+    double dy = cal->target_y - measured_color->y;
     double dist = sqrt(dx * dx + dy * dy);
 
     // 3. Update best gain if current distance is better
@@ -134,29 +467,179 @@ int Calibrator_perform_calibration_step(Calibrator *cal, int sensor_fd, int step
         memcpy(cal->best_gain, cal->current_gain, sizeof(cal->current_gain));
     }
     
-    Calibrator_print_status(cal, step_num, &current_measured_color);
-
     // 4. Calculate predictive control based Gain adjustment
     double learning_rate = (dist > 0.005) ? 0.8 : 0.4;
     double adj_r = (dx / (cal->r_sens > 1e-7 ? cal->r_sens : 1e-7)) * learning_rate; // Avoid division by zero
     double adj_g = (dy / (cal->g_sens > 1e-7 ? cal->g_sens : 1e-7)) * learning_rate; // Avoid division by zero
 
     // 5. Apply new Gain (with clamping)
-    cal->current_gain[0] = clamp_gain(cal->current_gain[0] + (int)round(adj_r));
-    cal->current_gain[1] = clamp_gain(cal->current_gain[1] + (int)round(adj_g));
+    set_gain(cal, 0, cal->current_gain[0] + (int)round(adj_r));
+    set_gain(cal, 1, cal->current_gain[1] + (int)round(adj_g));
     
     // Blue Gain auxiliary logic (from original CCT code)
     if (dist > 0.01) {
-        cal->current_gain[2] = clamp_gain(cal->current_gain[2] + (int)round((dx + dy) * 40));
+        set_gain(cal, 2, cal->current_gain[2] + (int)round((dx + dy) * 40));
     }
 
-    // 6. Apply to actual hardware (simulated)
-    Calibrator_set_tv_gain(cal->current_gain[0], cal->current_gain[1], cal->current_gain[2]);
+    return dist;
+}
+
+int Calibrator_perform_calibration_step(Calibrator *cal, int sensor_fd, int step_num) {
+    if (cal == NULL) return -1;
 
-    usleep(100000); // Pause for 100ms for TV to stabilize
+    CalibratedColorValue current_measured_color;
+    // 1. Measure current state (the gain was applied by the previous step; only the settle is awaited)
+    if (measure_at(cal, sensor_fd, cal->current_gain[0], cal->current_gain[1], cal->current_gain[2], &current_measured_color) != 0) {
+        fprintf(stderr, "[ERROR] Failed to get sensor data during calibration step.\n");
+        return -1;
+    }
+
+    // 2-5. Track the best gain and compute the next one
+    int measured_gain[3];
+    memcpy(measured_gain, cal->current_gain, sizeof(measured_gain));
+    Calibrator_update_gains(cal, &current_measured_color);
+
+    Calibrator shown = *cal; // Report the gains that produced this measurement
+    memcpy(shown.current_gain, measured_gain, sizeof(measured_gain));
+    Calibrator_print_status(&shown, step_num, &current_measured_color);
+
+    // 6. Apply to actual hardware (simulated); the next measurement waits for the panel to settle
+    Calibrator_apply_gain(cal, cal->current_gain[0], cal->current_gain[1], cal->current_gain[2]);
     return 0;
 }
 
+void Calibrator_default_run_options(CalibratorRunOptions *opts) {
+    if (opts == NULL) return;
+    opts->metric = CALIBRATOR_METRIC_XY;
+    opts->tolerance = 0.001;
+    opts->hold = 2;
+    opts->max_steps = 30;
+    opts->max_seconds = 0;
+    opts->stall_steps = 6;
+}
+
+const char *Calibrator_stop_reason_string(CalibratorStopReason reason) {
+    switch (reason) {
+        case CALIBRATOR_STOP_CONVERGED: return "converged";
+        case CALIBRATOR_STOP_STEP_BUDGET: return "step budget exhausted";
+        case CALIBRATOR_STOP_TIME_BUDGET: return "time budget exhausted";
+        case CALIBRATOR_STOP_STALLED: return "stalled";
+        case CALIBRATOR_STOP_OSCILLATING: return "oscillating";
+        case CALIBRATOR_STOP_CLAMPED: return "clamped at gain limit";
+        case CALIBRATOR_STOP_ERROR: return "sensor error";
+    }
+    return "unknown";
+}
+
+static double run_error(const Calibrator *cal, CalibratorMetric metric, const CalibratedColorValue *m) {
+    double dx = cal->target_x - m->x, dy = cal->target_y - m->y;
+    if (metric == CALIBRATOR_METRIC_DE2000 && m->y > 0 && cal->target_y > 0) {
+        // Target white at the measured luminance doubles as the reference white, so only the tint counts
+        double ref[3] = {cal->target_x / cal->target_y * m->Y, m->Y, (1.0 - cal->target_x - cal->target_y) / cal->target_y * m->Y};
+        double meas[3] = {m->x / m->y * m->Y, m->Y, (1.0 - m->x - m->y) / m->y * m->Y};
+        double de;
+        if (i1d3_delta_e(I1D3_DE2000, ref, meas, ref, &de) == I1D3_SUCCESS) return de;
+    }
+    return sqrt(dx * dx + dy * dy);
+}
+
+#define CALIBRATOR_RUN_HISTORY 16 // Gains remembered for cycle detection
+
+CalibratorStopReason Calibrator_run(Calibrator *cal, int sensor_fd, const CalibratorRunOptions *opts,
+                                    CalibratorRunResult *result) {
+    CalibratorRunOptions defaults;
+    if (opts == NULL) {
+        Calibrator_default_run_options(&defaults);
+        opts = &defaults;
+    }
+    CalibratorRunResult res = {CALIBRATOR_STOP_ERROR, 0, 0.0, HUGE_VAL, HUGE_VAL};
+    if (cal == NULL) {
+        if (result) *result = res;
+        return res.reason;
+    }
+
+    double start = monotonic_seconds();
+    int history[CALIBRATOR_RUN_HISTORY][3], history_len = 0;
+    int best_gain[3] = {0}, in_tolerance = 0, since_best = 0;
+    double best_xy = HUGE_VAL;
+
+    for (;;) {
+        if (opts->max_steps > 0 && res.steps >= opts->max_steps) {
+            res.reason = CALIBRATOR_STOP_STEP_BUDGET;
+            break;
+        }
+        if (opts->max_seconds > 0 && monotonic_seconds() - start >= opts->max_seconds) {
+            res.reason = CALIBRATOR_STOP_TIME_BUDGET;
+            break;
+        }
+
+        CalibratedColorValue m;
+        if (measure_at(cal, sensor_fd, cal->current_gain[0], cal->current_gain[1], cal->current_gain[2], &m) != 0) {
+            res.reason = CALIBRATOR_STOP_ERROR;
+            break;
+        }
+        res.steps++;
+        res.last_error = run_error(cal, opts->metric, &m);
+        if (res.last_error < res.best_error) {
+            res.best_error = res.last_error;
+            best_xy = hypot(cal->target_x - m.x, cal->target_y - m.y);
+            memcpy(best_gain, cal->current_gain, sizeof(best_gain));
+            since_best = 0;
+        } else {
+            since_best++;
+        }
+
+        if (res.last_error <= opts->tolerance) {
+            // Hold the gains and confirm with further readings
+            printf("[%02d] R:%d G:%d B:%d | x:%.4f y:%.4f Y:%.2f | Err:%.5f | hold %d/%d\n", res.steps,
+                   cal->current_gain[0], cal->current_gain[1], cal->current_gain[2], m.x, m.y, m.Y,
+                   res.last_error, in_tolerance + 1, opts->hold);
+            if (++in_tolerance >= opts->hold) {
+                res.reason = CALIBRATOR_STOP_CONVERGED;
+                break;
+            }
+            continue;
+        }
+        in_tolerance = 0;
+
+        int measured_gain[3];
+        memcpy(measured_gain, cal->current_gain, sizeof(measured_gain));
+        Calibrator_update_gains(cal, &m);
+        printf("[%02d] R:%d G:%d B:%d | x:%.4f y:%.4f Y:%.2f | Err:%.5f\n", res.steps,
+               measured_gain[0], measured_gain[1], measured_gain[2], m.x, m.y, m.Y, res.last_error);
+
+        if (opts->stall_steps > 0 && since_best >= opts->stall_steps) {
+            res.reason = CALIBRATOR_STOP_STALLED;
+            break;
+        }
+        if (memcmp(measured_gain, cal->current_gain, sizeof(measured_gain)) == 0) {
+            // Same gains again would give the same reading: quantisation floor or a limit
+            res.reason = cal->clamped ? CALIBRATOR_STOP_CLAMPED : CALIBRATOR_STOP_STALLED;
+            break;
+        }
+
+        memcpy(history[history_len % CALIBRATOR_RUN_HISTORY], measured_gain, sizeof(measured_gain));
+        history_len++;
+        int revisit = 0;
+        int n = history_len < CALIBRATOR_RUN_HISTORY ? history_len : CALIBRATOR_RUN_HISTORY;
+        for (int i = 0; i < n && !revisit; i++) {
+            revisit = memcmp(history[i], cal->current_gain, sizeof(history[i])) == 0;
+        }
+        if (revisit) {
+            res.reason = CALIBRATOR_STOP_OSCILLATING;
+            break;
+        }
+    }
+
+    if (res.steps > 0 && best_xy < HUGE_VAL) {
+        memcpy(cal->best_gain, best_gain, sizeof(best_gain));
+        cal->min_dist = best_xy;
+    }
+    res.elapsed = monotonic_seconds() - start;
+    if (result) *result = res;
+    return res.reason;
+}
+
 void Calibrator_get_best_gain(Calibrator *cal, int *r, int *g, int *b) {
     if (cal == NULL || r == NULL || g == NULL || b == NULL) return;
     *r = cal->best_gain[0];
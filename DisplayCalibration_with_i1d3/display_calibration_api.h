@@ -2,6 +2,7 @@
 #define DISPLAY_CALIBRATION_API_H
 
 #include "i1d3_api.h" // For i1d3_color_results
+#include "tv_control.h"
 
 // Structure to hold color values (from sensor)
 typedef struct {
@@ -9,6 +10,12 @@ typedef struct {
     double X, Z; // XYZ values might also be useful
 } CalibratedColorValue;
 
+// How Calibrator_update_gains() turns a measurement into the next gains
+typedef enum {
+    CALIBRATOR_MODE_DIAGONAL = 0, // R gain -> x and G gain -> y only (r_sens, g_sens), B by heuristic
+    CALIBRATOR_MODE_BROYDEN = 1   // Full gain -> (x, y, Y) Jacobian, refined by a Broyden update every step
+} CalibratorMode;
+
 // Structure to manage the calibration state
 typedef struct {
     double target_x, target_y; // Target chromaticity
@@ -17,9 +24,61 @@ typedef struct {
     double min_dist;          // Minimum distance to target chromaticity
     double r_sens;            // R channel sensitivity
     double g_sens;            // G channel sensitivity
-    int tv_fd;                // File descriptor or handle for TV control (if applicable)
+    TvControl *tv;            // TV gain backend, NULL = print through Calibrator_set_tv_gain(); not owned
+    CalibratorMode mode;      // Controller (CALIBRATOR_MODE_DIAGONAL after Calibrator_init)
+    double target_Y;          // Broyden: target luminance, 0 = keep the brightest channel at full gain
+    double jacobian[3][3];    // Broyden: d(x, y, Y) / d(R, G, B gain)
+    int have_jacobian;        // Broyden: jacobian is seeded
+    int last_gain[3];         // Broyden: gains of the previous measurement
+    double last_xyY[3];       // Broyden: previous measurement
+    int have_last;            // Broyden: last_gain / last_xyY are valid
+    int clamped;              // Last Calibrator_update_gains() wanted a gain outside 0-192
+    int applied_gain[3];      // Gains last written to the TV, valid when have_applied
+    int have_applied;         // applied_gain is known
+    int settled;              // Panel has settled since the last write
+    double applied_at;        // Driver clock time of the last write (s)
+    double settle_time;       // Learned settle time of this panel (s), 0 until measured
+    double settle_ref[3];     // x, y, Y of the last settled reading, valid when have_settle_ref
+    int have_settle_ref;      // settle_ref is known
+    double settle_noise[3];   // Learned variance of a settle probe in x, y and relative Y, 0 until seen
 } Calibrator;
 
+// Error measure compared against CalibratorRunOptions.tolerance
+typedef enum {
+    CALIBRATOR_METRIC_XY = 0,    // Euclidean distance in CIE 1931 xy
+    CALIBRATOR_METRIC_DE2000 = 1 // CIEDE2000 of the measured white against the target white at equal Y
+} CalibratorMetric;
+
+// Why Calibrator_run() returned
+typedef enum {
+    CALIBRATOR_STOP_CONVERGED = 0,   // Within tolerance for `hold` consecutive readings
+    CALIBRATOR_STOP_STEP_BUDGET,     // max_steps readings taken
+    CALIBRATOR_STOP_TIME_BUDGET,     // max_seconds elapsed
+    CALIBRATOR_STOP_STALLED,         // Controller asks for the same gains again, or no improvement in stall_steps readings
+    CALIBRATOR_STOP_OSCILLATING,     // Controller revisits gains it already measured in this run
+    CALIBRATOR_STOP_CLAMPED,         // Controller is pinned against gain 0 or 192
+    CALIBRATOR_STOP_ERROR            // Sensor read failed
+} CalibratorStopReason;
+
+// Stop criteria of Calibrator_run()
+typedef struct {
+    CalibratorMetric metric;
+    double tolerance;   // In units of metric
+    int hold;           // Consecutive in-tolerance readings required (gains are held meanwhile)
+    int max_steps;      // Reading budget, 0 = unlimited
+    double max_seconds; // Time budget on the driver clock, 0 = unlimited
+    int stall_steps;    // Readings without a new best before giving up, 0 = never
+} CalibratorRunOptions;
+
+// Outcome of Calibrator_run()
+typedef struct {
+    CalibratorStopReason reason;
+    int steps;          // Readings taken
+    double elapsed;     // Seconds on the driver clock
+    double last_error;  // Error of the last reading, in units of metric
+    double best_error;  // Error at cal->best_gain, in units of metric
+} CalibratorRunResult;
+
 // --- API Functions ---
 
 /**
@@ -34,13 +93,63 @@ typedef struct {
 void Calibrator_init(Calibrator *cal, double target_x, double target_y, int initial_r, int initial_g, int initial_b);
 
 /**
- * @brief Sets the TV's RGB gain. This is a placeholder and needs actual hardware implementation.
+ * @brief Selects the controller used by the following calibration steps.
+ *        Switching to CALIBRATOR_MODE_BROYDEN drops any previous Jacobian; it is seeded by
+ *        Calibrator_check_sensitivity() or, failing that, from a BT.709 panel model fitted
+ *        to the first measurement.
+ * @param cal Pointer to the Calibrator structure.
+ * @param mode Controller.
+ */
+void Calibrator_set_mode(Calibrator *cal, CalibratorMode mode);
+
+/**
+ * @brief Prints the RGB gain instead of sending it. Calibrator_apply_gain() falls back to this when
+ *        cal->tv is NULL; a real TV is driven through a TvControl backend.
  * @param r Red gain (0-192).
  * @param g Green gain (0-192).
  * @param b Blue gain (0-192).
  */
 void Calibrator_set_tv_gain(int r, int g, int b);
 
+/**
+ * @brief Writes the gains to the TV, unless they are the gains already written. With cal->tv the
+ *        gains are only staged: Calibrator_wait_settled() or Calibrator_flush_gain() sends them, so
+ *        writes in between merge into one command. Without it Calibrator_set_tv_gain() is called.
+ *        A write marks the panel as unsettled; it does not wait.
+ * @param cal Pointer to the Calibrator structure.
+ * @param r Red gain (0-192).
+ * @param g Green gain (0-192).
+ * @param b Blue gain (0-192).
+ * @return 1 if the gains were written, 0 if skipped, -1 on invalid arguments.
+ */
+int Calibrator_apply_gain(Calibrator *cal, int r, int g, int b);
+
+/**
+ * @brief Sends gains staged by Calibrator_apply_gain() and waits for the TV to acknowledge them.
+ *        Use it when the gains must reach the TV without a measurement following.
+ * @param cal Pointer to the Calibrator structure.
+ * @return 0 on success (or without cal->tv), -1 if the TV did not accept the gains.
+ */
+int Calibrator_flush_gain(Calibrator *cal);
+
+/**
+ * @brief Waits until the panel has settled after the last Calibrator_apply_gain() write.
+ *        With cal->tv the staged gains are sent first; the acknowledgement is collected after
+ *        the measurement that follows, so the TV's reply overlaps the sensor integration.
+ *        Sleeps for most of the settle time learned so far, then takes 20 ms readings until, over
+ *        the last five, both the drift extrapolated from the last three and the total span are below
+ *        0.0002 in xy and 0.5% in Y, or below two standard deviations of the probe noise learned on
+ *        this panel (from alternating steps) where that is larger, giving up 1 s after the write.
+ *        A flat window only counts once a reading has left the last settled one, or from 100 ms
+ *        after the write, so the panel's dead time is not taken for settled.
+ *        Times are on the driver clock (i1d3_set_clock()).
+ *        Waits that saw the panel move refine cal->settle_time. Returns at once if nothing was written.
+ * @param cal Pointer to the Calibrator structure.
+ * @param sensor_fd The file descriptor for the i1d3 sensor.
+ * @return 0 on success, -1 on sensor failure.
+ */
+int Calibrator_wait_settled(Calibrator *cal, int sensor_fd);
+
 /**
  * @brief Measures the current color values using the i1d3 sensor.
  *        This function internally calls i1d3_aio_measure.
@@ -54,6 +163,7 @@ int Calibrator_get_current_color_from_sensor(int fd, CalibratedColorValue *measu
 /**
  * @brief Checks the display's sensitivity for Red and Green channels.
  *        This involves taking multiple sensor measurements with modified gains.
+ *        In CALIBRATOR_MODE_BROYDEN Blue is measured too, and the three steps seed the full Jacobian.
  * @param cal Pointer to the Calibrator structure.
  * @param sensor_fd The file descriptor for the i1d3 sensor.
  * @return 0 on success, -1 on failure.
@@ -70,6 +180,43 @@ int Calibrator_check_sensitivity(Calibrator *cal, int sensor_fd);
  */
 int Calibrator_perform_calibration_step(Calibrator *cal, int sensor_fd, int step_num);
 
+/**
+ * @brief Control math of one calibration step, without hardware access.
+ *        Updates the best gain from the measurement and computes the next current gain.
+ * @param cal Pointer to the Calibrator structure.
+ * @param measured_color Color measured at the current gain.
+ * @return Distance from the measurement to the target chromaticity.
+ */
+double Calibrator_update_gains(Calibrator *cal, const CalibratedColorValue *measured_color);
+
+/**
+ * @brief Fills opts with the defaults: |dxy| <= 0.001 held for 2 readings, 30 readings, no time
+ *        limit, stall after 6 readings without improvement.
+ * @param opts Options to fill.
+ */
+void Calibrator_default_run_options(CalibratorRunOptions *opts);
+
+/**
+ * @brief Runs calibration steps until a stop criterion is met.
+ *        Each reading applies the current gains, waits for the panel to settle and measures. Once a reading is
+ *        within tolerance the gains are held and re-measured until `hold` consecutive readings
+ *        agree; a reading outside tolerance resumes the controller. The run also stops early when
+ *        the controller cycles, stalls or is clamped, since further readings cannot improve the
+ *        best gain. The best gain is left in cal->best_gain and is not applied.
+ * @param cal Pointer to the Calibrator structure (initialised, sensitivity optionally checked).
+ * @param sensor_fd The file descriptor for the i1d3 sensor.
+ * @param opts Stop criteria, NULL for Calibrator_default_run_options().
+ * @param result Outcome, may be NULL.
+ * @return Why the run stopped.
+ */
+CalibratorStopReason Calibrator_run(Calibrator *cal, int sensor_fd, const CalibratorRunOptions *opts,
+                                    CalibratorRunResult *result);
+
+/**
+ * @brief Human-readable name of a stop reason.
+ */
+const char *Calibrator_stop_reason_string(CalibratorStopReason reason);
+
 /**
  * @brief Retrieves the best RGB gain values found during calibration.
  * @param cal Pointer to the Calibrator structure.
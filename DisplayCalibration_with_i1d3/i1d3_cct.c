@@ -0,0 +1,81 @@
+/* CCT and Duv from a Planckian locus table (Robertson's isotemperature lines) */
+#include "i1d3_api.h"
+#include <math.h>
+
+// One row of the generated table: locus point in CIE 1960 (u, v) and its unit tangent towards higher mired
+typedef struct {
+    double mired;
+    double u, v;
+    double tu, tv;
+} i1d3_planck_point;
+
+#include "i1d3_planck_table.h" // Generated by i1d3_planck_gen at build time
+
+// Signed distance of (u, v) along the locus from the isotemperature line of row i;
+// decreases with i, and changes sign between the two lines that bracket the point
+static double i1d3_planck_offset(int i, double u, double v) {
+    const i1d3_planck_point *p = &i1d3_planck_table[i];
+    return (u - p->u) * p->tu + (v - p->v) * p->tv;
+}
+
+i1d3_error_t i1d3_xy_to_cct(double x, double y, double *cct, double *duv) {
+    if (cct) *cct = 0;
+    if (duv) *duv = 0;
+
+    double den = -2.0 * x + 12.0 * y + 3.0;
+    if (!(den > 0)) return I1D3_ERROR_INVALID_PARAMETER;
+    double u = 4.0 * x / den, v = 6.0 * y / den;
+
+    if (!(i1d3_planck_offset(0, u, v) >= 0 && i1d3_planck_offset(I1D3_PLANCK_COUNT - 1, u, v) < 0)) {
+        return I1D3_ERROR_INVALID_PARAMETER; // Outside 1000..100000 K
+    }
+
+    // Start at McCamy's estimate, a few rows off near the locus, and gallop outwards
+    // until the bracketing pair is enclosed; this keeps the search to a handful of rows
+    const int last = I1D3_PLANCK_COUNT - 1;
+    double k = (x - 0.3320) / (0.1858 - y);
+    double guess = 1e6 / (((449.0 * k + 3525.0) * k + 6823.3) * k + 5524.33);
+    double row = (guess - i1d3_planck_table[0].mired) / (i1d3_planck_table[1].mired - i1d3_planck_table[0].mired);
+    int start = (row > 0 && row < last) ? (int)row : last / 2; // Also catches NaN
+    int lo, len, step = 1;
+    if (i1d3_planck_offset(start, u, v) >= 0) {
+        lo = start;
+        while (lo + step < last && i1d3_planck_offset(lo + step, u, v) >= 0) {
+            lo += step;
+            step *= 2;
+        }
+        len = (lo + step < last) ? step : last - lo;
+    } else {
+        int end = start;
+        while (end - step > 0 && i1d3_planck_offset(end - step, u, v) < 0) {
+            end -= step;
+            step *= 2;
+        }
+        lo = (end - step > 0) ? end - step : 0;
+        len = end - lo;
+    }
+
+    // Binary search for the last line with offset >= 0. The step is a select rather
+    // than a branch: the outcome is unpredictable, a mispredict costs more than the load.
+    while (len > 1) {
+        int half = len / 2;
+        lo = (i1d3_planck_offset(lo + half, u, v) >= 0) ? lo + half : lo;
+        len -= half;
+    }
+    int hi = lo + 1;
+    double d_lo = i1d3_planck_offset(lo, u, v), d_hi = i1d3_planck_offset(hi, u, v);
+
+    // Interpolate between the two lines in mired, where the locus is nearly uniform
+    const i1d3_planck_point *a = &i1d3_planck_table[lo], *b = &i1d3_planck_table[hi];
+    double f = d_lo / (d_lo - d_hi);
+    double mired = a->mired + f * (b->mired - a->mired);
+    double lu = a->u + f * (b->u - a->u), lv = a->v + f * (b->v - a->v);
+    double tu = a->tu + f * (b->tu - a->tu), tv = a->tv + f * (b->tv - a->tv);
+
+    // Duv is positive above the locus (towards green), negative below (towards magenta)
+    double du = u - lu, dv = v - lv;
+    double side = dv * tu - du * tv;
+    if (cct) *cct = 1e6 / mired;
+    if (duv) *duv = copysign(sqrt(du * du + dv * dv), side);
+    return I1D3_SUCCESS;
+}
@@ -0,0 +1,272 @@
+/* Batch colorimetry: raw counts -> XYZ -> xy/CCT/Duv/Lab over structure-of-arrays data */
+#include "i1d3_api.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define I1D3_HAVE_X86 1
+#include <immintrin.h>
+#define I1D3_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#define I1D3_HZ_SCALE 12000000.0    // Frequency = (cnt - 1) * 0.25 / (clk / 48 MHz) = (cnt - 1) * 12e6 / clk
+#define I1D3_WHITE_X 96.42          // D50 reference white of the Lab conversion
+#define I1D3_WHITE_Y 100.0
+#define I1D3_WHITE_Z 82.49
+#define I1D3_LAB_KNEE 0.008856      // Below this Lab f(t) is linear
+#define I1D3_LAB_SLOPE 7.787
+#define I1D3_LAB_OFFSET (16.0 / 116.0)
+#define I1D3_CBRT_MAGIC 0x2a5137a0  // Exponent bias for the bit-level cube root estimate of a float
+
+static int convert_simd = I1D3_SIMD_AUTO; // Forced instruction set (relaxed atomic)
+
+// --- Scalar ---
+
+// One Halley step for y = cbrt(x): triples the number of correct digits
+static double i1d3_halley_cbrt(double y, double x) {
+    double y3 = y * y * y;
+    return y * (y3 + 2.0 * x) / (2.0 * y3 + x);
+}
+
+// Cube root of x >= I1D3_LAB_KNEE: divide the float exponent by 3, then refine
+static double i1d3_fast_cbrt(double x) {
+    float f = (float)x;
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    bits = bits / 3 + I1D3_CBRT_MAGIC;
+    memcpy(&f, &bits, sizeof(f));
+    double y = f;
+    y = i1d3_halley_cbrt(y, x);
+    return i1d3_halley_cbrt(y, x);
+}
+
+// Lab f(t); both sides are evaluated and selected, so there is no data-dependent branch
+static double i1d3_lab_f(double t) {
+    double root = i1d3_fast_cbrt(t > I1D3_LAB_KNEE ? t : I1D3_LAB_KNEE);
+    double linear = I1D3_LAB_SLOPE * t + I1D3_LAB_OFFSET;
+    return t > I1D3_LAB_KNEE ? root : linear;
+}
+
+static void i1d3_convert_scalar(const i1d3_raw_soa *raw, const double m[3][3], const i1d3_color_soa *out, int begin, int n) {
+    for (int i = begin; i < n; i++) {
+        double hz[3];
+        for (int c = 0; c < 3; c++) {
+            uint32_t cnt = raw->count[c][i];
+            hz[c] = (cnt > 1) ? (cnt - 1.0) * I1D3_HZ_SCALE / raw->clock[c][i] : 0.0;
+        }
+        double X = m[0][0] * hz[0] + m[0][1] * hz[1] + m[0][2] * hz[2];
+        double Y = m[1][0] * hz[0] + m[1][1] * hz[1] + m[1][2] * hz[2];
+        double Z = m[2][0] * hz[0] + m[2][1] * hz[1] + m[2][2] * hz[2];
+        out->X[i] = X; out->Y[i] = Y; out->Z[i] = Z;
+
+        double sum = X + Y + Z;
+        double x = (sum > 0) ? X / sum : 0, y = (sum > 0) ? Y / sum : 0;
+        if (out->x) out->x[i] = x;
+        if (out->y) out->y[i] = y;
+        if (out->L || out->a || out->b) {
+            double fX = i1d3_lab_f(X / I1D3_WHITE_X), fY = i1d3_lab_f(Y / I1D3_WHITE_Y), fZ = i1d3_lab_f(Z / I1D3_WHITE_Z);
+            if (out->L) out->L[i] = 116.0 * fY - 16.0;
+            if (out->a) out->a[i] = 500.0 * (fX - fY);
+            if (out->b) out->b[i] = 200.0 * (fY - fZ);
+        }
+    }
+}
+
+#ifdef I1D3_HAVE_X86
+
+// --- SSE2: 2 readings per step ---
+
+static __m128d i1d3_sse2_select(__m128d mask, __m128d yes, __m128d no) {
+    return _mm_or_pd(_mm_and_pd(mask, yes), _mm_andnot_pd(mask, no));
+}
+
+// Two uint32 -> double (the conversion is signed, so add 2^32 back to wrapped values)
+static __m128d i1d3_sse2_load_u32(const uint32_t *p) {
+    __m128d d = _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i *)p));
+    return _mm_add_pd(d, _mm_and_pd(_mm_cmplt_pd(d, _mm_setzero_pd()), _mm_set1_pd(4294967296.0)));
+}
+
+static __m128d i1d3_sse2_halley(__m128d y, __m128d x) {
+    __m128d y3 = _mm_mul_pd(_mm_mul_pd(y, y), y);
+    __m128d num = _mm_add_pd(y3, _mm_add_pd(x, x));
+    __m128d den = _mm_add_pd(_mm_add_pd(y3, y3), x);
+    return _mm_div_pd(_mm_mul_pd(y, num), den);
+}
+
+static __m128d i1d3_sse2_lab_f(__m128d t) {
+    const __m128d knee = _mm_set1_pd(I1D3_LAB_KNEE);
+    __m128d x = _mm_max_pd(t, knee);
+    // Estimate on the float bits: bits / 3 + magic (the division runs in float arithmetic)
+    __m128i bits = _mm_castps_si128(_mm_cvtpd_ps(x));
+    bits = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(bits), _mm_set1_ps(1.0f / 3.0f)));
+    bits = _mm_add_epi32(bits, _mm_set1_epi32(I1D3_CBRT_MAGIC));
+    __m128d root = _mm_cvtps_pd(_mm_castsi128_ps(bits));
+    root = i1d3_sse2_halley(i1d3_sse2_halley(root, x), x);
+    __m128d linear = _mm_add_pd(_mm_mul_pd(t, _mm_set1_pd(I1D3_LAB_SLOPE)), _mm_set1_pd(I1D3_LAB_OFFSET));
+    return i1d3_sse2_select(_mm_cmpgt_pd(t, knee), root, linear);
+}
+
+static int i1d3_convert_sse2(const i1d3_raw_soa *raw, const double m[3][3], const i1d3_color_soa *out, int n) {
+    const __m128d one = _mm_set1_pd(1.0), zero = _mm_setzero_pd(), scale = _mm_set1_pd(I1D3_HZ_SCALE);
+    const bool lab = out->L || out->a || out->b;
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d hz[3];
+        for (int c = 0; c < 3; c++) {
+            __m128d cnt = i1d3_sse2_load_u32(raw->count[c] + i);
+            __m128d clk = i1d3_sse2_load_u32(raw->clock[c] + i);
+            __m128d f = _mm_div_pd(_mm_mul_pd(_mm_sub_pd(cnt, one), scale), clk);
+            hz[c] = _mm_and_pd(_mm_cmpgt_pd(cnt, one), f);
+        }
+        __m128d xyz[3];
+        for (int r = 0; r < 3; r++) {
+            xyz[r] = _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(m[r][0]), hz[0]),
+                                           _mm_mul_pd(_mm_set1_pd(m[r][1]), hz[1])),
+                                _mm_mul_pd(_mm_set1_pd(m[r][2]), hz[2]));
+        }
+        _mm_storeu_pd(out->X + i, xyz[0]);
+        _mm_storeu_pd(out->Y + i, xyz[1]);
+        _mm_storeu_pd(out->Z + i, xyz[2]);
+
+        __m128d sum = _mm_add_pd(_mm_add_pd(xyz[0], xyz[1]), xyz[2]);
+        __m128d positive = _mm_cmpgt_pd(sum, zero);
+        __m128d x = _mm_and_pd(positive, _mm_div_pd(xyz[0], sum));
+        __m128d y = _mm_and_pd(positive, _mm_div_pd(xyz[1], sum));
+        if (out->x) _mm_storeu_pd(out->x + i, x);
+        if (out->y) _mm_storeu_pd(out->y + i, y);
+        if (lab) {
+            __m128d fX = i1d3_sse2_lab_f(_mm_mul_pd(xyz[0], _mm_set1_pd(1.0 / I1D3_WHITE_X)));
+            __m128d fY = i1d3_sse2_lab_f(_mm_mul_pd(xyz[1], _mm_set1_pd(1.0 / I1D3_WHITE_Y)));
+            __m128d fZ = i1d3_sse2_lab_f(_mm_mul_pd(xyz[2], _mm_set1_pd(1.0 / I1D3_WHITE_Z)));
+            if (out->L) _mm_storeu_pd(out->L + i, _mm_sub_pd(_mm_mul_pd(_mm_set1_pd(116.0), fY), _mm_set1_pd(16.0)));
+            if (out->a) _mm_storeu_pd(out->a + i, _mm_mul_pd(_mm_set1_pd(500.0), _mm_sub_pd(fX, fY)));
+            if (out->b) _mm_storeu_pd(out->b + i, _mm_mul_pd(_mm_set1_pd(200.0), _mm_sub_pd(fY, fZ)));
+        }
+    }
+    return i;
+}
+
+// --- AVX2: 4 readings per step ---
+
+I1D3_TARGET_AVX2 static __m256d i1d3_avx2_load_u32(const uint32_t *p) {
+    __m256d d = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)p));
+    __m256d wrapped = _mm256_cmp_pd(d, _mm256_setzero_pd(), _CMP_LT_OQ);
+    return _mm256_add_pd(d, _mm256_and_pd(wrapped, _mm256_set1_pd(4294967296.0)));
+}
+
+I1D3_TARGET_AVX2 static __m256d i1d3_avx2_halley(__m256d y, __m256d x) {
+    __m256d y3 = _mm256_mul_pd(_mm256_mul_pd(y, y), y);
+    __m256d num = _mm256_add_pd(y3, _mm256_add_pd(x, x));
+    __m256d den = _mm256_add_pd(_mm256_add_pd(y3, y3), x);
+    return _mm256_div_pd(_mm256_mul_pd(y, num), den);
+}
+
+I1D3_TARGET_AVX2 static __m256d i1d3_avx2_lab_f(__m256d t) {
+    const __m256d knee = _mm256_set1_pd(I1D3_LAB_KNEE);
+    __m256d x = _mm256_max_pd(t, knee);
+    __m128i bits = _mm_castps_si128(_mm256_cvtpd_ps(x));
+    bits = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(bits), _mm_set1_ps(1.0f / 3.0f)));
+    bits = _mm_add_epi32(bits, _mm_set1_epi32(I1D3_CBRT_MAGIC));
+    __m256d root = _mm256_cvtps_pd(_mm_castsi128_ps(bits));
+    root = i1d3_avx2_halley(i1d3_avx2_halley(root, x), x);
+    __m256d linear = _mm256_add_pd(_mm256_mul_pd(t, _mm256_set1_pd(I1D3_LAB_SLOPE)), _mm256_set1_pd(I1D3_LAB_OFFSET));
+    return _mm256_blendv_pd(linear, root, _mm256_cmp_pd(t, knee, _CMP_GT_OQ));
+}
+
+I1D3_TARGET_AVX2 static int i1d3_convert_avx2(const i1d3_raw_soa *raw, const double m[3][3], const i1d3_color_soa *out, int n) {
+    const __m256d one = _mm256_set1_pd(1.0), zero = _mm256_setzero_pd(), scale = _mm256_set1_pd(I1D3_HZ_SCALE);
+    const bool lab = out->L || out->a || out->b;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d hz[3];
+        for (int c = 0; c < 3; c++) {
+            __m256d cnt = i1d3_avx2_load_u32(raw->count[c] + i);
+            __m256d clk = i1d3_avx2_load_u32(raw->clock[c] + i);
+            __m256d f = _mm256_div_pd(_mm256_mul_pd(_mm256_sub_pd(cnt, one), scale), clk);
+            hz[c] = _mm256_and_pd(_mm256_cmp_pd(cnt, one, _CMP_GT_OQ), f);
+        }
+        __m256d xyz[3];
+        for (int r = 0; r < 3; r++) {
+            xyz[r] = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(m[r][0]), hz[0]),
+                                                 _mm256_mul_pd(_mm256_set1_pd(m[r][1]), hz[1])),
+                                   _mm256_mul_pd(_mm256_set1_pd(m[r][2]), hz[2]));
+        }
+        _mm256_storeu_pd(out->X + i, xyz[0]);
+        _mm256_storeu_pd(out->Y + i, xyz[1]);
+        _mm256_storeu_pd(out->Z + i, xyz[2]);
+
+        __m256d sum = _mm256_add_pd(_mm256_add_pd(xyz[0], xyz[1]), xyz[2]);
+        __m256d positive = _mm256_cmp_pd(sum, zero, _CMP_GT_OQ);
+        __m256d x = _mm256_and_pd(positive, _mm256_div_pd(xyz[0], sum));
+        __m256d y = _mm256_and_pd(positive, _mm256_div_pd(xyz[1], sum));
+        if (out->x) _mm256_storeu_pd(out->x + i, x);
+        if (out->y) _mm256_storeu_pd(out->y + i, y);
+        if (lab) {
+            __m256d fX = i1d3_avx2_lab_f(_mm256_mul_pd(xyz[0], _mm256_set1_pd(1.0 / I1D3_WHITE_X)));
+            __m256d fY = i1d3_avx2_lab_f(_mm256_mul_pd(xyz[1], _mm256_set1_pd(1.0 / I1D3_WHITE_Y)));
+            __m256d fZ = i1d3_avx2_lab_f(_mm256_mul_pd(xyz[2], _mm256_set1_pd(1.0 / I1D3_WHITE_Z)));
+            if (out->L) _mm256_storeu_pd(out->L + i, _mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(116.0), fY), _mm256_set1_pd(16.0)));
+            if (out->a) _mm256_storeu_pd(out->a + i, _mm256_mul_pd(_mm256_set1_pd(500.0), _mm256_sub_pd(fX, fY)));
+            if (out->b) _mm256_storeu_pd(out->b + i, _mm256_mul_pd(_mm256_set1_pd(200.0), _mm256_sub_pd(fY, fZ)));
+        }
+    }
+    return i;
+}
+
+#endif // I1D3_HAVE_X86
+
+// --- Dispatch ---
+
+static i1d3_simd_t i1d3_detect_simd(void) {
+#ifdef I1D3_HAVE_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? I1D3_SIMD_AVX2 : I1D3_SIMD_SSE2;
+#else
+    return I1D3_SIMD_SCALAR;
+#endif
+}
+
+i1d3_error_t i1d3_set_convert_simd(i1d3_simd_t simd) {
+    if (simd < I1D3_SIMD_AUTO || simd > i1d3_detect_simd()) return I1D3_ERROR_INVALID_PARAMETER;
+    __atomic_store_n(&convert_simd, (int)simd, __ATOMIC_RELAXED);
+    return I1D3_SUCCESS;
+}
+
+i1d3_simd_t i1d3_get_convert_simd(void) {
+    int simd = __atomic_load_n(&convert_simd, __ATOMIC_RELAXED);
+    return simd == I1D3_SIMD_AUTO ? i1d3_detect_simd() : (i1d3_simd_t)simd;
+}
+
+i1d3_error_t i1d3_convert_batch(const i1d3_raw_soa *raw, int n, const double matrix[3][3], const i1d3_color_soa *out) {
+    if (!raw || !matrix || !out || n < 0) return I1D3_ERROR_INVALID_PARAMETER;
+    if (n == 0) return I1D3_SUCCESS;
+    if (!out->X || !out->Y || !out->Z) return I1D3_ERROR_INVALID_PARAMETER;
+    for (int c = 0; c < 3; c++) {
+        if (!raw->count[c] || !raw->clock[c]) return I1D3_ERROR_INVALID_PARAMETER;
+    }
+
+    // Vector kernels cover whole steps; the scalar loop finishes the tail
+    int done = 0;
+    switch (i1d3_get_convert_simd()) {
+#ifdef I1D3_HAVE_X86
+        case I1D3_SIMD_AVX2: done = i1d3_convert_avx2(raw, matrix, out, n); break;
+        case I1D3_SIMD_SSE2: done = i1d3_convert_sse2(raw, matrix, out, n); break;
+#endif
+        default: break;
+    }
+    i1d3_convert_scalar(raw, matrix, out, done, n);
+
+    // CCT/Duv is a table search per reading; it reads back the XYZ just written
+    if (out->CCT || out->Duv) {
+        for (int i = 0; i < n; i++) {
+            double sum = out->X[i] + out->Y[i] + out->Z[i], cct, duv;
+            if (sum > 0) {
+                i1d3_xy_to_cct(out->X[i] / sum, out->Y[i] / sum, &cct, &duv);
+            } else {
+                cct = duv = 0;
+            }
+            if (out->CCT) out->CCT[i] = cct;
+            if (out->Duv) out->Duv[i] = duv;
+        }
+    }
+    return I1D3_SUCCESS;
+}
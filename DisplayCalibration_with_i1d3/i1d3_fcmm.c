@@ -0,0 +1,110 @@
+/* Sensor correction: least-squares forward colour matrix (FCMM) from paired readings */
+#include "i1d3_api.h"
+#include <string.h>
+#include <math.h>
+
+#define I1D3_FCMM_PIVOT_MIN 1e-10  // Smallest pivot of the equilibrated normal matrix (rank check)
+
+// CIE 1976 u'v' of an XYZ triple, false for black
+static bool i1d3_fcmm_uv(const double xyz[3], double *u, double *v) {
+    double den = xyz[0] + 15.0 * xyz[1] + 3.0 * xyz[2];
+    if (!(den > 0)) return false;
+    *u = 4.0 * xyz[0] / den;
+    *v = 9.0 * xyz[1] / den;
+    return true;
+}
+
+// Solve a * x = b in place for k unknowns and 3 right-hand sides (Gaussian elimination,
+// partial pivoting). The rows and columns are scaled to a unit diagonal first, so the
+// pivot threshold does not depend on the luminance of the patches.
+static bool i1d3_fcmm_gauss(double a[4][4], double b[4][3], int k) {
+    double scale[4];
+    for (int i = 0; i < k; i++) {
+        if (!(a[i][i] > 0)) return false;
+        scale[i] = 1.0 / sqrt(a[i][i]);
+    }
+    for (int i = 0; i < k; i++) {
+        for (int j = 0; j < k; j++) a[i][j] *= scale[i] * scale[j];
+        for (int c = 0; c < 3; c++) b[i][c] *= scale[i];
+    }
+
+    for (int col = 0; col < k; col++) {
+        int pivot = col;
+        for (int r = col + 1; r < k; r++) {
+            if (fabs(a[r][col]) > fabs(a[pivot][col])) pivot = r;
+        }
+        if (!(fabs(a[pivot][col]) > I1D3_FCMM_PIVOT_MIN)) return false;
+        if (pivot != col) {
+            double t[4], u[3];
+            memcpy(t, a[col], sizeof(t)); memcpy(a[col], a[pivot], sizeof(t)); memcpy(a[pivot], t, sizeof(t));
+            memcpy(u, b[col], sizeof(u)); memcpy(b[col], b[pivot], sizeof(u)); memcpy(b[pivot], u, sizeof(u));
+        }
+        for (int r = col + 1; r < k; r++) {
+            double f = a[r][col] / a[col][col];
+            for (int j = col; j < k; j++) a[r][j] -= f * a[col][j];
+            for (int c = 0; c < 3; c++) b[r][c] -= f * b[col][c];
+        }
+    }
+    for (int row = k - 1; row >= 0; row--) {
+        for (int c = 0; c < 3; c++) {
+            double sum = b[row][c];
+            for (int j = row + 1; j < k; j++) sum -= a[row][j] * b[j][c];
+            b[row][c] = sum / a[row][row];
+        }
+    }
+    for (int i = 0; i < k; i++) {
+        for (int c = 0; c < 3; c++) b[i][c] *= scale[i];
+    }
+    return true;
+}
+
+i1d3_error_t i1d3_fcmm_solve(const i1d3_fcmm_sample *samples, int n, int flags, i1d3_fcmm_fit *fit) {
+    if (!samples || !fit) return I1D3_ERROR_INVALID_PARAMETER;
+    memset(fit, 0, sizeof(*fit));
+    int k = (flags & I1D3_FCMM_OFFSET) ? 4 : 3;
+    if (n < k) return I1D3_ERROR_INVALID_PARAMETER;
+
+    // Normal equations: (sum w a a^T) x = sum w a ref^T, with a = (meas, 1)
+    double ata[4][4] = {{0}}, atb[4][3] = {{0}};
+    for (int i = 0; i < n; i++) {
+        const i1d3_fcmm_sample *s = &samples[i];
+        double a[4] = {s->meas[0], s->meas[1], s->meas[2], 1.0};
+        double w = 1.0;
+        if (flags & I1D3_FCMM_RELATIVE) {
+            if (!(s->ref[1] > 0)) return I1D3_ERROR_INVALID_PARAMETER;
+            w = 1.0 / (s->ref[1] * s->ref[1]);
+        }
+        for (int r = 0; r < k; r++) {
+            for (int c = 0; c < k; c++) ata[r][c] += w * a[r] * a[c];
+            for (int c = 0; c < 3; c++) atb[r][c] += w * a[r] * s->ref[c];
+        }
+    }
+    if (!i1d3_fcmm_gauss(ata, atb, k)) return I1D3_ERROR_INVALID_PARAMETER; // Patches not independent
+
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) fit->matrix[r][c] = atb[c][r];
+        fit->offset[r] = (k == 4) ? atb[3][r] : 0.0;
+    }
+
+    // Residuals of the corrected readings, unweighted
+    double sq = 0;
+    for (int i = 0; i < n; i++) {
+        double xyz[3], u0, v0, u1, v1;
+        i1d3_fcmm_apply(fit, samples[i].meas, xyz);
+        for (int c = 0; c < 3; c++) sq += (xyz[c] - samples[i].ref[c]) * (xyz[c] - samples[i].ref[c]);
+        if (i1d3_fcmm_uv(xyz, &u0, &v0) && i1d3_fcmm_uv(samples[i].ref, &u1, &v1)) {
+            double duv = hypot(u0 - u1, v0 - v1);
+            if (duv > fit->max_duv) fit->max_duv = duv;
+        }
+    }
+    fit->rms = sqrt(sq / (3.0 * n));
+    fit->count = n;
+    return I1D3_SUCCESS;
+}
+
+void i1d3_fcmm_apply(const i1d3_fcmm_fit *fit, const double meas[3], double xyz[3]) {
+    double in[3] = {meas[0], meas[1], meas[2]};
+    for (int r = 0; r < 3; r++) {
+        xyz[r] = fit->matrix[r][0] * in[0] + fit->matrix[r][1] * in[1] + fit->matrix[r][2] * in[2] + fit->offset[r];
+    }
+}
@@ -0,0 +1,268 @@
+/* Multi-sensor manager: drives several i1d3 devices concurrently */
+#define _DEFAULT_SOURCE // poll(), clock_gettime() and pthreads under -std=c99
+#include "i1d3_api.h"
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+
+#define I1D3_MANAGER_TICK_MS 10 // Upper bound between reply deadline checks
+// Longest a sensor may keep measure_all waiting: an auto-ranging probe and the longest
+// integration, each with its reply deadline, and slack
+#define I1D3_MANAGER_MEASURE_TIMEOUT_MS ((int64_t)(I1D3_INTEGRATION_MAX * 1000.0) + 2000)
+
+struct i1d3_manager {
+    i1d3_device **devices;
+    bool *owned; // Opened by the manager (attach/hotplug), closed on remove/destroy
+    int count;
+    int capacity;
+};
+
+i1d3_manager *i1d3_manager_create(void) {
+    return calloc(1, sizeof(i1d3_manager));
+}
+
+void i1d3_manager_destroy(i1d3_manager *mgr) {
+    if (!mgr) return;
+    for (int i = 0; i < mgr->count; i++) {
+        if (mgr->owned[i]) i1d3_device_close(mgr->devices[i]);
+    }
+    free(mgr->devices);
+    free(mgr->owned);
+    free(mgr);
+}
+
+static i1d3_error_t i1d3_manager_insert(i1d3_manager *mgr, i1d3_device *dev, bool owned) {
+    if (mgr->count == mgr->capacity) {
+        int capacity = mgr->capacity ? mgr->capacity * 2 : 4;
+        i1d3_device **grown = realloc(mgr->devices, capacity * sizeof(*grown));
+        if (!grown) return I1D3_ERROR_OPEN_FAILED;
+        mgr->devices = grown;
+        bool *grown_owned = realloc(mgr->owned, capacity * sizeof(*grown_owned));
+        if (!grown_owned) return I1D3_ERROR_OPEN_FAILED;
+        mgr->owned = grown_owned;
+        mgr->capacity = capacity;
+    }
+    mgr->owned[mgr->count] = owned;
+    mgr->devices[mgr->count++] = dev;
+    return I1D3_SUCCESS;
+}
+
+i1d3_error_t i1d3_manager_add(i1d3_manager *mgr, i1d3_device *dev) {
+    if (!mgr || !dev) return I1D3_ERROR_INVALID_PARAMETER;
+    return i1d3_manager_insert(mgr, dev, false);
+}
+
+i1d3_error_t i1d3_manager_remove(i1d3_manager *mgr, i1d3_device *dev) {
+    if (!mgr || !dev) return I1D3_ERROR_INVALID_PARAMETER;
+
+    for (int i = 0; i < mgr->count; i++) {
+        if (mgr->devices[i] != dev) continue;
+        if (mgr->owned[i]) i1d3_device_close(dev);
+        memmove(&mgr->devices[i], &mgr->devices[i + 1], (mgr->count - i - 1) * sizeof(*mgr->devices));
+        memmove(&mgr->owned[i], &mgr->owned[i + 1], (mgr->count - i - 1) * sizeof(*mgr->owned));
+        mgr->count--;
+        return I1D3_SUCCESS;
+    }
+    return I1D3_ERROR_INVALID_PARAMETER;
+}
+
+int i1d3_manager_count(const i1d3_manager *mgr) {
+    return mgr ? mgr->count : 0;
+}
+
+i1d3_device *i1d3_manager_device(const i1d3_manager *mgr, int index) {
+    if (!mgr || index < 0 || index >= mgr->count) return NULL;
+    return mgr->devices[index];
+}
+
+// --- Discovery and hotplug ---
+
+static i1d3_device *i1d3_manager_find_path(const i1d3_manager *mgr, const char *path) {
+    for (int i = 0; i < mgr->count; i++) {
+        if (strcmp(i1d3_device_path(mgr->devices[i]), path) == 0) return mgr->devices[i];
+    }
+    return NULL;
+}
+
+// Open path and add it as an owned device. Returns 1 if added, 0 if already present.
+static int i1d3_manager_attach(i1d3_manager *mgr, const char *path) {
+    if (i1d3_manager_find_path(mgr, path)) return 0;
+
+    i1d3_error_t result;
+    i1d3_device *dev = i1d3_device_open(path, &result);
+    if (!dev) return result;
+    result = i1d3_manager_insert(mgr, dev, true);
+    if (result != I1D3_SUCCESS) {
+        i1d3_device_close(dev);
+        return result;
+    }
+    return 1;
+}
+
+int i1d3_manager_attach_all(i1d3_manager *mgr) {
+    if (!mgr) return I1D3_ERROR_INVALID_PARAMETER;
+
+    int n = i1d3_discover(NULL, 0);
+    if (n <= 0) return n;
+    i1d3_device_info *list = calloc(n, sizeof(*list));
+    if (!list) return I1D3_ERROR_OPEN_FAILED;
+    int found = i1d3_discover(list, n);
+    if (found < n) n = found;
+
+    int added = 0;
+    i1d3_error_t first_error = I1D3_SUCCESS;
+    for (int i = 0; i < n; i++) {
+        int result = i1d3_manager_attach(mgr, list[i].path);
+        if (result > 0) added++;
+        else if (result < 0 && first_error == I1D3_SUCCESS) first_error = result;
+    }
+    free(list);
+    return (added == 0 && first_error != I1D3_SUCCESS) ? first_error : added;
+}
+
+int i1d3_manager_hotplug(i1d3_manager *mgr, i1d3_monitor *mon) {
+    if (!mgr || !mon) return I1D3_ERROR_INVALID_PARAMETER;
+
+    int changed = 0;
+    i1d3_error_t first_error = I1D3_SUCCESS;
+    i1d3_hotplug_event event;
+    int ready;
+    while ((ready = i1d3_monitor_read(mon, &event)) > 0) {
+        int result = 0;
+        if (event.action == I1D3_HOTPLUG_ADD) {
+            result = i1d3_manager_attach(mgr, event.info.path);
+        } else {
+            i1d3_device *dev = i1d3_manager_find_path(mgr, event.info.path);
+            if (dev && i1d3_manager_remove(mgr, dev) == I1D3_SUCCESS) result = 1;
+        }
+        if (result > 0) changed++;
+        else if (result < 0 && first_error == I1D3_SUCCESS) first_error = result;
+    }
+    if (ready < 0 && first_error == I1D3_SUCCESS) first_error = ready;
+    return (changed == 0 && first_error != I1D3_SUCCESS) ? first_error : changed;
+}
+
+// --- Parallel init + unlock (one thread per device) ---
+
+typedef struct {
+    i1d3_device *dev;
+    i1d3_error_t result;
+} i1d3_prepare_job;
+
+static void *i1d3_prepare_worker(void *arg) {
+    i1d3_prepare_job *job = arg;
+    int fd = i1d3_device_fd(job->dev);
+
+    job->result = I1D3_SUCCESS;
+    if (i1d3_get_state(fd) == I1D3_STATE_CONNECTED) {
+        job->result = i1d3_init_sequence(fd);
+    }
+    if (job->result == I1D3_SUCCESS && i1d3_get_state(fd) == I1D3_STATE_INITIALIZED) {
+        job->result = i1d3_auto_find_unlock(fd);
+    }
+    return NULL;
+}
+
+i1d3_error_t i1d3_manager_prepare_all(i1d3_manager *mgr, i1d3_error_t *status) {
+    if (!mgr) return I1D3_ERROR_INVALID_PARAMETER;
+    if (mgr->count == 0) return I1D3_SUCCESS;
+
+    i1d3_prepare_job *jobs = calloc(mgr->count, sizeof(*jobs));
+    pthread_t *threads = calloc(mgr->count, sizeof(*threads));
+    bool *started = calloc(mgr->count, sizeof(*started));
+    if (!jobs || !threads || !started) {
+        free(jobs); free(threads); free(started);
+        return I1D3_ERROR_OPEN_FAILED;
+    }
+
+    for (int i = 0; i < mgr->count; i++) {
+        jobs[i].dev = mgr->devices[i];
+        started[i] = (pthread_create(&threads[i], NULL, i1d3_prepare_worker, &jobs[i]) == 0);
+        if (!started[i]) i1d3_prepare_worker(&jobs[i]); // Fall back to running it inline
+    }
+
+    i1d3_error_t first_error = I1D3_SUCCESS;
+    for (int i = 0; i < mgr->count; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+        if (status) status[i] = jobs[i].result;
+        if (first_error == I1D3_SUCCESS) first_error = jobs[i].result;
+    }
+
+    free(jobs); free(threads); free(started);
+    return first_error;
+}
+
+// --- Concurrent measurement (single poll loop) ---
+
+static int64_t i1d3_manager_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+i1d3_error_t i1d3_manager_measure_all(i1d3_manager *mgr, i1d3_color_results *results, i1d3_error_t *status) {
+    if (!mgr || !results) return I1D3_ERROR_INVALID_PARAMETER;
+    if (mgr->count == 0) return I1D3_SUCCESS;
+
+    int n = mgr->count;
+    i1d3_error_t *result = calloc(n, sizeof(*result));
+    bool *pending = calloc(n, sizeof(*pending));
+    struct pollfd *pfds = calloc(n, sizeof(*pfds));
+    if (!result || !pending || !pfds) {
+        free(result); free(pending); free(pfds);
+        return I1D3_ERROR_OPEN_FAILED;
+    }
+
+    // Start every sensor integrating at the same time
+    int remaining = 0;
+    for (int i = 0; i < n; i++) {
+        memset(&results[i], 0, sizeof(results[i]));
+        result[i] = i1d3_measure_start(i1d3_device_fd(mgr->devices[i]));
+        pending[i] = (result[i] == I1D3_SUCCESS);
+        if (pending[i]) remaining++;
+    }
+
+    // Collect replies as they arrive. The tick bounds how late a missing reply is noticed; the
+    // loop's own deadline keeps a sensor that never answers from holding up the others.
+    int64_t deadline = i1d3_manager_now_ms() + I1D3_MANAGER_MEASURE_TIMEOUT_MS;
+    while (remaining > 0 && i1d3_manager_now_ms() < deadline) {
+        int k = 0;
+        for (int i = 0; i < n; i++) {
+            if (!pending[i]) continue;
+            pfds[k].fd = i1d3_device_fd(mgr->devices[i]);
+            pfds[k].events = POLLIN;
+            pfds[k].revents = 0;
+            k++;
+        }
+        poll(pfds, k, I1D3_MANAGER_TICK_MS);
+
+        for (int i = 0; i < n; i++) {
+            if (!pending[i]) continue;
+            int fd = i1d3_device_fd(mgr->devices[i]);
+            int ready = i1d3_measure_poll(fd);
+            if (ready == 0) continue;
+
+            result[i] = (ready > 0) ? i1d3_measure_collect(fd, &results[i]) : ready;
+            pending[i] = false;
+            remaining--;
+        }
+    }
+
+    // Past the deadline: a straggler times out in its collect, which returns it to UNLOCKED
+    for (int i = 0; i < n && remaining > 0; i++) {
+        if (!pending[i]) continue;
+        result[i] = i1d3_measure_collect(i1d3_device_fd(mgr->devices[i]), &results[i]);
+        remaining--;
+    }
+
+    i1d3_error_t first_error = I1D3_SUCCESS;
+    for (int i = 0; i < n; i++) {
+        if (status) status[i] = result[i];
+        if (first_error == I1D3_SUCCESS) first_error = result[i];
+    }
+
+    free(result); free(pending); free(pfds);
+    return first_error;
+}
@@ -0,0 +1,214 @@
+/* Continuous acquisition: back-to-back measurements into an SPSC ring */
+#define _DEFAULT_SOURCE // poll() and pthreads under -std=c99
+#include "i1d3_api.h"
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#define I1D3_STREAM_CAPACITY_DEFAULT 256
+#define I1D3_CACHE_LINE 64
+
+/*
+ * Single-producer/single-consumer ring. The producer only writes head and
+ * the consumer only writes tail; each publishes with a release store and
+ * reads the other side with an acquire load. The indices run freely and
+ * are masked on access, so capacity must be a power of two.
+ */
+struct i1d3_stream {
+    i1d3_device *dev;
+    pthread_t thread;
+    int event_fd;            // Readable while samples are pending
+    uint32_t mask;
+    i1d3_stream_sample *ring;
+
+    char pad0[I1D3_CACHE_LINE];
+    uint64_t head;           // Written by the producer thread only
+    uint64_t dropped;        // Samples discarded because the ring was full
+    bool running;            // Cleared by the producer when it exits on its own
+    i1d3_error_t exit_status;
+
+    char pad1[I1D3_CACHE_LINE];
+    uint64_t tail;           // Written by the consumer only
+
+    char pad2[I1D3_CACHE_LINE];
+    bool stop;               // Set by i1d3_stream_stop()
+};
+
+static int64_t i1d3_stream_now_us(void) {
+    return i1d3_clock_now_us();
+}
+
+// Errors after which the device is gone or no longer unlocked
+static bool i1d3_stream_fatal(i1d3_error_t error) {
+    return error == I1D3_ERROR_OPEN_FAILED || error == I1D3_ERROR_NOT_INITIALIZED
+        || error == I1D3_ERROR_INVALID_PARAMETER;
+}
+
+static void i1d3_stream_publish(i1d3_stream *s, const i1d3_stream_sample *sample) {
+    uint64_t head = s->head;
+    uint64_t tail = __atomic_load_n(&s->tail, __ATOMIC_ACQUIRE);
+
+    // Never wait for a slow consumer: drop the new sample instead (seq shows the gap)
+    if (head - tail > s->mask) {
+        __atomic_add_fetch(&s->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    s->ring[head & s->mask] = *sample;
+    __atomic_store_n(&s->head, head + 1, __ATOMIC_RELEASE);
+
+    uint64_t one = 1;
+    if (write(s->event_fd, &one, sizeof(one)) < 0) {
+        // Counter saturated; readers still see the ring contents
+    }
+}
+
+static void *i1d3_stream_worker(void *arg) {
+    i1d3_stream *s = arg;
+    int fd = i1d3_device_fd(s->dev);
+    uint64_t seq = 0;
+    i1d3_error_t exit_status = I1D3_SUCCESS;
+
+    while (!__atomic_load_n(&s->stop, __ATOMIC_ACQUIRE)) {
+        i1d3_stream_sample sample;
+        memset(&sample, 0, sizeof(sample));
+
+        sample.start_us = i1d3_stream_now_us();
+        sample.status = i1d3_aio_measure(fd, &sample.result);
+        sample.end_us = i1d3_stream_now_us();
+        sample.seq = seq++;
+        i1d3_stream_publish(s, &sample);
+
+        if (i1d3_stream_fatal(sample.status)) {
+            exit_status = sample.status;
+            break;
+        }
+    }
+
+    s->exit_status = exit_status;
+    __atomic_store_n(&s->running, false, __ATOMIC_RELEASE);
+    uint64_t one = 1;
+    if (write(s->event_fd, &one, sizeof(one)) < 0) {
+        // Nothing more to do; the thread is exiting
+    }
+    return NULL;
+}
+
+i1d3_stream *i1d3_stream_start(i1d3_device *dev, int capacity, i1d3_error_t *error) {
+    i1d3_error_t result = I1D3_SUCCESS;
+    i1d3_stream *s = NULL;
+
+    if (!dev || capacity < 0) {
+        result = I1D3_ERROR_INVALID_PARAMETER;
+        goto out;
+    }
+    if (i1d3_get_state(i1d3_device_fd(dev)) != I1D3_STATE_UNLOCKED) {
+        result = I1D3_ERROR_NOT_INITIALIZED;
+        goto out;
+    }
+
+    // Round the capacity up to a power of two
+    uint32_t size = 2;
+    uint32_t wanted = capacity ? (uint32_t)capacity : I1D3_STREAM_CAPACITY_DEFAULT;
+    while (size < wanted && size < (1u << 30)) size <<= 1;
+
+    s = calloc(1, sizeof(*s));
+    if (!s || !(s->ring = calloc(size, sizeof(*s->ring)))) {
+        result = I1D3_ERROR_OPEN_FAILED;
+        goto fail;
+    }
+    s->dev = dev;
+    s->mask = size - 1;
+    s->running = true;
+    s->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (s->event_fd < 0) {
+        result = I1D3_ERROR_OPEN_FAILED;
+        goto fail;
+    }
+    if (pthread_create(&s->thread, NULL, i1d3_stream_worker, s) != 0) {
+        close(s->event_fd);
+        result = I1D3_ERROR_OPEN_FAILED;
+        goto fail;
+    }
+    goto out;
+
+fail:
+    if (s) free(s->ring);
+    free(s);
+    s = NULL;
+out:
+    if (error) *error = result;
+    return s;
+}
+
+int i1d3_stream_read(i1d3_stream *s, i1d3_stream_sample *samples, int max) {
+    if (!s || !samples || max < 0) return I1D3_ERROR_INVALID_PARAMETER;
+
+    uint64_t tail = s->tail;
+    uint64_t head = __atomic_load_n(&s->head, __ATOMIC_ACQUIRE);
+    int count = 0;
+
+    while (tail != head && count < max) {
+        samples[count++] = s->ring[tail & s->mask];
+        tail++;
+    }
+    __atomic_store_n(&s->tail, tail, __ATOMIC_RELEASE);
+
+    // Reset the wakeup counter once the ring has been drained
+    if (tail == head) {
+        uint64_t pending;
+        if (read(s->event_fd, &pending, sizeof(pending)) < 0) {
+            // EAGAIN: nothing was signalled
+        }
+        // A sample published between the head load and the reset would be
+        // missed by poll(); re-signal so the next wait does not sleep on it
+        if (__atomic_load_n(&s->head, __ATOMIC_ACQUIRE) != tail) {
+            uint64_t one = 1;
+            if (write(s->event_fd, &one, sizeof(one)) < 0) {
+                // Counter saturated; already readable
+            }
+        }
+    }
+    return count;
+}
+
+int i1d3_stream_wait(i1d3_stream *s, i1d3_stream_sample *samples, int max, int timeout_ms) {
+    if (!s || !samples || max <= 0) return I1D3_ERROR_INVALID_PARAMETER;
+
+    int count = i1d3_stream_read(s, samples, max);
+    if (count != 0) return count;
+    if (!i1d3_stream_running(s)) return 0;
+
+    struct pollfd pfd = { .fd = s->event_fd, .events = POLLIN };
+    int ready = poll(&pfd, 1, timeout_ms);
+    if (ready < 0) return I1D3_ERROR_OPEN_FAILED;
+    return (ready == 0) ? 0 : i1d3_stream_read(s, samples, max);
+}
+
+int i1d3_stream_fd(const i1d3_stream *s) {
+    return s ? s->event_fd : I1D3_ERROR_INVALID_PARAMETER;
+}
+
+bool i1d3_stream_running(const i1d3_stream *s) {
+    return s && __atomic_load_n(&s->running, __ATOMIC_ACQUIRE);
+}
+
+uint64_t i1d3_stream_dropped(const i1d3_stream *s) {
+    return s ? __atomic_load_n(&s->dropped, __ATOMIC_RELAXED) : 0;
+}
+
+i1d3_error_t i1d3_stream_stop(i1d3_stream *s) {
+    if (!s) return I1D3_ERROR_INVALID_PARAMETER;
+
+    // The measurement in flight is allowed to finish so the device is left idle
+    __atomic_store_n(&s->stop, true, __ATOMIC_RELEASE);
+    pthread_join(s->thread, NULL);
+
+    i1d3_error_t result = s->exit_status;
+    close(s->event_fd);
+    free(s->ring);
+    free(s);
+    return result;
+}
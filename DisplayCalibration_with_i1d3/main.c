@@ -5,10 +5,15 @@
 
 #include "i1d3_api.h"
 #include "display_calibration_api.h"
+#include "panel_sim.h"
 
 // Global variables for sensor and calibrator state
 static int i1d3_sensor_fd = -1;
 static Calibrator cal;
+static TvControl *tv_control = NULL; // From --tv, NULL = gains are only printed
+static PanelSim *panel_sim = NULL;        // From --emulate: simulated TV in front of an emulated sensor
+static i1d3_emulator *emulator = NULL;
+static i1d3_virtual_clock virtual_clock;  // Driver clock under --emulate, unless --realtime
 
 // --- Helper Functions ---
 
@@ -37,6 +42,7 @@ void display_menu() {
     printf("2. Read Sensor (Single Measurement)\n");
     printf("3. Change RGB Gain (Manual)\n");
     printf("4. Calibrate RGB Gain (Automatic)\n");
+    printf("5. Calibrate RGB Gain (Automatic, Broyden)\n");
     printf("0. Exit\n");
     printf("------------------\n");
 }
@@ -44,7 +50,7 @@ void display_menu() {
 // --- Debug Menu Action Functions ---
 
 void test_sensor_init() {
-    const char *device_path = "/dev/hidraw0"; // Default i1d3 device path
+    i1d3_device_info found; // First sensor found in sysfs
     printf("[MENU] Initializing Sensor...\n");
 
     if (i1d3_sensor_fd != -1) {
@@ -53,10 +59,29 @@ void test_sensor_init() {
         i1d3_sensor_fd = -1;
     }
 
-    i1d3_sensor_fd = i1d3_open(device_path);
-    if (i1d3_sensor_fd < 0) {
-        fprintf(stderr, "[ERROR] Failed to open i1d3 device: %s (Error Code: %d)\n", i1d3_error_string(i1d3_sensor_fd), i1d3_sensor_fd);
-        return;
+    if (emulator != NULL) {
+        i1d3_error_t open_err;
+        i1d3_device *dev = i1d3_emulator_open(emulator, I1D3_TRANSPORT_INPROC, &open_err);
+        if (dev == NULL) {
+            fprintf(stderr, "[ERROR] Failed to open emulated i1d3: %s\n", i1d3_error_string(open_err));
+            return;
+        }
+        i1d3_sensor_fd = i1d3_device_fd(dev);
+    } else {
+        int sensors = i1d3_discover(&found, 1);
+        if (sensors <= 0) {
+            fprintf(stderr, "[ERROR] No i1d3 device found%s%s\n", sensors < 0 ? ": " : "", sensors < 0 ? i1d3_error_string(sensors) : "");
+            return;
+        }
+        const char *device_path = found.path;
+        if (sensors > 1) printf("[INFO] %d sensors found, using %s.\n", sensors, device_path);
+
+        i1d3_sensor_fd = i1d3_open(device_path);
+        if (i1d3_sensor_fd < 0) {
+            fprintf(stderr, "[ERROR] Failed to open i1d3 device: %s (Error Code: %d)\n", i1d3_error_string(i1d3_sensor_fd), i1d3_sensor_fd);
+            i1d3_sensor_fd = -1;
+            return;
+        }
     }
     printf("[INFO] i1d3 device opened (FD: %d).\n", i1d3_sensor_fd);
 
@@ -80,6 +105,7 @@ void test_sensor_init() {
 
     // Initialize the calibrator with default target and gains
     Calibrator_init(&cal, 0.3127, 0.3290, 192, 192, 192);
+    cal.tv = tv_control;
     printf("[INFO] Calibrator initialized with target (x=%.4f, y=%.4f) and default gains (R%d, G%d, B%d).\n", 
            cal.target_x, cal.target_y, cal.current_gain[0], cal.current_gain[1], cal.current_gain[2]);
 }
@@ -105,9 +131,9 @@ void test_sensor_read() {
     // To get CCT, L, a, b, we need to get the full i1d3_color_results and then copy relevant parts
     i1d3_color_results full_i1d3_res;
     if (i1d3_aio_measure(i1d3_sensor_fd, &full_i1d3_res) == I1D3_SUCCESS) {
-         printf("Full Measurement: X=%.2f, Y=%.2f, Z=%.2f | x=%.4f, y=%.4f | CCT=%.0fK | L=%.1f, a=%.1f, b=%.1f\n",
+         printf("Full Measurement: X=%.2f, Y=%.2f, Z=%.2f | x=%.4f, y=%.4f | CCT=%.0fK, Duv=%+.4f | L=%.1f, a=%.1f, b=%.1f\n",
            full_i1d3_res.X, full_i1d3_res.Y, full_i1d3_res.Z,
-           full_i1d3_res.x, full_i1d3_res.y, full_i1d3_res.CCT, full_i1d3_res.L, full_i1d3_res.a, full_i1d3_res.b);
+           full_i1d3_res.x, full_i1d3_res.y, full_i1d3_res.CCT, full_i1d3_res.Duv, full_i1d3_res.L, full_i1d3_res.a, full_i1d3_res.b);
     }
 }
 
@@ -126,39 +152,56 @@ void test_change_rgb_gain() {
     cal.current_gain[1] = g_gain;
     cal.current_gain[2] = b_gain;
 
-    Calibrator_set_tv_gain(cal.current_gain[0], cal.current_gain[1], cal.current_gain[2]);
+    Calibrator_apply_gain(&cal, cal.current_gain[0], cal.current_gain[1], cal.current_gain[2]);
+    if (Calibrator_flush_gain(&cal) != 0) {
+        fprintf(stderr, "[ERROR] TV did not accept the gain.\n");
+        return;
+    }
     printf("[INFO] TV Gain set to R=%d, G=%d, B=%d.\n", r_gain, g_gain, b_gain);
 }
 
-void test_calibration_rgb_gain() {
-    printf("[MENU] Starting automatic RGB Gain calibration...\n");
+void test_calibration_rgb_gain(CalibratorMode mode) {
+    printf("[MENU] Starting automatic RGB Gain calibration (%s)...\n", mode == CALIBRATOR_MODE_BROYDEN ? "Broyden" : "diagonal");
     if (i1d3_sensor_fd < 0 || i1d3_get_state(i1d3_sensor_fd) != I1D3_STATE_UNLOCKED) {
         fprintf(stderr, "[ERROR] Sensor not initialized or unlocked. Please run '1. Initialize Sensor' first.\n");
         return;
     }
 
-    int num_steps = get_integer_input("Enter number of calibration steps: ");
+    int num_steps = get_integer_input("Enter maximum number of calibration steps: ");
     if (num_steps <= 0) {
         fprintf(stderr, "[ERROR] Number of steps must be positive.\n");
         return;
     }
 
     printf("Initializing calibrator for automatic calibration...\n");
-    // Re-initialize calibrator to reset its state for a fresh calibration run
+    // Re-initialize calibrator to reset its state for a fresh calibration run, keeping what is known about the panel
+    Calibrator prev = cal;
     Calibrator_init(&cal, 0.3127, 0.3290, cal.current_gain[0], cal.current_gain[1], cal.current_gain[2]);
+    memcpy(cal.applied_gain, prev.applied_gain, sizeof(cal.applied_gain));
+    cal.have_applied = prev.have_applied;
+    cal.settled = prev.settled;
+    cal.applied_at = prev.applied_at;
+    cal.settle_time = prev.settle_time;
+    memcpy(cal.settle_ref, prev.settle_ref, sizeof(cal.settle_ref));
+    cal.have_settle_ref = prev.have_settle_ref;
+    memcpy(cal.settle_noise, prev.settle_noise, sizeof(cal.settle_noise));
+    cal.tv = tv_control;
+    Calibrator_set_mode(&cal, mode);
 
     if (Calibrator_check_sensitivity(&cal, i1d3_sensor_fd) != 0) {
         fprintf(stderr, "[ERROR] Failed to check display sensitivity. Aborting calibration.\n");
         return;
     }
 
-    printf("Starting %d calibration steps...\n", num_steps);
-    for (int i = 1; i <= num_steps; i++) {
-        if (Calibrator_perform_calibration_step(&cal, i1d3_sensor_fd, i) != 0) {
-            fprintf(stderr, "[ERROR] Calibration step %d failed. Aborting.\n", i);
-            break;
-        }
-    }
+    CalibratorRunOptions opts;
+    CalibratorRunResult result;
+    Calibrator_default_run_options(&opts);
+    opts.max_steps = num_steps;
+    printf("Running up to %d calibration steps (tolerance %.4f)...\n", num_steps, opts.tolerance);
+    Calibrator_run(&cal, i1d3_sensor_fd, &opts, &result);
+    printf("[INFO] Stopped after %d steps (%.1f s): %s\n", result.steps, result.elapsed,
+           Calibrator_stop_reason_string(result.reason));
+    printf("[INFO] Learned panel settle time: %.0f ms\n", cal.settle_time * 1000.0);
 
     int best_r, best_g, best_b;
     Calibrator_get_best_gain(&cal, &best_r, &best_g, &best_b);
@@ -166,7 +209,8 @@ void test_calibration_rgb_gain() {
     printf("Best Gain Found: R=%d, G=%d, B=%d (Minimum Distance: %.6f)\n", best_r, best_g, best_b, cal.min_dist);
 
     // Apply the best gain at the end of calibration
-    Calibrator_set_tv_gain(best_r, best_g, best_b);
+    Calibrator_apply_gain(&cal, best_r, best_g, best_b);
+    if (Calibrator_flush_gain(&cal) != 0) fprintf(stderr, "[ERROR] TV did not accept the best gain.\n");
     cal.current_gain[0] = best_r;
     cal.current_gain[1] = best_g;
     cal.current_gain[2] = best_b;
@@ -176,12 +220,48 @@ void test_calibration_rgb_gain() {
 
 int main(int argc, char *argv[]) {
     int debug_mode = 0;
+    int print_stats = 0;
+    int emulate = 0;
+    int realtime = 0;
+    unsigned long emulate_seed = 0;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-dbg") == 0) {
             debug_mode = 1;
-            break;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            print_stats = 1;
+        } else if (strcmp(argv[i], "--tv") == 0 && i + 1 < argc) {
+            tv_control = TvControl_open(argv[++i]);
+            if (tv_control == NULL) return 1;
+        } else if (strcmp(argv[i], "--emulate") == 0 && i + 1 < argc) {
+            emulate = 1;
+            emulate_seed = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--realtime") == 0) {
+            realtime = 1;
+        }
+    }
+    if (emulate) {
+        // Seed 0 = default panel, otherwise a random one; the sensor is emulated in-process.
+        // Waits run on a virtual clock (no wall time) unless --realtime asks for real ones.
+        if (!realtime) i1d3_set_clock(&i1d3_virtual_clock_ops, &virtual_clock);
+        PanelSimConfig panel_cfg;
+        if (emulate_seed == 0) {
+            PanelSim_default_config(&panel_cfg);
+        } else {
+            PanelSim_random_config(&panel_cfg, emulate_seed);
+        }
+        panel_sim = PanelSim_create(&panel_cfg);
+        i1d3_emulator_config emu_cfg;
+        i1d3_emulator_default_config(&emu_cfg);
+        emu_cfg.panel = PanelSim_emulator_panel;
+        emu_cfg.panel_user = panel_sim;
+        emulator = panel_sim ? i1d3_emulator_create(&emu_cfg) : NULL;
+        if (emulator == NULL) {
+            fprintf(stderr, "[ERROR] Failed to create the panel simulator.\n");
+            return 1;
         }
     }
+    if (panel_sim != NULL && tv_control == NULL) tv_control = PanelSim_open_tv(panel_sim);
+    if (tv_control == NULL) printf("[INFO] No TV backend (--emulate <seed> or --tv serial:<path>[@baud] | tcp:<host>:<port> | sim[:<ms>]); gains are only printed.\n");
 
     if (debug_mode) {
         int choice;
@@ -193,7 +273,8 @@ int main(int argc, char *argv[]) {
                 case 1: test_sensor_init(); break;
                 case 2: test_sensor_read(); break;
                 case 3: test_change_rgb_gain(); break;
-                case 4: test_calibration_rgb_gain(); break;
+                case 4: test_calibration_rgb_gain(CALIBRATOR_MODE_DIAGONAL); break;
+                case 5: test_calibration_rgb_gain(CALIBRATOR_MODE_BROYDEN); break;
                 case 0: printf("Exiting debug menu.\n"); break;
                 default: printf("Invalid choice. Please try again.\n"); break;
             }
@@ -211,5 +292,18 @@ int main(int argc, char *argv[]) {
         // TODO: Implement normal operational flow here
     }
 
+    if (print_stats) {
+        i1d3_print_stats();
+        if (tv_control != NULL) {
+            TvControlStats st;
+            TvControl_get_stats(tv_control, &st);
+            printf("TV (%s): %ld commands, %ld channels sent, %ld skipped, %ld writes merged, %ld acks, %ld errors\n",
+                   TvControl_name(tv_control), st.commands, st.channels, st.skipped, st.coalesced, st.acks, st.errors);
+        }
+    }
+    TvControl_close(tv_control);
+    i1d3_emulator_destroy(emulator);
+    PanelSim_destroy(panel_sim);
+
     return 0;
 }
@@ -0,0 +1,329 @@
+#define _DEFAULT_SOURCE // pipe() under -std=c99
+#include "panel_sim.h"
+#include "i1d3_api.h" // Driver clock
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#define PANEL_SIM_WINDOW_SAMPLES 16 // Midpoint samples averaged over a reading's integration window
+
+#define PANEL_SIM_PQ_M1 0.1593017578125 // SMPTE ST 2084
+#define PANEL_SIM_PQ_M2 78.84375
+#define PANEL_SIM_PQ_C1 0.8359375
+#define PANEL_SIM_PQ_C2 18.8515625
+#define PANEL_SIM_PQ_C3 18.6875
+#define PANEL_SIM_PQ_PEAK 10000.0
+
+struct PanelSim {
+    PanelSimConfig cfg;
+    PanelSimClock clock;
+    void *clock_user;
+    double epoch;        // Clock reading at time zero
+    int gain[3];
+    double patch[3];
+    double from[3];      // Output when the last change happened
+    double to[3];        // Output the panel is moving towards
+    double changed_at;   // Time of the last change
+    uint64_t rng;        // xorshift64 state
+};
+
+// --- Helpers ---
+
+static uint64_t panel_sim_next(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+    return *state = x;
+}
+
+static double panel_sim_uniform(uint64_t *state) {
+    return ((panel_sim_next(state) >> 11) + 0.5) / 9007199254740992.0; // (0, 1)
+}
+
+static double panel_sim_range(uint64_t *state, double lo, double hi) {
+    return lo + (hi - lo) * panel_sim_uniform(state);
+}
+
+static double panel_sim_gauss(uint64_t *state) {
+    double u1 = panel_sim_uniform(state), u2 = panel_sim_uniform(state);
+    return sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+}
+
+static double panel_sim_driver_clock(void *user) {
+    (void)user;
+    return i1d3_clock_now_us() * 1e-6;
+}
+
+// Primary matrix (columns = XYZ of R, G, B) for primary chromaticities and a white of luminance Y
+static void panel_sim_primaries(const double xy[3][2], double wx, double wy, double Y, double m[3][3]) {
+    double p[3][3], inv[3][3], w[3] = {wx / wy * Y, Y, (1.0 - wx - wy) / wy * Y};
+    for (int c = 0; c < 3; c++) {
+        p[0][c] = xy[c][0] / xy[c][1];
+        p[1][c] = 1.0;
+        p[2][c] = (1.0 - xy[c][0] - xy[c][1]) / xy[c][1];
+    }
+    double det = p[0][0] * (p[1][1] * p[2][2] - p[1][2] * p[2][1])
+               - p[0][1] * (p[1][0] * p[2][2] - p[1][2] * p[2][0])
+               + p[0][2] * (p[1][0] * p[2][1] - p[1][1] * p[2][0]);
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            int r1 = (c + 1) % 3, r2 = (c + 2) % 3, c1 = (r + 1) % 3, c2 = (r + 2) % 3;
+            inv[r][c] = (p[r1][c1] * p[r2][c2] - p[r1][c2] * p[r2][c1]) / det;
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        double scale = inv[c][0] * w[0] + inv[c][1] * w[1] + inv[c][2] * w[2];
+        for (int r = 0; r < 3; r++) m[r][c] = p[r][c] * scale;
+    }
+}
+
+static double panel_sim_eotf(const PanelSimConfig *cfg, int c, double s) {
+    if (s <= 0) return 0.0;
+    if (s > 1) s = 1;
+    switch (cfg->eotf) {
+        case PANEL_SIM_EOTF_SRGB:
+            return s <= 0.04045 ? s / 12.92 : pow((s + 0.055) / 1.055, 2.4);
+        case PANEL_SIM_EOTF_PQ: {
+            double e = pow(s, 1.0 / PANEL_SIM_PQ_M2);
+            double num = e - PANEL_SIM_PQ_C1 > 0 ? e - PANEL_SIM_PQ_C1 : 0.0;
+            double cd = PANEL_SIM_PQ_PEAK * pow(num / (PANEL_SIM_PQ_C2 - PANEL_SIM_PQ_C3 * e), 1.0 / PANEL_SIM_PQ_M1);
+            double white = cfg->primaries[1][0] + cfg->primaries[1][1] + cfg->primaries[1][2];
+            return white > 0 && cd < white ? cd / white : 1.0; // Tone-mapped by clipping at the panel's peak
+        }
+        default:
+            return pow(s, cfg->gamma[c]);
+    }
+}
+
+// Settled output (after crosstalk) for the current patch and gains
+static void panel_sim_target(const PanelSim *sim, double out[3]) {
+    const PanelSimConfig *cfg = &sim->cfg;
+    double o[3];
+    for (int c = 0; c < 3; c++) {
+        o[c] = panel_sim_eotf(cfg, c, sim->patch[c]) * pow(sim->gain[c] / 192.0, cfg->gain_exponent[c]);
+        if (o[c] > cfg->clip) o[c] = cfg->clip;
+    }
+    for (int r = 0; r < 3; r++) {
+        out[r] = cfg->crosstalk[r][0] * o[0] + cfg->crosstalk[r][1] * o[1] + cfg->crosstalk[r][2] * o[2];
+    }
+}
+
+// Output at time t, before drift
+static void panel_sim_output(const PanelSim *sim, double t, double out[3]) {
+    double since = t - sim->changed_at - sim->cfg.settle_delay;
+    double k = since <= 0 ? 1.0 : (sim->cfg.settle_tau > 0 ? exp(-since / sim->cfg.settle_tau) : 0.0);
+    for (int c = 0; c < 3; c++) out[c] = sim->to[c] + (sim->from[c] - sim->to[c]) * k;
+}
+
+static void panel_sim_change(PanelSim *sim, double t) {
+    panel_sim_output(sim, t, sim->from);
+    panel_sim_target(sim, sim->to);
+    sim->changed_at = t;
+}
+
+// --- Configuration ---
+
+void PanelSim_default_config(PanelSimConfig *cfg) {
+    static const double bt709[3][2] = {{0.640, 0.330}, {0.300, 0.600}, {0.150, 0.060}};
+    memset(cfg, 0, sizeof(*cfg));
+    panel_sim_primaries(bt709, 0.3127, 0.3290, 100.0, cfg->primaries);
+    cfg->black[0] = 0.3127 / 0.3290 * 0.05;
+    cfg->black[1] = 0.05;
+    cfg->black[2] = (1.0 - 0.3127 - 0.3290) / 0.3290 * 0.05;
+    cfg->eotf = PANEL_SIM_EOTF_POWER;
+    for (int c = 0; c < 3; c++) {
+        cfg->gamma[c] = 2.2;
+        cfg->gain_exponent[c] = 1.0;
+        cfg->crosstalk[c][c] = 1.0;
+    }
+    cfg->clip = 1.0;
+    cfg->seed = 1;
+}
+
+void PanelSim_random_config(PanelSimConfig *cfg, uint64_t seed) {
+    static const double bt709[3][2] = {{0.640, 0.330}, {0.300, 0.600}, {0.150, 0.060}};
+    static const double p3[3][2] = {{0.680, 0.320}, {0.265, 0.690}, {0.150, 0.060}};
+    uint64_t rng = seed * 0x9E3779B97F4A7C15ull + 1; // Never zero for xorshift
+
+    PanelSim_default_config(cfg);
+    double mix = panel_sim_uniform(&rng), xy[3][2];
+    for (int c = 0; c < 3; c++) {
+        for (int k = 0; k < 2; k++) xy[c][k] = bt709[c][k] + mix * (p3[c][k] - bt709[c][k]) + panel_sim_range(&rng, -0.005, 0.005);
+    }
+    double wx = 0.3127 + panel_sim_range(&rng, -0.01, 0.01), wy = 0.3290 + panel_sim_range(&rng, -0.01, 0.01);
+    double white = panel_sim_range(&rng, 80.0, 500.0), contrast = panel_sim_range(&rng, 1000.0, 5000.0);
+    panel_sim_primaries(xy, wx, wy, white, cfg->primaries);
+    cfg->black[0] = wx / wy * white / contrast;
+    cfg->black[1] = white / contrast;
+    cfg->black[2] = (1.0 - wx - wy) / wy * white / contrast;
+
+    double gamma = panel_sim_range(&rng, 2.0, 2.6), gain_exponent = panel_sim_range(&rng, 1.0, 2.4);
+    for (int c = 0; c < 3; c++) {
+        cfg->gamma[c] = gamma + panel_sim_range(&rng, -0.05, 0.05);
+        cfg->gain_exponent[c] = gain_exponent;
+        for (int k = 0; k < 3; k++) {
+            if (k != c) cfg->crosstalk[c][k] = panel_sim_range(&rng, 0.0, 0.04);
+        }
+        cfg->drift[c] = panel_sim_range(&rng, -0.03, 0.03);
+    }
+    cfg->clip = panel_sim_range(&rng, 0.9, 1.0);
+    cfg->settle_tau = panel_sim_range(&rng, 0.005, 0.150);
+    cfg->settle_delay = panel_sim_range(&rng, 0.0, 0.040);
+    cfg->drift_tau = panel_sim_range(&rng, 120.0, 1200.0);
+    cfg->noise = panel_sim_range(&rng, 0.0002, 0.002);
+    cfg->seed = seed + 1;
+}
+
+// --- Simulator ---
+
+PanelSim *PanelSim_create(const PanelSimConfig *cfg) {
+    PanelSim *sim = calloc(1, sizeof(*sim));
+    if (sim == NULL) return NULL;
+    if (cfg != NULL) {
+        sim->cfg = *cfg;
+    } else {
+        PanelSim_default_config(&sim->cfg);
+    }
+    sim->rng = sim->cfg.seed ? sim->cfg.seed : 1;
+    sim->clock = panel_sim_driver_clock;
+    sim->epoch = panel_sim_driver_clock(NULL);
+    for (int c = 0; c < 3; c++) {
+        sim->gain[c] = 192;
+        sim->patch[c] = 1.0;
+    }
+    panel_sim_target(sim, sim->to);
+    memcpy(sim->from, sim->to, sizeof(sim->from));
+    sim->changed_at = -1e9; // Settled long ago
+    return sim;
+}
+
+void PanelSim_destroy(PanelSim *sim) {
+    free(sim);
+}
+
+void PanelSim_set_clock(PanelSim *sim, PanelSimClock clock, void *user) {
+    if (sim == NULL) return;
+    sim->clock = clock ? clock : panel_sim_driver_clock;
+    sim->clock_user = clock ? user : NULL;
+    sim->epoch = sim->clock(sim->clock_user);
+}
+
+double PanelSim_now(const PanelSim *sim) {
+    return sim ? sim->clock(sim->clock_user) - sim->epoch : 0.0;
+}
+
+void PanelSim_set_gain_at(PanelSim *sim, double t, int r, int g, int b) {
+    if (sim == NULL) return;
+    int gains[3] = {r, g, b};
+    for (int c = 0; c < 3; c++) sim->gain[c] = gains[c] < 0 ? 0 : (gains[c] > 192 ? 192 : gains[c]);
+    panel_sim_change(sim, t);
+}
+
+void PanelSim_set_gain(PanelSim *sim, int r, int g, int b) {
+    PanelSim_set_gain_at(sim, PanelSim_now(sim), r, g, b);
+}
+
+void PanelSim_set_patch_at(PanelSim *sim, double t, double r, double g, double b) {
+    if (sim == NULL) return;
+    sim->patch[0] = r;
+    sim->patch[1] = g;
+    sim->patch[2] = b;
+    panel_sim_change(sim, t);
+}
+
+void PanelSim_set_patch(PanelSim *sim, double r, double g, double b) {
+    PanelSim_set_patch_at(sim, PanelSim_now(sim), r, g, b);
+}
+
+void PanelSim_xyz_at(const PanelSim *sim, double t, double xyz[3]) {
+    const PanelSimConfig *cfg = &sim->cfg;
+    double o[3], warm = cfg->drift_tau > 0 ? 1.0 - exp(-(t > 0 ? t : 0) / cfg->drift_tau) : 1.0;
+    panel_sim_output(sim, t, o);
+    for (int c = 0; c < 3; c++) o[c] *= 1.0 + cfg->drift[c] * warm;
+    for (int r = 0; r < 3; r++) {
+        xyz[r] = cfg->black[r] + cfg->primaries[r][0] * o[0] + cfg->primaries[r][1] * o[1] + cfg->primaries[r][2] * o[2];
+    }
+}
+
+void PanelSim_read_at(PanelSim *sim, double t, double integration, double xyz[3]) {
+    if (integration > 0) {
+        double sample[3];
+        xyz[0] = xyz[1] = xyz[2] = 0;
+        for (int i = 0; i < PANEL_SIM_WINDOW_SAMPLES; i++) {
+            PanelSim_xyz_at(sim, t + (i + 0.5) * integration / PANEL_SIM_WINDOW_SAMPLES, sample);
+            for (int k = 0; k < 3; k++) xyz[k] += sample[k] / PANEL_SIM_WINDOW_SAMPLES;
+        }
+    } else {
+        PanelSim_xyz_at(sim, t, xyz);
+    }
+    if (sim->cfg.noise > 0) {
+        for (int k = 0; k < 3; k++) xyz[k] *= 1.0 + sim->cfg.noise * panel_sim_gauss(&sim->rng);
+    }
+}
+
+void PanelSim_emulator_panel(void *user, double xyz[3]) {
+    PanelSim *sim = user;
+    PanelSim_read_at(sim, PanelSim_now(sim), 0.0, xyz);
+}
+
+// --- TV control backend ---
+
+typedef struct {
+    PanelSim *sim;
+    int rfd, wfd;  // Reply pipe: replies are written as commands arrive
+    char line[128];
+    int len;
+} PanelSimTv;
+
+static int panel_sim_tv_write(void *ctx, const char *buf, int len) {
+    PanelSimTv *tv = ctx;
+    for (int i = 0; i < len; i++) {
+        if (buf[i] != '\n') {
+            if (tv->len < (int)sizeof(tv->line) - 1) tv->line[tv->len++] = buf[i];
+            continue;
+        }
+        tv->line[tv->len] = '\0';
+        tv->len = 0;
+        int gains[3], present[3];
+        const char *reason = TvControl_parse_command(tv->line, gains, present);
+        if (reason == NULL) {
+            for (int c = 0; c < 3; c++) {
+                if (!present[c]) gains[c] = tv->sim->gain[c];
+            }
+            PanelSim_set_gain(tv->sim, gains[0], gains[1], gains[2]);
+        }
+        char reply[64];
+        int rlen = reason ? snprintf(reply, sizeof(reply), "ERR %s\n", reason) : snprintf(reply, sizeof(reply), "OK\n");
+        if (write(tv->wfd, reply, rlen) != rlen) return -1;
+    }
+    return len;
+}
+
+static int panel_sim_tv_read(void *ctx, char *buf, int maxlen) {
+    return (int)read(((PanelSimTv *)ctx)->rfd, buf, maxlen);
+}
+
+static int panel_sim_tv_close(void *ctx) {
+    PanelSimTv *tv = ctx;
+    close(tv->rfd);
+    close(tv->wfd);
+    free(tv);
+    return 0;
+}
+
+static const TvControlOps panel_sim_tv_ops = {"panel_sim", panel_sim_tv_write, panel_sim_tv_read, panel_sim_tv_close};
+
+TvControl *PanelSim_open_tv(PanelSim *sim) {
+    int fds[2];
+    if (sim == NULL) return NULL;
+    PanelSimTv *tv = calloc(1, sizeof(*tv));
+    if (tv == NULL || pipe(fds) != 0) {
+        free(tv);
+        return NULL;
+    }
+    tv->sim = sim;
+    tv->rfd = fds[0];
+    tv->wfd = fds[1];
+    return TvControl_open_ops(&panel_sim_tv_ops, tv, tv->rfd);
+}
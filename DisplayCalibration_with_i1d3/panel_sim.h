@@ -0,0 +1,122 @@
+#ifndef PANEL_SIM_H
+#define PANEL_SIM_H
+
+#include <stdint.h>
+#include "tv_control.h"
+
+/*
+ * Panel physics simulator: what a sensor sees on a TV for a given patch and white-balance gain.
+ *
+ * Per channel c, for patch signal s (0-1) and gain g (0-192):
+ *   L  = eotf(s)                                   relative light of the channel, gamma[c] per channel
+ *   o  = min(L * (g / 192)^gain_exponent[c], clip)  white-balance gain, then the panel's headroom
+ *   o' = crosstalk * o                              leakage between channels
+ *   o' moves towards its new value with dead time settle_delay and time constant settle_tau
+ *   o' *= 1 + drift[c] * (1 - exp(-t / drift_tau))  warm-up since PanelSim_create()
+ *   XYZ = black + primaries * o', then relative noise per reading
+ *
+ * Times are seconds on the simulator's clock: the driver clock (i1d3_set_clock()) unless
+ * PanelSim_set_clock() installs another one. The *_at() functions take the time explicitly, so a controller can be run against
+ * many panels much faster than real time.
+ */
+
+// Transfer from patch signal to relative channel light
+typedef enum {
+    PANEL_SIM_EOTF_POWER = 0, // s^gamma[c]
+    PANEL_SIM_EOTF_SRGB = 1,  // IEC 61966-2-1 piecewise curve (gamma[] unused)
+    PANEL_SIM_EOTF_PQ = 2     // SMPTE ST 2084, relative to the white luminance of primaries (gamma[] unused)
+} PanelSimEotf;
+
+typedef struct {
+    double primaries[3][3];     // XYZ of R, G, B at full output (columns), cd/m2
+    double black[3];            // XYZ at zero output
+    PanelSimEotf eotf;
+    double gamma[3];            // PANEL_SIM_EOTF_POWER exponent per channel
+    double gain_exponent[3];    // Gain nonlinearity: 1 = light proportional to gain
+    double clip;                // Largest channel output (1 = no clipping below full gain)
+    double crosstalk[3][3];     // Output mixing, identity = none
+    double settle_tau;          // First-order settle time constant (s)
+    double settle_delay;        // Dead time before the panel starts to move (s)
+    double drift[3];            // Relative output change per channel once warm
+    double drift_tau;           // Warm-up time constant (s)
+    double noise;               // Relative standard deviation of each XYZ component per reading
+    uint64_t seed;              // Noise seed; equal seeds give equal runs
+} PanelSimConfig;
+
+typedef struct PanelSim PanelSim;
+
+// Time source, seconds
+typedef double (*PanelSimClock)(void *user);
+
+/**
+ * @brief Default panel: BT.709 primaries at 100 cd/m2 white, 0.05 cd/m2 black, gamma 2.2,
+ *        linear gain, no clipping, crosstalk, settle, drift or noise.
+ */
+void PanelSim_default_config(PanelSimConfig *cfg);
+
+/**
+ * @brief A plausible random panel for population runs: primaries between BT.709 and P3 with a
+ *        random white point within ~0.01 xy of D65, gamma 2.0-2.6 per channel, gain exponent
+ *        1-2.4, clipping 0.9-1, up to 4% crosstalk, settle 5-150 ms with 0-40 ms dead time,
+ *        +-3% drift over 2-20 minutes and 0.02-0.2% noise.
+ * @param cfg Output.
+ * @param seed Panel identity; equal seeds give equal panels.
+ */
+void PanelSim_random_config(PanelSimConfig *cfg, uint64_t seed);
+
+/**
+ * @brief Creates a simulator showing a full white patch at gain 192/192/192, settled.
+ * @param cfg Panel, or NULL for PanelSim_default_config().
+ * @return Simulator, or NULL on failure.
+ */
+PanelSim *PanelSim_create(const PanelSimConfig *cfg);
+
+void PanelSim_destroy(PanelSim *sim);
+
+/**
+ * @brief Replaces the clock (NULL restores the driver clock). The simulator's time zero is reset
+ *        to the new clock's current time.
+ */
+void PanelSim_set_clock(PanelSim *sim, PanelSimClock clock, void *user);
+
+/**
+ * @brief Current time on the simulator's clock, seconds since PanelSim_create().
+ */
+double PanelSim_now(const PanelSim *sim);
+
+/**
+ * @brief Changes the white-balance gains at time t; the output starts moving after settle_delay.
+ */
+void PanelSim_set_gain_at(PanelSim *sim, double t, int r, int g, int b);
+void PanelSim_set_gain(PanelSim *sim, int r, int g, int b);
+
+/**
+ * @brief Changes the patch signal (0-1 per channel) at time t.
+ */
+void PanelSim_set_patch_at(PanelSim *sim, double t, double r, double g, double b);
+void PanelSim_set_patch(PanelSim *sim, double r, double g, double b);
+
+/**
+ * @brief Noiseless XYZ the panel emits at time t.
+ */
+void PanelSim_xyz_at(const PanelSim *sim, double t, double xyz[3]);
+
+/**
+ * @brief A sensor reading: XYZ averaged over [t, t + integration], plus noise.
+ */
+void PanelSim_read_at(PanelSim *sim, double t, double integration, double xyz[3]);
+
+/**
+ * @brief i1d3_emulator_panel_fn: user is the PanelSim, read instantaneously at the current clock.
+ *        Set as i1d3_emulator_config.panel to put the simulated panel in front of the emulated sensor.
+ */
+void PanelSim_emulator_panel(void *user, double xyz[3]);
+
+/**
+ * @brief TV control backend that applies GAIN commands to the simulator at the current clock and
+ *        acknowledges them at once. Use as Calibrator.tv.
+ * @return Handle (close with TvControl_close(); the simulator is not owned), or NULL on failure.
+ */
+TvControl *PanelSim_open_tv(PanelSim *sim);
+
+#endif // PANEL_SIM_H
@@ -0,0 +1,417 @@
+#define _DEFAULT_SOURCE // cfmakeraw() and getaddrinfo() under -std=c99
+#include "tv_control.h"
+#include "i1d3_api.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define TV_CONTROL_MAX_INFLIGHT 4        // Commands sent before a reply must be collected
+#define TV_CONTROL_ACK_TIMEOUT_MS 1000   // Longest wait for a reply when one is required
+#define TV_CONTROL_LINE 128              // Longest reply line kept
+
+struct TvControl {
+    const TvControlOps *ops;
+    void *ctx;
+    int fd;
+    int sent[3];          // Gains the TV was last sent, per channel
+    int sent_valid[3];    // sent[] is known (cleared after an error)
+    int pending[3];       // Staged by TvControl_set_gain()
+    int have_pending;
+    int inflight;         // Commands awaiting a reply
+    int64_t reply_delay_us;                   // Replies count as received this long after the command
+    int64_t due_us[TV_CONTROL_MAX_INFLIGHT];  // Driver clock time each reply in flight is due, from due_head
+    int due_head;
+    char rx[TV_CONTROL_LINE];
+    int rx_len;
+    TvControlStats stats;
+};
+
+// --- fd-based backends ---
+
+typedef struct {
+    int fd;
+    pid_t child; // Simulator process, 0 otherwise
+} TvFd;
+
+static int tv_fd_write(void *ctx, const char *buf, int len) {
+    return (int)write(((TvFd *)ctx)->fd, buf, len);
+}
+
+static int tv_sock_write(void *ctx, const char *buf, int len) {
+    return (int)send(((TvFd *)ctx)->fd, buf, len, MSG_NOSIGNAL);
+}
+
+static int tv_fd_read(void *ctx, char *buf, int maxlen) {
+    return (int)read(((TvFd *)ctx)->fd, buf, maxlen);
+}
+
+static int tv_fd_close(void *ctx) {
+    TvFd *t = ctx;
+    int result = close(t->fd);
+    if (t->child > 0) waitpid(t->child, NULL, 0); // Simulator exits on EOF
+    free(t);
+    return result;
+}
+
+static const TvControlOps tv_serial_ops = {"serial", tv_fd_write, tv_fd_read, tv_fd_close};
+static const TvControlOps tv_tcp_ops = {"tcp", tv_sock_write, tv_fd_read, tv_fd_close};
+static const TvControlOps tv_sim_ops = {"sim", tv_sock_write, tv_fd_read, tv_fd_close};
+
+static TvControl *tv_open_fd(const TvControlOps *ops, int fd, pid_t child) {
+    TvFd *t = malloc(sizeof(*t));
+    if (t == NULL) {
+        close(fd);
+        return NULL;
+    }
+    t->fd = fd;
+    t->child = child;
+    return TvControl_open_ops(ops, t, fd);
+}
+
+TvControl *TvControl_open_serial(const char *path, int baud) {
+    speed_t speed;
+    switch (baud) {
+        case 9600: speed = B9600; break;
+        case 19200: speed = B19200; break;
+        case 38400: speed = B38400; break;
+        case 57600: speed = B57600; break;
+        case 115200: speed = B115200; break;
+        default:
+            fprintf(stderr, "[ERROR] TvControl: unsupported baud rate %d.\n", baud);
+            return NULL;
+    }
+
+    int fd = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "[ERROR] TvControl: cannot open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        fprintf(stderr, "[ERROR] TvControl: %s is not a serial port.\n", path);
+        close(fd);
+        return NULL;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        fprintf(stderr, "[ERROR] TvControl: cannot configure %s: %s\n", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return tv_open_fd(&tv_serial_ops, fd, 0);
+}
+
+TvControl *TvControl_open_tcp(const char *host, int port) {
+    char service[16];
+    struct addrinfo hints = {0}, *list, *ai;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(service, sizeof(service), "%d", port);
+    int rc = getaddrinfo(host, service, &hints, &list);
+    if (rc != 0) {
+        fprintf(stderr, "[ERROR] TvControl: cannot resolve %s: %s\n", host, gai_strerror(rc));
+        return NULL;
+    }
+
+    int fd = -1;
+    for (ai = list; ai != NULL && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(list);
+    if (fd < 0) {
+        fprintf(stderr, "[ERROR] TvControl: cannot connect to %s:%d\n", host, port);
+        return NULL;
+    }
+    int one = 1; // Commands are a few bytes each; do not hold them back for Nagle
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return tv_open_fd(&tv_tcp_ops, fd, 0);
+}
+
+// --- Simulator process ---
+
+const char *TvControl_parse_command(const char *line, int gains[3], int present[3]) {
+    static const char names[] = "RGB";
+    if (strncmp(line, "GAIN", 4) != 0) return "unknown command";
+    const char *p = line + 4, *order = names;
+    int channels = 0;
+    for (int c = 0; c < 3; c++) present[c] = 0;
+    while (*p == ' ') {
+        char ch;
+        int value, used;
+        if (sscanf(p, " %c=%d%n", &ch, &value, &used) != 2) return "syntax";
+        const char *at = strchr(order, ch);
+        if (ch == '\0' || at == NULL) return "bad channel";
+        if (value < 0 || value > 192) return "gain out of range";
+        order = at + 1; // Channels in R, G, B order, each at most once
+        gains[at - names] = value;
+        present[at - names] = 1;
+        channels++;
+        p += used;
+    }
+    if (*p != '\0' || channels == 0) return "syntax";
+    return NULL;
+}
+
+static void tv_sim_serve(int fd) {
+    char buf[256];
+    int len = 0;
+    for (;;) {
+        ssize_t n = read(fd, buf + len, sizeof(buf) - 1 - len);
+        if (n <= 0) return;
+        len += (int)n;
+        char *nl;
+        while ((nl = memchr(buf, '\n', len)) != NULL) {
+            *nl = '\0';
+            int gains[3], present[3];
+            const char *reason = TvControl_parse_command(buf, gains, present);
+            char reply[64];
+            int rlen = reason ? snprintf(reply, sizeof(reply), "ERR %s\n", reason) : snprintf(reply, sizeof(reply), "OK\n");
+            if (write(fd, reply, rlen) != rlen) return;
+            len -= (int)(nl + 1 - buf);
+            memmove(buf, nl + 1, len);
+        }
+        if (len == (int)sizeof(buf) - 1) len = 0; // Overlong line: drop it
+    }
+}
+
+TvControl *TvControl_open_sim(int ack_delay_ms) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+        fprintf(stderr, "[ERROR] TvControl: socketpair failed: %s\n", strerror(errno));
+        return NULL;
+    }
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "[ERROR] TvControl: fork failed: %s\n", strerror(errno));
+        close(sv[0]);
+        close(sv[1]);
+        return NULL;
+    }
+    if (pid == 0) {
+        close(sv[0]);
+        tv_sim_serve(sv[1]);
+        _exit(0);
+    }
+    close(sv[1]);
+    // The process replies at once; the delay is applied on this side, on the driver clock, so a
+    // virtual clock (i1d3_set_clock()) skips it like every other wait
+    TvControl *tv = tv_open_fd(&tv_sim_ops, sv[0], pid);
+    if (tv != NULL && ack_delay_ms > 0) tv->reply_delay_us = (int64_t)ack_delay_ms * 1000;
+    return tv;
+}
+
+TvControl *TvControl_open(const char *spec) {
+    if (spec == NULL) return NULL;
+    if (strcmp(spec, "sim") == 0) return TvControl_open_sim(0);
+    if (strncmp(spec, "sim:", 4) == 0) return TvControl_open_sim(atoi(spec + 4));
+    if (strncmp(spec, "serial:", 7) == 0) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s", spec + 7);
+        char *at = strrchr(path, '@');
+        int baud = 115200;
+        if (at != NULL) {
+            *at = '\0';
+            baud = atoi(at + 1);
+        }
+        return TvControl_open_serial(path, baud);
+    }
+    if (strncmp(spec, "tcp:", 4) == 0) {
+        char host[256];
+        snprintf(host, sizeof(host), "%s", spec + 4);
+        char *colon = strrchr(host, ':');
+        if (colon != NULL) {
+            *colon = '\0';
+            return TvControl_open_tcp(host, atoi(colon + 1));
+        }
+    }
+    fprintf(stderr, "[ERROR] TvControl: bad spec '%s' (serial:<path>[@baud], tcp:<host>:<port> or sim[:<ms>])\n", spec);
+    return NULL;
+}
+
+// --- Protocol ---
+
+TvControl *TvControl_open_ops(const TvControlOps *ops, void *ctx, int fd) {
+    TvControl *tv = calloc(1, sizeof(*tv));
+    if (tv == NULL) {
+        if (ops != NULL && ops->close != NULL) ops->close(ctx);
+        return NULL;
+    }
+    tv->ops = ops;
+    tv->ctx = ctx;
+    tv->fd = fd;
+    return tv;
+}
+
+void TvControl_set_gain(TvControl *tv, int r, int g, int b) {
+    if (tv == NULL) return;
+    if (tv->have_pending) tv->stats.coalesced++;
+    tv->pending[0] = r;
+    tv->pending[1] = g;
+    tv->pending[2] = b;
+    tv->have_pending = 1;
+}
+
+// Consumes complete reply lines that are due; returns -1 if one of them is an error
+static int tv_take_replies(TvControl *tv) {
+    int result = 0;
+    int64_t now = i1d3_clock_now_us();
+    char *nl;
+    while (tv->inflight > 0 && tv->due_us[tv->due_head] <= now && (nl = memchr(tv->rx, '\n', tv->rx_len)) != NULL) {
+        *nl = '\0';
+        if (nl > tv->rx && nl[-1] == '\r') nl[-1] = '\0';
+        tv->inflight--;
+        tv->due_head = (tv->due_head + 1) % TV_CONTROL_MAX_INFLIGHT;
+        if (strcmp(tv->rx, "OK") == 0) {
+            tv->stats.acks++;
+        } else {
+            fprintf(stderr, "[ERROR] TvControl (%s): %s\n", tv->ops->name, tv->rx);
+            tv->stats.errors++;
+            memset(tv->sent_valid, 0, sizeof(tv->sent_valid)); // Resend every channel next time
+            result = -1;
+        }
+        tv->rx_len -= (int)(nl + 1 - tv->rx);
+        memmove(tv->rx, nl + 1, tv->rx_len);
+    }
+    if (tv->rx_len == (int)sizeof(tv->rx)) tv->rx_len = 0; // Overlong line: drop it
+    return result;
+}
+
+// Gives up on every command in flight
+static int tv_fail_inflight(TvControl *tv) {
+    tv->stats.errors += tv->inflight;
+    tv->inflight = 0;
+    memset(tv->sent_valid, 0, sizeof(tv->sent_valid));
+    return -1;
+}
+
+// Deadlines are on the driver clock. The fd is still polled in real time, as in the sensor
+// driver: under a virtual clock a reply that does not come in time is waited for by sleeping
+// on the clock.
+int TvControl_wait_acks(TvControl *tv, int timeout_ms) {
+    if (tv == NULL) return 0;
+    int result = tv_take_replies(tv);
+    int64_t deadline = i1d3_clock_now_us() + (int64_t)timeout_ms * 1000;
+    while (tv->inflight > 0) {
+        if (memchr(tv->rx, '\n', tv->rx_len) != NULL) {
+            // The reply is here but not due yet
+            int64_t due = tv->due_us[tv->due_head];
+            if (due > deadline) {
+                if (timeout_ms == 0) return result < 0 ? -1 : 1;
+                i1d3_clock_sleep_until_us(deadline);
+                fprintf(stderr, "[ERROR] TvControl (%s): no reply within %d ms\n", tv->ops->name, timeout_ms);
+                return tv_fail_inflight(tv);
+            }
+            i1d3_clock_sleep_until_us(due);
+            if (tv_take_replies(tv) < 0) result = -1;
+            continue;
+        }
+        int64_t remaining = deadline - i1d3_clock_now_us();
+        if (remaining < 0) remaining = 0;
+        struct pollfd pfd = {tv->fd, POLLIN, 0};
+        int rc = poll(&pfd, 1, (int)((remaining + 999) / 1000));
+        if (rc < 0 && errno == EINTR) continue;
+        if (rc == 0 && remaining > 0) { // A virtual clock only reaches the deadline by sleeping on it
+            i1d3_clock_sleep_until_us(deadline);
+            continue;
+        }
+        if (rc == 0) {
+            if (timeout_ms == 0) return result < 0 ? -1 : 1;
+            fprintf(stderr, "[ERROR] TvControl (%s): no reply within %d ms\n", tv->ops->name, timeout_ms);
+            return tv_fail_inflight(tv);
+        }
+        int n = rc < 0 ? -1 : tv->ops->read(tv->ctx, tv->rx + tv->rx_len, (int)sizeof(tv->rx) - tv->rx_len);
+        if (n <= 0) {
+            fprintf(stderr, "[ERROR] TvControl (%s): connection lost\n", tv->ops->name);
+            return tv_fail_inflight(tv);
+        }
+        tv->rx_len += n;
+        if (tv_take_replies(tv) < 0) result = -1;
+    }
+    return result;
+}
+
+int TvControl_flush(TvControl *tv) {
+    if (tv == NULL) return -1;
+    if (!tv->have_pending) return 0;
+
+    // Replies that already arrived, and room in the pipeline
+    int result = TvControl_wait_acks(tv, 0) < 0 ? -1 : 0;
+    if (tv->inflight >= TV_CONTROL_MAX_INFLIGHT && TvControl_wait_acks(tv, TV_CONTROL_ACK_TIMEOUT_MS) < 0) result = -1;
+
+    char line[64];
+    int len = snprintf(line, sizeof(line), "GAIN");
+    int channels = 0;
+    for (int c = 0; c < 3; c++) {
+        if (tv->sent_valid[c] && tv->sent[c] == tv->pending[c]) {
+            tv->stats.skipped++;
+            continue;
+        }
+        len += snprintf(line + len, sizeof(line) - len, " %c=%d", "RGB"[c], tv->pending[c]);
+        channels++;
+    }
+    tv->have_pending = 0;
+    if (channels == 0) return result;
+    line[len++] = '\n';
+
+    for (int off = 0; off < len;) {
+        int n = tv->ops->write(tv->ctx, line + off, len - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            fprintf(stderr, "[ERROR] TvControl (%s): write failed: %s\n", tv->ops->name, strerror(errno));
+            tv->stats.errors++;
+            memset(tv->sent_valid, 0, sizeof(tv->sent_valid));
+            return -1;
+        }
+        off += n;
+    }
+    for (int c = 0; c < 3; c++) {
+        tv->sent[c] = tv->pending[c];
+        tv->sent_valid[c] = 1;
+    }
+    // The TV answers in order, so a reply is due no earlier than the one before it
+    int64_t sent_at = i1d3_clock_now_us();
+    if (tv->inflight > 0) {
+        int64_t prev = tv->due_us[(tv->due_head + tv->inflight - 1) % TV_CONTROL_MAX_INFLIGHT];
+        if (prev > sent_at) sent_at = prev;
+    }
+    tv->due_us[(tv->due_head + tv->inflight) % TV_CONTROL_MAX_INFLIGHT] = sent_at + tv->reply_delay_us;
+    tv->inflight++;
+    tv->stats.commands++;
+    tv->stats.channels += channels;
+    return result < 0 ? -1 : 1;
+}
+
+const char *TvControl_name(const TvControl *tv) {
+    return tv ? tv->ops->name : "none";
+}
+
+void TvControl_get_stats(const TvControl *tv, TvControlStats *stats) {
+    if (tv == NULL || stats == NULL) return;
+    *stats = tv->stats;
+}
+
+void TvControl_close(TvControl *tv) {
+    if (tv == NULL) return;
+    if (tv->inflight > 0) TvControl_wait_acks(tv, TV_CONTROL_ACK_TIMEOUT_MS);
+    if (tv->ops->close != NULL) tv->ops->close(tv->ctx);
+    free(tv);
+}
@@ -0,0 +1,122 @@
+#ifndef TV_CONTROL_H
+#define TV_CONTROL_H
+
+/*
+ * TV gain control over a line protocol, shared by every backend:
+ *
+ *   host -> TV:  "GAIN R=<0-192> G=<0-192> B=<0-192>\n"  (only the channels that change, in R, G, B order)
+ *   TV -> host:  "OK\n" or "ERR <reason>\n"             (one reply per command, in order)
+ *
+ * Gains are staged by TvControl_set_gain() and sent by TvControl_flush(), so several writes
+ * between two flushes become one command. Commands are pipelined: the reply is collected later
+ * by TvControl_wait_acks(), typically after the sensor measurement that follows the write.
+ */
+
+// Backend: how command lines reach the TV
+typedef struct {
+    const char *name;                                 // Backend name for logs
+    int (*write)(void *ctx, const char *buf, int len); // Write bytes, returns bytes written or -1
+    int (*read)(void *ctx, char *buf, int maxlen);     // Read available bytes, returns count, 0 on EOF or -1
+    int (*close)(void *ctx);                           // Release the backend, returns 0 or -1
+} TvControlOps;
+
+typedef struct TvControl TvControl;
+
+// Counters since TvControl_open_*()
+typedef struct {
+    long commands;   // Commands sent
+    long channels;   // Channel values sent
+    long skipped;    // Channel values not sent because the TV already had them
+    long coalesced;  // TvControl_set_gain() calls merged into a later command
+    long acks;       // OK replies
+    long errors;     // ERR replies, timeouts and I/O errors
+} TvControlStats;
+
+/**
+ * @brief Opens a TV on a serial port (raw, 8N1).
+ * @param path Serial device, e.g. /dev/ttyUSB0.
+ * @param baud Baud rate (9600, 19200, 38400, 57600 or 115200).
+ * @return Handle, or NULL on failure.
+ */
+TvControl *TvControl_open_serial(const char *path, int baud);
+
+/**
+ * @brief Opens a TV that speaks the line protocol on a TCP port.
+ * @param host Host name or address.
+ * @param port TCP port.
+ * @return Handle, or NULL on failure.
+ */
+TvControl *TvControl_open_tcp(const char *host, int port);
+
+/**
+ * @brief Starts a local simulator process that acknowledges commands after a fixed delay.
+ *        Stand-in for a TV when none is connected.
+ * @param ack_delay_ms Delay before each reply, on the driver clock (i1d3_set_clock()).
+ * @return Handle, or NULL on failure.
+ */
+TvControl *TvControl_open_sim(int ack_delay_ms);
+
+/**
+ * @brief Opens a TV from a spec: "serial:<path>[@baud]", "tcp:<host>:<port>" or "sim[:<ack_delay_ms>]".
+ * @param spec Backend spec.
+ * @return Handle, or NULL on failure.
+ */
+TvControl *TvControl_open(const char *spec);
+
+/**
+ * @brief Wraps a custom backend.
+ * @param ops Backend functions (must stay valid while open).
+ * @param ctx Context passed to ops.
+ * @param fd Pollable fd, readable whenever ops->read has data.
+ * @return Handle, or NULL on failure (ops->close is then called).
+ */
+TvControl *TvControl_open_ops(const TvControlOps *ops, void *ctx, int fd);
+
+/**
+ * @brief Stages gains for the next TvControl_flush(). Nothing is sent yet.
+ */
+void TvControl_set_gain(TvControl *tv, int r, int g, int b);
+
+/**
+ * @brief Sends the staged gains as one command holding only the channels that differ from what
+ *        the TV was last sent. Does not wait for the reply; up to 4 commands may be in flight.
+ * @return 1 if a command was sent, 0 if the TV already has the staged gains, -1 on a write
+ *         error or an ERR reply to an earlier command.
+ */
+int TvControl_flush(TvControl *tv);
+
+/**
+ * @brief Collects the replies of all commands in flight.
+ * @param tv Handle.
+ * @param timeout_ms Longest wait for the outstanding replies on the driver clock (i1d3_set_clock()),
+ *        0 to only take what has arrived.
+ * @return 0 when nothing is left in flight, 1 if replies are still pending (timeout_ms = 0),
+ *         -1 on an ERR reply, a timeout or an I/O error.
+ */
+int TvControl_wait_acks(TvControl *tv, int timeout_ms);
+
+/**
+ * @brief Parses one command line (without the newline), for backends that implement the TV side.
+ * @param line Command line.
+ * @param gains Receives the values of the channels present.
+ * @param present Receives 1 for each channel in the command, 0 otherwise.
+ * @return NULL if the command is valid, else the reason to send back with ERR.
+ */
+const char *TvControl_parse_command(const char *line, int gains[3], int present[3]);
+
+/**
+ * @brief Backend name ("serial", "tcp", "sim" or the custom ops name).
+ */
+const char *TvControl_name(const TvControl *tv);
+
+/**
+ * @brief Copies the counters.
+ */
+void TvControl_get_stats(const TvControl *tv, TvControlStats *stats);
+
+/**
+ * @brief Waits for replies still in flight and closes the backend.
+ */
+void TvControl_close(TvControl *tv);
+
+#endif // TV_CONTROL_H
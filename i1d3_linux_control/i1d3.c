@@ -1,4 +1,5 @@
 /* ver:2026_01_13__10_00 - Enhanced with error handling and state management */
+#define _DEFAULT_SOURCE // clock_gettime(), clock_nanosleep(), poll(), pthreads and major()/minor() under -std=c99
 #include "i1d3.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,16 +8,61 @@
 #include <unistd.h>
 #include <errno.h>
 #include <math.h>
+#include <poll.h>
+#include <time.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/sysmacros.h>
+#include <pthread.h>
 
-// Device state tracking (per file descriptor)
-static i1d3_state_t device_states[256] = {I1D3_STATE_DISCONNECTED};
+// Device handle. Owns the fd, protocol state, sensor matrix and statistics.
+struct i1d3_device {
+    int fd;                  // Pollable fd, also the key of the fd API
+    const i1d3_transport_ops *ops;
+    void *ctx;               // Transport context passed to ops
+    int refs;                // Registry reference + in-flight API calls (registry_lock)
+    pthread_mutex_t lock;    // Serializes I/O and all fields below
+    i1d3_state_t state;      // Also read lock-free by i1d3_get_state()
+    double matrix[3][3];     // Raw frequency -> XYZ
+    i1d3_device_stats stats;
+    double integration_time; // Seconds, or I1D3_INTEGRATION_AUTO
+    double auto_precision;   // Relative count resolution targeted by auto-ranging
+    char serial[64];         // USB serial of the hidraw device ("" if unknown)
+    char path[64];           // Device node it was opened from ("" for other transports)
+    uint8_t info[8][64];     // Replies to the init sequence commands
+    // Measurement in flight (I1D3_STATE_MEASURING)
+    int64_t measure_started;  // Monotonic time of i1d3_measure_start()
+    int64_t measure_deadline; // Monotonic time by which the reply must arrive
+    double measure_seconds;   // Integration time of the last command sent
+    bool measure_probe;       // Waiting for the short auto-ranging probe
+    bool reply_ready;         // reply holds the final measure report
+    uint8_t reply[64];
+};
+
+// fd -> device registry, grown on demand so any fd value works
+static i1d3_device **registry = NULL;
+static int registry_size = 0;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Driver-wide per-operation statistics (updated with relaxed atomics)
+static i1d3_op_stats op_stats[I1D3_OP_COUNT];
 
 // Timeout configuration (in microseconds)
-#define I1D3_TIMEOUT_INIT 150000
-#define I1D3_TIMEOUT_UNLOCK 400000
-#define I1D3_TIMEOUT_MEASURE 500000
+#define I1D3_TIMEOUT_INIT 500000      // Reply deadline for each init sequence command
+#define I1D3_TIMEOUT_UNLOCK 400000    // Reply deadline for each challenge/response step
+#define I1D3_TIMEOUT_MEASURE 500000   // Reply deadline after the integration window
+#define I1D3_TIMEOUT_RECV 1000000     // Default reply deadline for i1d3_recv()
 #define I1D3_MAX_RETRIES 3
 
+// Integration configuration
+#define I1D3_CLOCK_FREQ 12000000.0        // Integration clock of the measure command (Hz)
+#define I1D3_INTEGRATION_DEFAULT 0.2      // Seconds, matches the original fixed command
+#define I1D3_AUTO_PROBE_TIME 0.02         // First (short) integration of auto-ranging
+#define I1D3_AUTO_PRECISION_DEFAULT 0.001 // 1 count in 1000 on the strongest channel
+#define I1D3_BATCH_SIGMA_DEFAULT 3.0      // Outlier threshold of i1d3_measure_batch()
+#define I1D3_BATCH_MIN_FOR_REJECT 5       // Accepted readings before outliers are rejected
+
 // Helper functions for calculations
 static uint8_t keySum(uint32_t v) {
     return (v & 0xFF) + ((v >> 8) & 0xFF) + ((v >> 16) & 0xFF) + ((v >> 24) & 0xFF);
@@ -27,7 +73,125 @@ static double toHz(uint32_t cnt, uint32_t clk) {
 }
 
 static double labFunction(double t) {
-    return (t > 0.008856) ? pow(t, 1.0/3.0) : (7.787 * t + 16.0/116.0);
+    return (t > 0.008856) ? cbrt(t) : (7.787 * t + 16.0/116.0);
+}
+
+// --- Driver clock ---
+
+static int64_t i1d3_system_now_us(void *ctx) {
+    (void)ctx;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void i1d3_system_sleep_until_us(void *ctx, int64_t when) {
+    (void)ctx;
+    struct timespec ts = { (time_t)(when / 1000000), (long)(when % 1000000) * 1000 };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        // Absolute deadline: just retry
+    }
+}
+
+const i1d3_clock_ops i1d3_system_clock = { i1d3_system_now_us, i1d3_system_sleep_until_us };
+
+static int64_t i1d3_virtual_now_us(void *ctx) {
+    return __atomic_load_n(&((i1d3_virtual_clock *)ctx)->now_us, __ATOMIC_ACQUIRE);
+}
+
+static void i1d3_virtual_sleep_until_us(void *ctx, int64_t when) {
+    int64_t *now = &((i1d3_virtual_clock *)ctx)->now_us;
+    int64_t current = __atomic_load_n(now, __ATOMIC_ACQUIRE);
+    while (current < when && !__atomic_compare_exchange_n(now, &current, when, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        // current reloaded by the failed exchange
+    }
+}
+
+const i1d3_clock_ops i1d3_virtual_clock_ops = { i1d3_virtual_now_us, i1d3_virtual_sleep_until_us };
+
+// Installed clock (i1d3_set_clock() is called before devices are opened)
+static const i1d3_clock_ops *clock_ops = &i1d3_system_clock;
+static void *clock_ctx = NULL;
+
+void i1d3_set_clock(const i1d3_clock_ops *ops, void *ctx) {
+    clock_ctx = ops ? ctx : NULL;
+    clock_ops = ops ? ops : &i1d3_system_clock;
+}
+
+bool i1d3_clock_is_system(void) {
+    return clock_ops == &i1d3_system_clock;
+}
+
+int64_t i1d3_clock_now_us(void) {
+    return clock_ops->now_us(clock_ctx);
+}
+
+void i1d3_clock_sleep_until_us(int64_t when) {
+    if (i1d3_clock_now_us() < when) clock_ops->sleep_until_us(clock_ctx, when);
+}
+
+// Monotonic time in microseconds on the driver clock
+static int64_t i1d3_now_us(void) {
+    return i1d3_clock_now_us();
+}
+
+// Count one call of op with its result and latency
+static void i1d3_stats_record(i1d3_op_t op, int result, int64_t started_us) {
+    i1d3_op_stats *st = &op_stats[op];
+    int64_t elapsed = i1d3_now_us() - started_us;
+    uint64_t us = (elapsed > 0) ? (uint64_t)elapsed : 0;
+
+    // Bucket k holds [2^k, 2^(k+1)) us; bucket 0 also holds 0 us
+    int bucket = 0;
+    while (bucket < I1D3_STATS_BUCKETS - 1 && (us >> (bucket + 1)) != 0) bucket++;
+
+    __atomic_add_fetch(&st->calls, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&st->total_us, us, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&st->histogram[bucket], 1, __ATOMIC_RELAXED);
+    if (result < 0) {
+        int code = (-result < I1D3_STATS_ERRORS) ? -result : I1D3_STATS_ERRORS - 1;
+        __atomic_add_fetch(&st->errors[code], 1, __ATOMIC_RELAXED);
+    }
+
+    uint64_t max = __atomic_load_n(&st->max_us, __ATOMIC_RELAXED);
+    while (us > max && !__atomic_compare_exchange_n(&st->max_us, &max, us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // max reloaded by the failed exchange
+    }
+}
+
+// Block until the fd has a report to read or the deadline passes on the driver clock
+static i1d3_error_t i1d3_wait_readable(int fd, int64_t deadline_us) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+
+    for (;;) {
+        int64_t remaining = deadline_us - i1d3_now_us();
+        if (remaining < 0) remaining = 0;
+
+        int rc = poll(&pfd, 1, (int)((remaining + 999) / 1000));
+        if (rc > 0) {
+            if (pfd.revents & POLLIN) return I1D3_SUCCESS;
+            return I1D3_ERROR_OPEN_FAILED; // POLLERR/POLLHUP: device went away
+        }
+        if (rc < 0 && errno != EINTR) return I1D3_ERROR_OPEN_FAILED;
+        if (rc == 0 && remaining == 0) return I1D3_ERROR_TIMEOUT;
+        // Nothing arrived in real time; a virtual clock only reaches the deadline by sleeping on it
+        if (rc == 0) i1d3_clock_sleep_until_us(deadline_us);
+    }
+}
+
+// Read one report, waiting no later than the given monotonic deadline (device lock held)
+// Timeouts are not counted here: the operation that gives up reports them.
+static int dev_recv_until(i1d3_device *dev, uint8_t *buf, int maxlen, int64_t deadline_us) {
+    int64_t started = i1d3_now_us();
+    i1d3_error_t ready = i1d3_wait_readable(dev->fd, deadline_us);
+    if (ready == I1D3_ERROR_TIMEOUT) return ready;
+
+    int received = (ready == I1D3_SUCCESS) ? dev->ops->recv(dev->ctx, buf, maxlen) : ready;
+    if (received < 0) {
+        received = I1D3_ERROR_OPEN_FAILED;
+    }
+    i1d3_stats_record(I1D3_OP_RECV, received, started);
+    return received;
 }
 
 // Error string mapping
@@ -47,16 +211,74 @@ const char* i1d3_error_string(i1d3_error_t error) {
     }
 }
 
+// Registry management
+static i1d3_error_t i1d3_register(i1d3_device *dev) {
+    pthread_mutex_lock(&registry_lock);
+    if (dev->fd >= registry_size) {
+        int size = registry_size ? registry_size : 64;
+        while (size <= dev->fd) size *= 2;
+        i1d3_device **grown = realloc(registry, size * sizeof(*grown));
+        if (!grown) {
+            pthread_mutex_unlock(&registry_lock);
+            return I1D3_ERROR_OPEN_FAILED;
+        }
+        memset(grown + registry_size, 0, (size - registry_size) * sizeof(*grown));
+        registry = grown;
+        registry_size = size;
+    }
+    registry[dev->fd] = dev;
+    pthread_mutex_unlock(&registry_lock);
+    return I1D3_SUCCESS;
+}
+
+// Look up the device behind fd and lock it for one API call (NULL if not open)
+static i1d3_device *i1d3_acquire(int fd) {
+    i1d3_device *dev = NULL;
+
+    pthread_mutex_lock(&registry_lock);
+    if (fd >= 0 && fd < registry_size && registry[fd]) {
+        dev = registry[fd];
+        dev->refs++;
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (dev) pthread_mutex_lock(&dev->lock);
+    return dev;
+}
+
+// Unlock a device from i1d3_acquire(); frees it once closed and unreferenced
+static void i1d3_release(i1d3_device *dev) {
+    pthread_mutex_unlock(&dev->lock);
+
+    pthread_mutex_lock(&registry_lock);
+    bool last = (--dev->refs == 0);
+    pthread_mutex_unlock(&registry_lock);
+
+    if (last) {
+        pthread_mutex_destroy(&dev->lock);
+        free(dev);
+    }
+}
+
+// Error code for an fd that is not an open device
+static i1d3_error_t i1d3_bad_fd(int fd) {
+    return (fd < 0) ? I1D3_ERROR_INVALID_PARAMETER : I1D3_ERROR_NOT_INITIALIZED;
+}
+
 // State management
 i1d3_state_t i1d3_get_state(int fd) {
-    if (fd < 0 || fd >= 256) return I1D3_STATE_DISCONNECTED;
-    return device_states[fd];
-}
+    i1d3_state_t state = I1D3_STATE_DISCONNECTED;
 
-static void i1d3_set_state(int fd, i1d3_state_t state) {
-    if (fd >= 0 && fd < 256) {
-        device_states[fd] = state;
+    pthread_mutex_lock(&registry_lock);
+    if (fd >= 0 && fd < registry_size && registry[fd]) {
+        state = __atomic_load_n(&registry[fd]->state, __ATOMIC_ACQUIRE);
     }
+    pthread_mutex_unlock(&registry_lock);
+    return state;
+}
+
+static void i1d3_set_state(i1d3_device *dev, i1d3_state_t state) {
+    __atomic_store_n(&dev->state, state, __ATOMIC_RELEASE);
 }
 
 // 11 Master Keys from Argyll CMS
@@ -81,110 +303,391 @@ static const double MATRIX[3][3] = {
     {-0.000407, 0.000830, 0.078830}
 };
 
-int i1d3_open(const char *path) {
-    if (!path) return I1D3_ERROR_INVALID_PARAMETER;
+void i1d3_get_default_matrix(double matrix[3][3]) {
+    memcpy(matrix, MATRIX, sizeof(MATRIX));
+}
+
+// hidraw transport: ctx is the fd itself
+static int i1d3_hidraw_send(void *ctx, const uint8_t *buf, int len) {
+    return (int)write((int)(intptr_t)ctx, buf, len);
+}
+
+static int i1d3_hidraw_recv(void *ctx, uint8_t *buf, int maxlen) {
+    return (int)read((int)(intptr_t)ctx, buf, maxlen);
+}
+
+static int i1d3_hidraw_close(void *ctx) {
+    return close((int)(intptr_t)ctx);
+}
+
+const i1d3_transport_ops i1d3_hidraw_transport = {
+    "hidraw", i1d3_hidraw_send, i1d3_hidraw_recv, i1d3_hidraw_close
+};
+
+i1d3_device *i1d3_device_open(const char *path, i1d3_error_t *error) {
+    i1d3_error_t result = I1D3_SUCCESS;
+    i1d3_device *dev = NULL;
 
-    // Try to set permissions first
-    char cmd[256];
-    snprintf(cmd, sizeof(cmd), "sudo chmod 666 %s 2>/dev/null", path);
-    system(cmd);
+    if (!path) {
+        result = I1D3_ERROR_INVALID_PARAMETER;
+        goto out;
+    }
 
-    int fd = open(path, O_RDWR);
+    // Access comes from the udev rule (99-i1d3.rules), not from escalating here
+    int fd = open(path, O_RDWR | O_CLOEXEC);
     if (fd < 0) {
         switch (errno) {
-            case ENOENT: return I1D3_ERROR_DEVICE_NOT_FOUND;
-            case EACCES: return I1D3_ERROR_PERMISSION_DENIED;
-            default: return I1D3_ERROR_OPEN_FAILED;
+            case ENOENT: result = I1D3_ERROR_DEVICE_NOT_FOUND; break;
+            case EACCES: result = I1D3_ERROR_PERMISSION_DENIED; break;
+            default: result = I1D3_ERROR_OPEN_FAILED; break;
         }
+        goto out;
+    }
+
+    dev = i1d3_device_open_transport(&i1d3_hidraw_transport, (void *)(intptr_t)fd, fd, NULL, &result);
+    if (!dev) close(fd);
+    else snprintf(dev->path, sizeof(dev->path), "%s", path);
+
+out:
+    if (error) *error = result;
+    return dev;
+}
+
+i1d3_device *i1d3_device_open_transport(const i1d3_transport_ops *ops, void *ctx, int fd, const char *serial, i1d3_error_t *error) {
+    i1d3_error_t result = I1D3_SUCCESS;
+    i1d3_device *dev = NULL;
+
+    if (!ops || !ops->send || !ops->recv || !ops->close || fd < 0) {
+        result = I1D3_ERROR_INVALID_PARAMETER;
+        goto out;
     }
 
     // Initialize device state
-    i1d3_set_state(fd, I1D3_STATE_CONNECTED);
-    return fd;
+    dev = calloc(1, sizeof(*dev));
+    if (!dev) {
+        result = I1D3_ERROR_OPEN_FAILED;
+        goto out;
+    }
+    dev->fd = fd;
+    dev->ops = ops;
+    dev->ctx = ctx;
+    dev->refs = 1;
+    pthread_mutex_init(&dev->lock, NULL);
+    memcpy(dev->matrix, MATRIX, sizeof(dev->matrix));
+    dev->integration_time = I1D3_INTEGRATION_DEFAULT;
+    dev->auto_precision = I1D3_AUTO_PRECISION_DEFAULT;
+    if (serial) snprintf(dev->serial, sizeof(dev->serial), "%s", serial);
+    i1d3_set_state(dev, I1D3_STATE_CONNECTED);
+
+    result = i1d3_register(dev);
+    if (result != I1D3_SUCCESS) {
+        pthread_mutex_destroy(&dev->lock);
+        free(dev);
+        dev = NULL;
+    }
+
+out:
+    if (error) *error = result;
+    return dev;
+}
+
+int i1d3_open(const char *path) {
+    i1d3_error_t result;
+    i1d3_device *dev = i1d3_device_open(path, &result);
+    return dev ? dev->fd : result;
 }
 
 int i1d3_close(int fd) {
     if (fd < 0) return I1D3_ERROR_INVALID_PARAMETER;
 
-    int result = close(fd);
-    if (result == 0) {
-        i1d3_set_state(fd, I1D3_STATE_DISCONNECTED);
+    // Unregister first so no new call can find the device; the registry reference passes to us
+    i1d3_device *dev = NULL;
+    pthread_mutex_lock(&registry_lock);
+    if (fd < registry_size && registry[fd]) {
+        dev = registry[fd];
+        registry[fd] = NULL;
     }
+    pthread_mutex_unlock(&registry_lock);
+    if (!dev) return close(fd);
+
+    pthread_mutex_lock(&dev->lock);
+    int result = dev->ops->close(dev->ctx);
+    i1d3_set_state(dev, I1D3_STATE_DISCONNECTED);
+    i1d3_release(dev);
+    return result;
+}
+
+i1d3_error_t i1d3_device_close(i1d3_device *dev) {
+    if (!dev) return I1D3_ERROR_INVALID_PARAMETER;
+    return (i1d3_close(dev->fd) == 0) ? I1D3_SUCCESS : I1D3_ERROR_OPEN_FAILED;
+}
+
+i1d3_device *i1d3_device_from_fd(int fd) {
+    i1d3_device *dev = NULL;
+
+    pthread_mutex_lock(&registry_lock);
+    if (fd >= 0 && fd < registry_size) dev = registry[fd];
+    pthread_mutex_unlock(&registry_lock);
+    return dev;
+}
+
+int i1d3_device_fd(const i1d3_device *dev) {
+    return dev ? dev->fd : I1D3_ERROR_INVALID_PARAMETER;
+}
+
+const char *i1d3_device_path(const i1d3_device *dev) {
+    return dev ? dev->path : "";
+}
+
+i1d3_error_t i1d3_device_set_matrix(i1d3_device *dev, const double matrix[3][3]) {
+    if (!dev || !matrix) return I1D3_ERROR_INVALID_PARAMETER;
+
+    pthread_mutex_lock(&dev->lock);
+    memcpy(dev->matrix, matrix, sizeof(dev->matrix));
+    pthread_mutex_unlock(&dev->lock);
+    return I1D3_SUCCESS;
+}
+
+i1d3_error_t i1d3_device_get_matrix(i1d3_device *dev, double matrix[3][3]) {
+    if (!dev || !matrix) return I1D3_ERROR_INVALID_PARAMETER;
+
+    pthread_mutex_lock(&dev->lock);
+    memcpy(matrix, dev->matrix, sizeof(dev->matrix));
+    pthread_mutex_unlock(&dev->lock);
+    return I1D3_SUCCESS;
+}
+
+i1d3_error_t i1d3_device_get_stats(i1d3_device *dev, i1d3_device_stats *stats) {
+    if (!dev || !stats) return I1D3_ERROR_INVALID_PARAMETER;
+
+    pthread_mutex_lock(&dev->lock);
+    *stats = dev->stats;
+    pthread_mutex_unlock(&dev->lock);
+    return I1D3_SUCCESS;
+}
+
+// Write one report (device lock held)
+static int dev_send(i1d3_device *dev, uint8_t *buf, int len) {
+    int64_t started = i1d3_now_us();
+    int written = dev->ops->send(dev->ctx, buf, len);
+    int result = (written == len) ? I1D3_SUCCESS : I1D3_ERROR_OPEN_FAILED; // Could be more specific
+    i1d3_stats_record(I1D3_OP_SEND, result, started);
     return result;
 }
 
 int i1d3_send(int fd, uint8_t *buf, int len) {
     if (fd < 0 || !buf || len <= 0) return I1D3_ERROR_INVALID_PARAMETER;
-    if (i1d3_get_state(fd) == I1D3_STATE_DISCONNECTED) return I1D3_ERROR_NOT_INITIALIZED;
+    i1d3_device *dev = i1d3_acquire(fd);
+    if (!dev) return I1D3_ERROR_NOT_INITIALIZED;
 
-    ssize_t written = write(fd, buf, len);
-    if (written != len) {
-        return I1D3_ERROR_OPEN_FAILED; // Could be more specific
-    }
-    return I1D3_SUCCESS;
+    int result = dev_send(dev, buf, len);
+    i1d3_release(dev);
+    return result;
 }
 
 int i1d3_recv(int fd, uint8_t *buf, int maxlen) {
-    if (fd < 0 || !buf || maxlen <= 0) return I1D3_ERROR_INVALID_PARAMETER;
-    if (i1d3_get_state(fd) == I1D3_STATE_DISCONNECTED) return I1D3_ERROR_NOT_INITIALIZED;
+    return i1d3_recv_timeout(fd, buf, maxlen, I1D3_TIMEOUT_RECV / 1000);
+}
 
-    ssize_t received = read(fd, buf, maxlen);
-    if (received < 0) {
-        return I1D3_ERROR_OPEN_FAILED;
+int i1d3_recv_timeout(int fd, uint8_t *buf, int maxlen, int timeout_ms) {
+    if (fd < 0 || !buf || maxlen <= 0 || timeout_ms < 0) return I1D3_ERROR_INVALID_PARAMETER;
+    i1d3_device *dev = i1d3_acquire(fd);
+    if (!dev) return I1D3_ERROR_NOT_INITIALIZED;
+
+    int result = dev_recv_until(dev, buf, maxlen, i1d3_now_us() + (int64_t)timeout_ms * 1000);
+    i1d3_release(dev);
+    return result;
+}
+
+// Init sequence commands. Static replies never change for a given unit and are cached on disk.
+static const struct { uint8_t cmd[2]; bool is_static; } I1D3_INIT_CMDS[8] = {
+    {{0x00, 0x01}, false}, // Status
+    {{0x00, 0x10}, true},  // Product name
+    {{0x00, 0x11}, true},  // Product type
+    {{0x00, 0x12}, true},  // Firmware version
+    {{0x10, 0x00}, true},  // Serial number
+    {{0x00, 0x31}, false}, // Undocumented, always queried
+    {{0x00, 0x13}, true},  // Firmware / calibration date
+    {{0x00, 0x20}, false}  // Lock status
+};
+
+// Read the USB serial (HID_UNIQ) of the hidraw device behind fd from sysfs
+static void i1d3_read_hid_serial(int fd, char *serial, size_t len) {
+    struct stat st;
+    char path[128], line[256];
+
+    serial[0] = '\0';
+    if (fstat(fd, &st) != 0 || !S_ISCHR(st.st_mode)) return;
+
+    snprintf(path, sizeof(path), "/sys/dev/char/%u:%u/device/uevent", major(st.st_rdev), minor(st.st_rdev));
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "HID_UNIQ=", 9) != 0) continue;
+        // Keep only filename-safe characters, the serial becomes the cache key
+        size_t n = 0;
+        for (const char *c = line + 9; *c && *c != '\n' && n + 1 < len; c++) {
+            if (isalnum((unsigned char)*c) || *c == '-' || *c == '_') serial[n++] = *c;
+        }
+        serial[n] = '\0';
+        break;
     }
-    return (int)received;
+    fclose(f);
 }
 
-i1d3_error_t i1d3_init_sequence(int fd) {
-    if (fd < 0) return I1D3_ERROR_INVALID_PARAMETER;
-    if (i1d3_get_state(fd) != I1D3_STATE_CONNECTED) return I1D3_ERROR_NOT_INITIALIZED;
+// Cache directory: $I1D3_CACHE_DIR, else $XDG_CACHE_HOME/i1d3, else $HOME/.cache/i1d3.
+// An empty I1D3_CACHE_DIR disables the cache.
+static bool i1d3_cache_path(const char *serial, const char *suffix, char *path, size_t len, bool create) {
+    const char *dir = getenv("I1D3_CACHE_DIR");
+    char base[200];
+
+    if (!serial || serial[0] == '\0') return false;
+    if (dir) {
+        if (dir[0] == '\0') return false;
+        snprintf(base, sizeof(base), "%s", dir);
+    } else if ((dir = getenv("XDG_CACHE_HOME")) && dir[0]) {
+        snprintf(base, sizeof(base), "%s/i1d3", dir);
+    } else if ((dir = getenv("HOME")) && dir[0]) {
+        if (create) {
+            snprintf(base, sizeof(base), "%s/.cache", dir);
+            mkdir(base, 0755);
+        }
+        snprintf(base, sizeof(base), "%s/.cache/i1d3", dir);
+    } else {
+        return false;
+    }
+
+    if (create && mkdir(base, 0755) != 0 && errno != EEXIST) return false;
+    return snprintf(path, len, "%s/%s.%s", base, serial, suffix) < (int)len;
+}
+
+// Load cached static init replies. Each line is "<index> <128 hex digits>".
+static void i1d3_info_cache_load(const char *serial, uint8_t info[8][64], bool cached[8]) {
+    char path[300], hex[160];
+    unsigned int idx;
+
+    if (!i1d3_cache_path(serial, "info", path, sizeof(path), false)) return;
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+
+    while (fscanf(f, "%u %159s", &idx, hex) == 2) {
+        if (idx >= 8 || !I1D3_INIT_CMDS[idx].is_static || strlen(hex) != 128) continue;
+        bool ok = true;
+        for (int i = 0; i < 64 && ok; i++) {
+            unsigned int byte;
+            ok = sscanf(hex + 2 * i, "%2x", &byte) == 1;
+            info[idx][i] = (uint8_t)byte;
+        }
+        cached[idx] = ok;
+    }
+    fclose(f);
+}
+
+// Store the static init replies, replacing the file atomically
+static void i1d3_info_cache_store(const char *serial, uint8_t info[8][64]) {
+    char path[300], tmp[310];
+
+    if (!i1d3_cache_path(serial, "info", path, sizeof(path), true)) return;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return;
+
+    for (int idx = 0; idx < 8; idx++) {
+        if (!I1D3_INIT_CMDS[idx].is_static) continue;
+        fprintf(f, "%d ", idx);
+        for (int i = 0; i < 64; i++) fprintf(f, "%02x", info[idx][i]);
+        fprintf(f, "\n");
+    }
+    if (fclose(f) == 0) {
+        rename(tmp, path);
+    } else {
+        unlink(tmp);
+    }
+}
+
+const char* i1d3_get_serial(int fd) {
+    // The serial is written once by the init sequence; the device owns the string
+    i1d3_device *dev = i1d3_device_from_fd(fd);
+    return dev ? dev->serial : "";
+}
+
+i1d3_error_t i1d3_get_info_reply(int fd, int index, uint8_t reply[64]) {
+    if (fd < 0 || index < 0 || index >= 8 || !reply) return I1D3_ERROR_INVALID_PARAMETER;
+    i1d3_device *dev = i1d3_acquire(fd);
+    if (!dev) return I1D3_ERROR_NOT_INITIALIZED;
+
+    i1d3_error_t result = I1D3_SUCCESS;
+    if (dev->state == I1D3_STATE_CONNECTED) {
+        result = I1D3_ERROR_NOT_INITIALIZED;
+    } else {
+        memcpy(reply, dev->info[index], 64);
+    }
+    i1d3_release(dev);
+    return result;
+}
+
+static i1d3_error_t dev_init_sequence(i1d3_device *dev) {
+    if (dev->state != I1D3_STATE_CONNECTED) return I1D3_ERROR_NOT_INITIALIZED;
 
-    uint8_t cmds[][2] = {{0x00, 0x01}, {0x00, 0x10}, {0x00, 0x11}, {0x00, 0x12}, {0x10, 0x00}, {0x00, 0x31}, {0x00, 0x13}, {0x00, 0x20}};
     uint8_t buf[64];
+    bool cached[8] = {false};
+    bool fetched_static = false;
+
+    if (dev->serial[0] == '\0') {
+        i1d3_read_hid_serial(dev->fd, dev->serial, sizeof(dev->serial));
+    }
+    i1d3_info_cache_load(dev->serial, dev->info, cached);
 
     for (int i = 0; i < 8; i++) {
+        if (I1D3_INIT_CMDS[i].is_static && cached[i]) continue; // Answer already known
+
         memset(buf, 0, 64);
-        buf[0] = cmds[i][0];
-        buf[1] = cmds[i][1];
+        buf[0] = I1D3_INIT_CMDS[i].cmd[0];
+        buf[1] = I1D3_INIT_CMDS[i].cmd[1];
 
-        if (i1d3_send(fd, buf, 64) != I1D3_SUCCESS) {
+        if (dev_send(dev, buf, 64) != I1D3_SUCCESS) {
             return I1D3_ERROR_OPEN_FAILED;
         }
 
-        usleep(I1D3_TIMEOUT_INIT);
-
-        int received = i1d3_recv(fd, buf, 64);
+        // Each step only waits for its own reply
+        int received = dev_recv_until(dev, buf, 64, i1d3_now_us() + I1D3_TIMEOUT_INIT);
+        if (received == I1D3_ERROR_TIMEOUT) {
+            return I1D3_ERROR_TIMEOUT;
+        }
         if (received < 64) {
             return I1D3_ERROR_INVALID_RESPONSE;
         }
+        memcpy(dev->info[i], buf, 64);
+        if (I1D3_INIT_CMDS[i].is_static) fetched_static = true;
+    }
+
+    if (fetched_static) {
+        i1d3_info_cache_store(dev->serial, dev->info);
     }
 
-    i1d3_set_state(fd, I1D3_STATE_INITIALIZED);
+    i1d3_set_state(dev, I1D3_STATE_INITIALIZED);
     return I1D3_SUCCESS;
 }
 
-i1d3_error_t i1d3_unlock(int fd, const uint32_t key[2]) {
-    if (fd < 0 || !key) return I1D3_ERROR_INVALID_PARAMETER;
-    if (i1d3_get_state(fd) != I1D3_STATE_INITIALIZED) return I1D3_ERROR_NOT_INITIALIZED;
-
-    uint8_t buf[64] = {0};
-    buf[0] = 0x99; buf[1] = 0x00; // Get Challenge
-
-    if (i1d3_send(fd, buf, 64) != I1D3_SUCCESS) {
-        return I1D3_ERROR_OPEN_FAILED;
-    }
+i1d3_error_t i1d3_init_sequence(int fd) {
+    i1d3_device *dev = i1d3_acquire(fd);
+    if (!dev) return i1d3_bad_fd(fd);
 
-    int received = i1d3_recv(fd, buf, 64);
-    if (received < 64 || buf[1] != 0x99) {
-        return I1D3_ERROR_INVALID_RESPONSE;
-    }
+    int64_t started = i1d3_now_us();
+    i1d3_error_t result = dev_init_sequence(dev);
+    i1d3_stats_record(I1D3_OP_INIT, result, started);
+    i1d3_release(dev);
+    return result;
+}
 
-    uint8_t c2 = buf[2], c3 = buf[3];
+void i1d3_unlock_response(const uint32_t key[2], const uint8_t challenge[64], uint8_t response[64]) {
+    uint8_t c2 = challenge[2], c3 = challenge[3];
     uint8_t sc[8];
-    for (int i = 0; i < 8; i++) sc[i] = c3 ^ buf[35 + i];
+    for (int i = 0; i < 8; i++) sc[i] = c3 ^ challenge[35 + i];
 
-    uint32_t ci0 = (sc[3] << 24) | (sc[0] << 16) | (sc[4] << 8) | sc[6];
-    uint32_t ci1 = (sc[1] << 24) | (sc[7] << 16) | (sc[2] << 8) | sc[5];
+    uint32_t ci0 = ((uint32_t)sc[3] << 24) | (sc[0] << 16) | (sc[4] << 8) | sc[6];
+    uint32_t ci1 = ((uint32_t)sc[1] << 24) | (sc[7] << 16) | (sc[2] << 8) | sc[5];
     uint32_t nK0 = ~key[0] + 1, nK1 = ~key[1] + 1; // 2's Complement
 
     uint32_t co[4] = {nK0 - ci1, nK1 - ci0, ci1 * nK0, ci0 * nK1};
@@ -199,78 +702,547 @@ i1d3_error_t i1d3_unlock(int fd, const uint32_t key[2]) {
     sr[8] = ((co[3] >> 8) & 0xFF) + s0;  sr[9] = ((co[2] >> 24) & 0xFF) - s1; sr[10] = ((co[0] >> 8) & 0xFF) + s0; sr[11] = ((co[1] >> 8) & 0xFF) - s1;
     sr[12] = (co[1] & 0xFF) + s1;        sr[13] = ((co[3] >> 24) & 0xFF) + s1; sr[14] = (co[2] & 0xFF) + s0;      sr[15] = ((co[0] >> 24) & 0xFF) - s0;
 
-    memset(buf, 0, 64);
-    buf[0] = 0x9A; // Send Response
-    for (int i = 0; i < 16; i++) buf[24 + i] = c2 ^ sr[i];
+    memset(response, 0, 64);
+    response[0] = 0x9A; // Send Response
+    for (int i = 0; i < 16; i++) response[24 + i] = c2 ^ sr[i];
+}
+
+// One challenge/response exchange with the given key
+static i1d3_error_t dev_unlock_exchange(i1d3_device *dev, const uint32_t key[2]) {
+    if (dev->state != I1D3_STATE_INITIALIZED) return I1D3_ERROR_NOT_INITIALIZED;
+
+    uint8_t buf[64] = {0};
+    buf[0] = 0x99; buf[1] = 0x00; // Get Challenge
 
-    if (i1d3_send(fd, buf, 64) != I1D3_SUCCESS) {
+    if (dev_send(dev, buf, 64) != I1D3_SUCCESS) {
         return I1D3_ERROR_OPEN_FAILED;
     }
 
-    received = i1d3_recv(fd, buf, 64);
+    int received = dev_recv_until(dev, buf, 64, i1d3_now_us() + I1D3_TIMEOUT_UNLOCK);
+    if (received == I1D3_ERROR_TIMEOUT) {
+        return I1D3_ERROR_TIMEOUT;
+    }
+    if (received < 64 || buf[1] != 0x99) {
+        return I1D3_ERROR_INVALID_RESPONSE;
+    }
+
+    i1d3_unlock_response(key, buf, buf);
+
+    if (dev_send(dev, buf, 64) != I1D3_SUCCESS) {
+        return I1D3_ERROR_OPEN_FAILED;
+    }
+
+    received = dev_recv_until(dev, buf, 64, i1d3_now_us() + I1D3_TIMEOUT_UNLOCK);
+    if (received == I1D3_ERROR_TIMEOUT) {
+        return I1D3_ERROR_TIMEOUT;
+    }
     if (received < 64) {
         return I1D3_ERROR_INVALID_RESPONSE;
     }
 
     if (buf[2] == 0x77) { // Code 77 = Success
-        i1d3_set_state(fd, I1D3_STATE_UNLOCKED);
+        i1d3_set_state(dev, I1D3_STATE_UNLOCKED);
         return I1D3_SUCCESS;
     }
 
     return I1D3_ERROR_UNLOCK_FAILED;
 }
 
-i1d3_error_t i1d3_auto_find_unlock(int fd) {
-    if (fd < 0) return I1D3_ERROR_INVALID_PARAMETER;
-    if (i1d3_get_state(fd) != I1D3_STATE_INITIALIZED) return I1D3_ERROR_NOT_INITIALIZED;
+static i1d3_error_t dev_unlock(i1d3_device *dev, const uint32_t key[2]) {
+    int64_t started = i1d3_now_us();
+    i1d3_error_t result = dev_unlock_exchange(dev, key);
+    i1d3_stats_record(I1D3_OP_UNLOCK, result, started);
+    return result;
+}
 
+i1d3_error_t i1d3_unlock(int fd, const uint32_t key[2]) {
+    if (!key) return I1D3_ERROR_INVALID_PARAMETER;
+    i1d3_device *dev = i1d3_acquire(fd);
+    if (!dev) return i1d3_bad_fd(fd);
+
+    i1d3_error_t result = dev_unlock(dev, key);
+    i1d3_release(dev);
+    return result;
+}
+
+// Index into I1D3_CODES of the key that last unlocked this unit, -1 if unknown
+static int i1d3_unlock_cache_load(const char *serial) {
+    char path[300], name[32];
+    int index = -1;
+
+    if (!i1d3_cache_path(serial, "unlock", path, sizeof(path), false)) return -1;
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    if (fscanf(f, "%31s", name) == 1) {
+        for (int i = 0; i < 11; i++) {
+            if (strcmp(name, I1D3_CODES[i].name) == 0) index = i;
+        }
+    }
+    fclose(f);
+    return index;
+}
+
+// Remember the key name (not the key itself) that unlocked this unit
+static void i1d3_unlock_cache_store(const char *serial, const char *name) {
+    char path[300], tmp[310];
+
+    if (!i1d3_cache_path(serial, "unlock", path, sizeof(path), true)) return;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return;
+
+    fprintf(f, "%s\n", name);
+    if (fclose(f) == 0) {
+        rename(tmp, path);
+    } else {
+        unlink(tmp);
+    }
+}
+
+static i1d3_error_t dev_auto_find_unlock(i1d3_device *dev) {
+    if (dev->state != I1D3_STATE_INITIALIZED) return I1D3_ERROR_NOT_INITIALIZED;
+
+    // Try the key that last unlocked this unit first, then the rest in table order.
+    // No delay between attempts: each one is paced by its own challenge/response round trips.
+    int order[11], n = 0;
+    int cached = i1d3_unlock_cache_load(dev->serial);
+    if (cached >= 0) order[n++] = cached;
     for (int i = 0; i < 11; i++) {
-        printf("[INFO] Attempt %d/11: Testing %s...\n", i + 1, I1D3_CODES[i].name);
-        i1d3_error_t result = i1d3_unlock(fd, I1D3_CODES[i].key);
+        if (i != cached) order[n++] = i;
+    }
+
+    for (int i = 0; i < 11; i++) {
+        const i1d3_key_entry *entry = &I1D3_CODES[order[i]];
+        printf("[INFO] Attempt %d/11: Testing %s%s...\n", i + 1, entry->name, order[i] == cached ? " (cached)" : "");
+        i1d3_error_t result = dev_unlock(dev, entry->key);
         if (result == I1D3_SUCCESS) {
-            printf("[SUCCESS] Instrument unlocked using %s keys.\n", I1D3_CODES[i].name);
+            printf("[SUCCESS] Instrument unlocked using %s keys.\n", entry->name);
+            if (order[i] != cached) i1d3_unlock_cache_store(dev->serial, entry->name);
             return I1D3_SUCCESS;
         }
-        usleep(I1D3_TIMEOUT_UNLOCK);
+        if (result == I1D3_ERROR_TIMEOUT || result == I1D3_ERROR_OPEN_FAILED) {
+            printf("[ERROR] Unlock aborted: %s\n", i1d3_error_string(result));
+            return result;
+        }
     }
     printf("[ERROR] All unlock keys failed.\n");
     return I1D3_ERROR_UNLOCK_FAILED;
 }
 
-i1d3_error_t i1d3_aio_measure(int fd, i1d3_color_results *res) {
-    if (fd < 0 || !res) return I1D3_ERROR_INVALID_PARAMETER;
-    if (i1d3_get_state(fd) != I1D3_STATE_UNLOCKED) return I1D3_ERROR_NOT_INITIALIZED;
+i1d3_error_t i1d3_auto_find_unlock(int fd) {
+    i1d3_device *dev = i1d3_acquire(fd);
+    if (!dev) return i1d3_bad_fd(fd);
+
+    i1d3_error_t result = dev_auto_find_unlock(dev);
+    i1d3_release(dev);
+    return result;
+}
 
-    uint8_t buf[64] = {0x04, 0x00, 0x9F, 0x24, 0x00, 0x00, 0x07, 0xE8, 0x03}; // 0.2s measure
+// Build a measure command for the given integration time
+static void i1d3_build_measure_cmd(uint8_t *buf, double seconds) {
+    uint32_t clks = (uint32_t)(seconds * I1D3_CLOCK_FREQ + 0.5);
 
-    if (i1d3_send(fd, buf, 64) != I1D3_SUCCESS) {
+    memset(buf, 0, 64);
+    buf[0] = 0x04;
+    buf[1] = clks & 0xFF; buf[2] = (clks >> 8) & 0xFF; buf[3] = (clks >> 16) & 0xFF; buf[4] = (clks >> 24) & 0xFF;
+    buf[6] = 0x07; buf[7] = 0xE8; buf[8] = 0x03;
+}
+
+// Send one measure command and arm the reply deadline
+static i1d3_error_t i1d3_measure_send(i1d3_device *dev, double seconds) {
+    uint8_t buf[64];
+    i1d3_build_measure_cmd(buf, seconds);
+
+    // The reply is sent when the integration window closes
+    dev->measure_seconds = seconds;
+    dev->measure_deadline = i1d3_now_us() + (int64_t)(seconds * 1000000.0) + I1D3_TIMEOUT_MEASURE;
+    if (dev_send(dev, buf, 64) != I1D3_SUCCESS) {
         return I1D3_ERROR_OPEN_FAILED;
     }
+    return I1D3_SUCCESS;
+}
 
-    usleep(I1D3_TIMEOUT_MEASURE);
-
-    int received = i1d3_recv(fd, buf, 64);
-    if (received < 64 || buf[1] != 0x04) {
-        return I1D3_ERROR_INVALID_RESPONSE;
+// Largest edge count of the three channels in a measure reply
+static uint32_t i1d3_peak_count(const uint8_t *buf) {
+    uint32_t peak = 0;
+    for (int i = 0; i < 3; i++) {
+        uint32_t cnt = *(const uint32_t*)&buf[2 + 4 * i];
+        if (cnt > peak) peak = cnt;
     }
+    return peak;
+}
 
-    uint32_t rCnt = *(uint32_t*)&buf[2], gCnt = *(uint32_t*)&buf[6], bCnt = *(uint32_t*)&buf[10];
-    uint32_t rClk = *(uint32_t*)&buf[14], gClk = *(uint32_t*)&buf[18], bClk = *(uint32_t*)&buf[22];
+void i1d3_counts_to_xyz(const uint8_t report[64], const double matrix[3][3], double xyz[3]) {
+    const uint8_t *buf = report;
+    uint32_t rCnt = *(const uint32_t*)&buf[2], gCnt = *(const uint32_t*)&buf[6], bCnt = *(const uint32_t*)&buf[10];
+    uint32_t rClk = *(const uint32_t*)&buf[14], gClk = *(const uint32_t*)&buf[18], bClk = *(const uint32_t*)&buf[22];
 
     double R = toHz(rCnt, rClk), G = toHz(gCnt, gClk), B = toHz(bCnt, bClk);
 
-    res->X = MATRIX[0][0]*R + MATRIX[0][1]*G + MATRIX[0][2]*B;
-    res->Y = MATRIX[1][0]*R + MATRIX[1][1]*G + MATRIX[1][2]*B;
-    res->Z = MATRIX[2][0]*R + MATRIX[2][1]*G + MATRIX[2][2]*B;
+    xyz[0] = matrix[0][0]*R + matrix[0][1]*G + matrix[0][2]*B;
+    xyz[1] = matrix[1][0]*R + matrix[1][1]*G + matrix[1][2]*B;
+    xyz[2] = matrix[2][0]*R + matrix[2][1]*G + matrix[2][2]*B;
+}
+
+// Convert a measure reply into XYZ, xy, CCT/Duv and Lab
+static void i1d3_decode_measurement(const uint8_t *buf, const double matrix[3][3], i1d3_color_results *res) {
+    double xyz[3];
+    i1d3_counts_to_xyz(buf, matrix, xyz);
+    i1d3_xyz_to_color(xyz[0], xyz[1], xyz[2], res);
+}
+
+void i1d3_xyz_to_color(double X, double Y, double Z, i1d3_color_results *res) {
+    res->X = X; res->Y = Y; res->Z = Z;
 
     double sum = res->X + res->Y + res->Z;
     res->x = (sum > 0) ? res->X / sum : 0;
     res->y = (sum > 0) ? res->Y / sum : 0;
 
-    double n = (res->x - 0.3320) / (0.1858 - res->y); // McCamy's
-    res->CCT = 449.0*pow(n, 3) + 3525.0*pow(n, 2) + 6823.3*n + 5524.33;
+    i1d3_xy_to_cct(res->x, res->y, &res->CCT, &res->Duv); // Both 0 when sum is 0 or off the table
 
     double fX = labFunction(res->X / 96.42), fY = labFunction(res->Y / 100.0), fZ = labFunction(res->Z / 82.49); // D50
     res->L = 116.0 * fY - 16.0; res->a = 500.0 * (fX - fY); res->b = 200.0 * (fY - fZ);
+}
+
+i1d3_error_t i1d3_set_integration_time(int fd, double seconds) {
+    if (fd < 0) return I1D3_ERROR_INVALID_PARAMETER;
+    if (seconds != I1D3_INTEGRATION_AUTO && (seconds < I1D3_INTEGRATION_MIN || seconds > I1D3_INTEGRATION_MAX)) {
+        return I1D3_ERROR_INVALID_PARAMETER;
+    }
+    i1d3_device *dev = i1d3_acquire(fd);
+    if (!dev) return I1D3_ERROR_NOT_INITIALIZED;
+
+    dev->integration_time = seconds;
+    i1d3_release(dev);
+    return I1D3_SUCCESS;
+}
+
+double i1d3_get_integration_time(int fd) {
+    double seconds = I1D3_INTEGRATION_DEFAULT;
+    i1d3_device *dev = i1d3_acquire(fd);
+    if (dev) {
+        seconds = dev->integration_time;
+        i1d3_release(dev);
+    }
+    return seconds;
+}
+
+i1d3_error_t i1d3_set_auto_range_precision(int fd, double precision) {
+    if (fd < 0 || !(precision > 0.0 && precision < 1.0)) return I1D3_ERROR_INVALID_PARAMETER;
+    i1d3_device *dev = i1d3_acquire(fd);
+    if (!dev) return I1D3_ERROR_NOT_INITIALIZED;
+
+    dev->auto_precision = precision;
+    i1d3_release(dev);
+    return I1D3_SUCCESS;
+}
+
+// Start a measurement and move the device to I1D3_STATE_MEASURING
+static i1d3_error_t dev_measure_begin(i1d3_device *dev, double seconds) {
+    if (dev->state != I1D3_STATE_UNLOCKED) {
+        i1d3_stats_record(I1D3_OP_MEASURE, I1D3_ERROR_NOT_INITIALIZED, i1d3_now_us());
+        return I1D3_ERROR_NOT_INITIALIZED;
+    }
+
+    dev->measure_started = i1d3_now_us();
+    dev->measure_probe = (seconds == I1D3_INTEGRATION_AUTO);
+    dev->reply_ready = false;
+
+    i1d3_error_t result = i1d3_measure_send(dev, dev->measure_probe ? I1D3_AUTO_PROBE_TIME : seconds);
+    if (result != I1D3_SUCCESS) {
+        dev->stats.errors++;
+        i1d3_stats_record(I1D3_OP_MEASURE, result, dev->measure_started);
+        return result;
+    }
+
+    i1d3_set_state(dev, I1D3_STATE_MEASURING);
     return I1D3_SUCCESS;
 }
+
+// Advance the measurement in flight. Blocking waits for a report up to the measurement
+// deadline; otherwise only a report that already arrived is taken.
+// Returns 1 when the final report is in, 0 while integrating, negative error otherwise.
+static int dev_measure_advance(i1d3_device *dev, bool block) {
+    uint8_t buf[64];
+
+    if (dev->reply_ready) return 1;
+
+    int64_t now = i1d3_now_us();
+    int64_t deadline = (block || now > dev->measure_deadline) ? dev->measure_deadline : now;
+    int received = dev_recv_until(dev, buf, 64, deadline);
+    if (received == I1D3_ERROR_TIMEOUT && !block && now < dev->measure_deadline) {
+        return 0; // Still integrating
+    }
+
+    i1d3_error_t result = I1D3_SUCCESS;
+    if (received == I1D3_ERROR_TIMEOUT) {
+        result = I1D3_ERROR_TIMEOUT;
+    } else if (received < 64 || buf[1] != 0x04) {
+        result = I1D3_ERROR_INVALID_RESPONSE;
+    } else if (dev->measure_probe) {
+        // Auto-ranging: a short probe is enough for bright patches. Otherwise scale the
+        // integration so the strongest channel reaches the requested count resolution.
+        double needed = 1.0 / dev->auto_precision;
+        uint32_t peak = i1d3_peak_count(buf);
+        dev->measure_probe = false;
+        if (peak < needed) {
+            double scaled = I1D3_AUTO_PROBE_TIME * 1.1 * needed / (peak > 1 ? peak - 1 : 1);
+            if (scaled > I1D3_INTEGRATION_MAX) scaled = I1D3_INTEGRATION_MAX;
+            result = i1d3_measure_send(dev, scaled);
+            if (result == I1D3_SUCCESS) return 0;
+        }
+    }
+
+    if (result != I1D3_SUCCESS) {
+        dev->stats.errors++;
+        i1d3_stats_record(I1D3_OP_MEASURE, result, dev->measure_started);
+        i1d3_set_state(dev, I1D3_STATE_UNLOCKED);
+        return result;
+    }
+    memcpy(dev->reply, buf, 64);
+    dev->reply_ready = true;
+    return 1;
+}
+
+static i1d3_error_t dev_measure_collect(i1d3_device *dev, i1d3_color_results *res) {
+    if (dev->state != I1D3_STATE_MEASURING) return I1D3_ERROR_NOT_INITIALIZED;
+
+    int ready;
+    while ((ready = dev_measure_advance(dev, true)) == 0) {
+        // Auto-ranging re-armed a longer integration; keep waiting
+    }
+    if (ready < 0) return ready;
+
+    i1d3_decode_measurement(dev->reply, (const double (*)[3])dev->matrix, res);
+    i1d3_set_state(dev, I1D3_STATE_UNLOCKED);
+
+    dev->stats.measurements++;
+    dev->stats.last_measure_ms = (i1d3_now_us() - dev->measure_started) / 1000.0;
+    dev->stats.total_measure_ms += dev->stats.last_measure_ms;
+    i1d3_stats_record(I1D3_OP_MEASURE, I1D3_SUCCESS, dev->measure_started);
+    return I1D3_SUCCESS;
+}
+
+i1d3_error_t i1d3_measure_start(int fd) {
+    i1d3_device *dev = i1d3_acquire(fd);
+    if (!dev) return i1d3_bad_fd(fd);
+
+    i1d3_error_t result = dev_measure_begin(dev, dev->integration_time);
+    i1d3_release(dev);
+    return result;
+}
+
+int i1d3_measure_poll(int fd) {
+    i1d3_device *dev = i1d3_acquire(fd);
+    if (!dev) return i1d3_bad_fd(fd);
+
+    int result = I1D3_ERROR_NOT_INITIALIZED;
+    if (dev->state == I1D3_STATE_MEASURING) {
+        result = dev_measure_advance(dev, false);
+    }
+    i1d3_release(dev);
+    return result;
+}
+
+i1d3_error_t i1d3_measure_collect(int fd, i1d3_color_results *res) {
+    if (!res) return I1D3_ERROR_INVALID_PARAMETER;
+    i1d3_device *dev = i1d3_acquire(fd);
+    if (!dev) return i1d3_bad_fd(fd);
+
+    i1d3_error_t result = dev_measure_collect(dev, res);
+    i1d3_release(dev);
+    return result;
+}
+
+i1d3_error_t i1d3_aio_measure(int fd, i1d3_color_results *res) {
+    return i1d3_aio_measure_ex(fd, i1d3_get_integration_time(fd), res);
+}
+
+i1d3_error_t i1d3_aio_measure_ex(int fd, double seconds, i1d3_color_results *res) {
+    if (fd < 0 || !res) return I1D3_ERROR_INVALID_PARAMETER;
+    if (seconds != I1D3_INTEGRATION_AUTO && (seconds < I1D3_INTEGRATION_MIN || seconds > I1D3_INTEGRATION_MAX)) {
+        return I1D3_ERROR_INVALID_PARAMETER;
+    }
+    i1d3_device *dev = i1d3_acquire(fd);
+    if (!dev) return i1d3_bad_fd(fd);
+
+    i1d3_error_t result = dev_measure_begin(dev, seconds);
+    if (result == I1D3_SUCCESS) {
+        result = dev_measure_collect(dev, res);
+    }
+    i1d3_release(dev);
+    return result;
+}
+
+// Single-pass accumulation for i1d3_measure_batch() (Welford)
+typedef struct {
+    int count;
+    double mean[3], m2[3], min[3], max[3];
+} i1d3_batch_acc;
+
+static void i1d3_batch_add(i1d3_batch_acc *acc, const double v[3]) {
+    acc->count++;
+    for (int c = 0; c < 3; c++) {
+        double delta = v[c] - acc->mean[c];
+        acc->mean[c] += delta / acc->count;
+        acc->m2[c] += delta * (v[c] - acc->mean[c]);
+        if (acc->count == 1 || v[c] < acc->min[c]) acc->min[c] = v[c];
+        if (acc->count == 1 || v[c] > acc->max[c]) acc->max[c] = v[c];
+    }
+}
+
+// Outlier test against the readings accepted so far
+static bool i1d3_batch_outlier(const i1d3_batch_acc *acc, const double v[3], double sigma) {
+    if (sigma <= 0 || acc->count < I1D3_BATCH_MIN_FOR_REJECT) return false;
+    for (int c = 0; c < 3; c++) {
+        double sd = sqrt(acc->m2[c] / (acc->count - 1));
+        if (sd > 0 && fabs(v[c] - acc->mean[c]) > sigma * sd) return true;
+    }
+    return false;
+}
+
+i1d3_error_t i1d3_measure_batch(i1d3_device *dev, int n, const i1d3_batch_opts *opts, i1d3_batch_stats *out) {
+    if (!dev || n <= 0 || !out) return I1D3_ERROR_INVALID_PARAMETER;
+
+    i1d3_batch_opts o;
+    if (opts) {
+        o = *opts;
+        if (o.integration_time != I1D3_INTEGRATION_AUTO
+            && (o.integration_time < I1D3_INTEGRATION_MIN || o.integration_time > I1D3_INTEGRATION_MAX)) {
+            return I1D3_ERROR_INVALID_PARAMETER;
+        }
+    }
+    memset(out, 0, sizeof(*out));
+
+    // Hold the device for the whole batch so readings run back to back
+    pthread_mutex_lock(&dev->lock);
+
+    if (!opts) {
+        o.integration_time = dev->integration_time;
+        o.reject_sigma = I1D3_BATCH_SIGMA_DEFAULT;
+        o.max_failures = 0;
+    }
+
+    i1d3_batch_acc acc;
+    memset(&acc, 0, sizeof(acc));
+    double seconds = o.integration_time;
+    i1d3_error_t last_error = I1D3_SUCCESS;
+    int64_t started = i1d3_now_us();
+
+    for (int i = 0; i < n; i++) {
+        i1d3_color_results r;
+        i1d3_error_t result = dev_measure_begin(dev, seconds);
+        if (result == I1D3_SUCCESS) {
+            result = dev_measure_collect(dev, &r);
+        }
+        if (result != I1D3_SUCCESS) {
+            last_error = result;
+            if (++out->failed > o.max_failures || dev->state != I1D3_STATE_UNLOCKED) break;
+            continue;
+        }
+
+        // Auto-ranging only needs to probe once per batch
+        if (seconds == I1D3_INTEGRATION_AUTO) seconds = dev->measure_seconds;
+
+        double v[3] = {r.X, r.Y, r.Z};
+        if (i1d3_batch_outlier(&acc, v, o.reject_sigma)) {
+            out->rejected++;
+            continue;
+        }
+        i1d3_batch_add(&acc, v);
+    }
+
+    out->count = acc.count;
+    out->integration_time = seconds;
+    out->elapsed_ms = (i1d3_now_us() - started) / 1000.0;
+    pthread_mutex_unlock(&dev->lock);
+
+    if (acc.count == 0 || out->failed > o.max_failures) {
+        return (last_error != I1D3_SUCCESS) ? last_error : I1D3_ERROR_MEASUREMENT_FAILED;
+    }
+    i1d3_xyz_to_color(acc.mean[0], acc.mean[1], acc.mean[2], &out->mean);
+    for (int c = 0; c < 3; c++) {
+        out->std[c] = (acc.count > 1) ? sqrt(acc.m2[c] / (acc.count - 1)) : 0.0;
+        out->min[c] = acc.min[c];
+        out->max[c] = acc.max[c];
+    }
+    return I1D3_SUCCESS;
+}
+
+// --- Statistics readout ---
+
+static const char *const I1D3_OP_NAMES[I1D3_OP_COUNT] = {"send", "recv", "init", "unlock", "measure"};
+
+const char *i1d3_op_name(i1d3_op_t op) {
+    return (op >= 0 && op < I1D3_OP_COUNT) ? I1D3_OP_NAMES[op] : "unknown";
+}
+
+void i1d3_get_stats(i1d3_stats *stats) {
+    if (!stats) return;
+    for (int op = 0; op < I1D3_OP_COUNT; op++) {
+        const i1d3_op_stats *src = &op_stats[op];
+        i1d3_op_stats *dst = &stats->op[op];
+        dst->calls = __atomic_load_n(&src->calls, __ATOMIC_RELAXED);
+        dst->total_us = __atomic_load_n(&src->total_us, __ATOMIC_RELAXED);
+        dst->max_us = __atomic_load_n(&src->max_us, __ATOMIC_RELAXED);
+        for (int i = 0; i < I1D3_STATS_ERRORS; i++) {
+            dst->errors[i] = __atomic_load_n(&src->errors[i], __ATOMIC_RELAXED);
+        }
+        for (int i = 0; i < I1D3_STATS_BUCKETS; i++) {
+            dst->histogram[i] = __atomic_load_n(&src->histogram[i], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void i1d3_reset_stats(void) {
+    for (int op = 0; op < I1D3_OP_COUNT; op++) {
+        i1d3_op_stats *st = &op_stats[op];
+        __atomic_store_n(&st->calls, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&st->total_us, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&st->max_us, 0, __ATOMIC_RELAXED);
+        for (int i = 0; i < I1D3_STATS_ERRORS; i++) __atomic_store_n(&st->errors[i], 0, __ATOMIC_RELAXED);
+        for (int i = 0; i < I1D3_STATS_BUCKETS; i++) __atomic_store_n(&st->histogram[i], 0, __ATOMIC_RELAXED);
+    }
+}
+
+double i1d3_stats_percentile(const i1d3_op_stats *stats, double fraction) {
+    if (!stats || stats->calls == 0) return 0.0;
+
+    uint64_t total = 0;
+    for (int i = 0; i < I1D3_STATS_BUCKETS; i++) total += stats->histogram[i];
+    double target = fraction * total;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < I1D3_STATS_BUCKETS; i++) {
+        seen += stats->histogram[i];
+        if (seen > 0 && seen >= target) {
+            uint64_t upper = (uint64_t)1 << (i + 1); // Bucket upper bound, but never above the maximum seen
+            return (double)(upper < stats->max_us ? upper : stats->max_us);
+        }
+    }
+    return (double)stats->max_us;
+}
+
+void i1d3_print_stats(void) {
+    i1d3_stats stats;
+    i1d3_get_stats(&stats);
+
+    printf("[STATS] %-8s %8s %7s %10s %10s %10s %10s\n", "op", "calls", "errors", "mean ms", "p50 ms", "p99 ms", "max ms");
+    for (int op = 0; op < I1D3_OP_COUNT; op++) {
+        const i1d3_op_stats *st = &stats.op[op];
+        if (st->calls == 0) continue;
+
+        uint64_t errors = 0;
+        for (int i = 1; i < I1D3_STATS_ERRORS; i++) errors += st->errors[i];
+        printf("[STATS] %-8s %8llu %7llu %10.3f %10.3f %10.3f %10.3f\n", i1d3_op_name((i1d3_op_t)op),
+               (unsigned long long)st->calls, (unsigned long long)errors,
+               st->total_us / 1000.0 / st->calls, i1d3_stats_percentile(st, 0.5) / 1000.0,
+               i1d3_stats_percentile(st, 0.99) / 1000.0, st->max_us / 1000.0);
+        for (int i = 1; i < I1D3_STATS_ERRORS; i++) {
+            if (st->errors[i]) {
+                printf("[STATS]          %llu x %s\n", (unsigned long long)st->errors[i], i1d3_error_string((i1d3_error_t)-i));
+            }
+        }
+    }
+}
@@ -28,31 +28,191 @@ typedef enum {
     I1D3_STATE_DISCONNECTED = 0,  /**< Device is not connected */
     I1D3_STATE_CONNECTED = 1,     /**< Device is connected but not initialized */
     I1D3_STATE_INITIALIZED = 2,   /**< Device is initialized but not unlocked */
-    I1D3_STATE_UNLOCKED = 3       /**< Device is fully ready for measurements */
+    I1D3_STATE_UNLOCKED = 3,      /**< Device is fully ready for measurements */
+    I1D3_STATE_MEASURING = 4      /**< A split-phase measurement is in flight */
 } i1d3_state_t;
 
+/**
+ * @brief Init sequence commands, in the order they are sent (see i1d3_get_info_reply())
+ */
+typedef enum {
+    I1D3_INFO_STATUS = 0,           /**< Device status */
+    I1D3_INFO_PRODUCT_NAME = 1,     /**< Product name (cached) */
+    I1D3_INFO_PRODUCT_TYPE = 2,     /**< Product type (cached) */
+    I1D3_INFO_FIRMWARE_VERSION = 3, /**< Firmware version (cached) */
+    I1D3_INFO_SERIAL = 4,           /**< Serial number (cached) */
+    I1D3_INFO_UNKNOWN_31 = 5,       /**< Undocumented command 0x0031 */
+    I1D3_INFO_FIRMWARE_DATE = 6,    /**< Firmware / calibration date (cached) */
+    I1D3_INFO_LOCK_STATUS = 7       /**< Lock status */
+} i1d3_info_t;
+
+/**
+ * @brief Integration time limits for measurements (seconds)
+ */
+#define I1D3_INTEGRATION_AUTO 0.0   /**< Pick the integration time from a short probe */
+#define I1D3_INTEGRATION_MIN 0.01   /**< Shortest supported integration time */
+#define I1D3_INTEGRATION_MAX 4.0    /**< Longest supported integration time */
+
 /**
  * @brief Color measurement results in multiple color spaces
  */
 typedef struct {
     double X, Y, Z;    /**< CIE XYZ color coordinates */
     double x, y;       /**< CIE xy chromaticity coordinates */
-    double CCT;        /**< Correlated Color Temperature in Kelvin */
+    double CCT;        /**< Correlated Color Temperature in Kelvin (0 outside 1000..100000 K) */
+    double Duv;        /**< Distance from the Planckian locus in CIE 1960 uv (+ green, - magenta) */
     double L, a, b;    /**< CIE Lab color coordinates */
 } i1d3_color_results;
 
+/**
+ * @brief Opaque device handle
+ *
+ * Owns the fd, protocol state, sensor matrix and statistics of one sensor.
+ * All calls on one device are serialized by a per-device lock, so different
+ * devices can be driven from different threads. The fd-based functions below
+ * look up the handle behind the fd; there is no limit on the fd value.
+ */
+typedef struct i1d3_device i1d3_device;
+
+/**
+ * @brief Per-device measurement statistics
+ */
+typedef struct {
+    unsigned long measurements;  /**< Completed measurements */
+    unsigned long errors;        /**< Failed measurements */
+    double last_measure_ms;      /**< Duration of the last measurement (start to result) */
+    double total_measure_ms;     /**< Sum of all measurement durations */
+} i1d3_device_stats;
+
 /**
  * @brief Open a connection to an i1Display3 device
  *
- * This function opens the HID device at the specified path and attempts to set
- * appropriate permissions for access. The device must be physically connected
- * and accessible.
+ * This function opens the HID device at the specified path. The device must be
+ * physically connected and accessible; install 99-i1d3.rules (make install-udev)
+ * so that no privileges are needed. i1d3_discover() finds the path.
  *
  * @param path Path to the HID device (e.g., "/dev/hidraw0")
  * @return File descriptor on success, negative error code on failure
  */
 int i1d3_open(const char *path);
 
+/**
+ * @brief Open a device and return its handle
+ *
+ * Equivalent to i1d3_open(); the fd API and the handle API can be mixed
+ * through i1d3_device_fd() and i1d3_device_from_fd().
+ *
+ * @param path Path to the HID device (e.g., "/dev/hidraw0")
+ * @param error Optional, receives the error code on failure
+ * @return Device handle, or NULL on failure
+ */
+i1d3_device *i1d3_device_open(const char *path, i1d3_error_t *error);
+
+/**
+ * @brief Close a device handle (same as i1d3_close() on its fd)
+ *
+ * The handle must not be used afterwards.
+ *
+ * @param dev Device handle
+ * @return I1D3_SUCCESS on success, error code on failure
+ */
+i1d3_error_t i1d3_device_close(i1d3_device *dev);
+
+/**
+ * @brief Get the handle behind an fd returned by i1d3_open()
+ *
+ * @param fd File descriptor
+ * @return Device handle, or NULL if fd is not an open device
+ */
+i1d3_device *i1d3_device_from_fd(int fd);
+
+/**
+ * @brief Get the fd of a device handle
+ *
+ * @param dev Device handle
+ * @return File descriptor, negative error code if dev is NULL
+ */
+int i1d3_device_fd(const i1d3_device *dev);
+
+/**
+ * @brief Get the device node a handle was opened from
+ *
+ * @param dev Device handle
+ * @return Path given to i1d3_device_open(), "" for other transports
+ */
+const char *i1d3_device_path(const i1d3_device *dev);
+
+/**
+ * @brief Replace the raw frequency -> XYZ matrix of one sensor
+ *
+ * Devices start with the built-in MATRIX; use the FCMM output for the unit.
+ *
+ * @param dev Device handle
+ * @param matrix 3x3 matrix, rows produce X, Y, Z
+ * @return I1D3_SUCCESS on success, error code on failure
+ */
+i1d3_error_t i1d3_device_set_matrix(i1d3_device *dev, const double matrix[3][3]);
+
+/**
+ * @brief Get the raw frequency -> XYZ matrix of one sensor
+ *
+ * @param dev Device handle
+ * @param matrix Receives the 3x3 matrix
+ * @return I1D3_SUCCESS on success, error code on failure
+ */
+i1d3_error_t i1d3_device_get_matrix(i1d3_device *dev, double matrix[3][3]);
+
+/**
+ * @brief Get the measurement statistics of one sensor
+ *
+ * @param dev Device handle
+ * @param stats Receives a snapshot of the statistics
+ * @return I1D3_SUCCESS on success, error code on failure
+ */
+i1d3_error_t i1d3_device_get_stats(i1d3_device *dev, i1d3_device_stats *stats);
+
+/**
+ * @brief Transport backend: how reports reach a sensor
+ *
+ * Every transport exposes a pollable fd (passed to
+ * i1d3_device_open_transport()) that becomes readable when a report is
+ * waiting; recv() is only called after that. The fd also identifies the
+ * device in the fd-based API.
+ */
+typedef struct {
+    const char *name;                                       /**< Backend name for logs */
+    int (*send)(void *ctx, const uint8_t *buf, int len);    /**< Write one report, returns bytes written or -1 */
+    int (*recv)(void *ctx, uint8_t *buf, int maxlen);       /**< Read one pending report, returns its length or -1 */
+    int (*close)(void *ctx);                                /**< Release the transport, returns 0 or -1 */
+} i1d3_transport_ops;
+
+/**
+ * @brief hidraw transport used by i1d3_open(); ctx is the fd cast to a pointer
+ */
+extern const i1d3_transport_ops i1d3_hidraw_transport;
+
+/**
+ * @brief Open a device over an arbitrary transport
+ *
+ * The device starts in I1D3_STATE_CONNECTED like i1d3_device_open(), and
+ * closing it calls ops->close(ctx).
+ *
+ * @param ops Transport functions (must stay valid while the device is open)
+ * @param ctx Transport context passed to ops
+ * @param fd Pollable fd, readable whenever recv() has a report
+ * @param serial Serial number used as the cache key, or NULL to read it from sysfs
+ * @param error Optional error code output
+ * @return Device handle, or NULL on failure
+ */
+i1d3_device *i1d3_device_open_transport(const i1d3_transport_ops *ops, void *ctx, int fd, const char *serial, i1d3_error_t *error);
+
+/**
+ * @brief Copy the built-in sensor correction matrix
+ *
+ * @param matrix Output matrix (raw frequency -> XYZ)
+ */
+void i1d3_get_default_matrix(double matrix[3][3]);
+
 /**
  * @brief Close the connection to an i1Display3 device
  *
@@ -74,6 +234,8 @@ int i1d3_send(int fd, uint8_t *buf, int len);
 /**
  * @brief Receive data from the i1Display3 device
  *
+ * Waits up to 1 second for a report to arrive (see i1d3_recv_timeout()).
+ *
  * @param fd File descriptor
  * @param buf Buffer to store received data
  * @param maxlen Maximum number of bytes to receive
@@ -81,17 +243,61 @@ int i1d3_send(int fd, uint8_t *buf, int len);
  */
 int i1d3_recv(int fd, uint8_t *buf, int maxlen);
 
+/**
+ * @brief Receive data from the i1Display3 device with an explicit deadline
+ *
+ * Polls the device until a report is readable and returns as soon as it
+ * arrives. The deadline is measured on the driver clock (i1d3_set_clock()).
+ *
+ * @param fd File descriptor
+ * @param buf Buffer to store received data
+ * @param maxlen Maximum number of bytes to receive
+ * @param timeout_ms Maximum time to wait in milliseconds (0 = only check)
+ * @return Number of bytes received on success, I1D3_ERROR_TIMEOUT if no report
+ *         arrived in time, other negative error code on failure
+ */
+int i1d3_recv_timeout(int fd, uint8_t *buf, int maxlen, int timeout_ms);
+
 /**
  * @brief Initialize the i1Display3 device
  *
  * Sends the required initialization sequence to prepare the device for operation.
  * Must be called after opening the device and before attempting to unlock it.
  *
+ * Each command only waits for its own reply. Replies that never change for a
+ * unit (product name/type, firmware version, serial, firmware date) are cached
+ * in $I1D3_CACHE_DIR (default $XDG_CACHE_HOME/i1d3 or ~/.cache/i1d3), keyed by
+ * the USB serial of the hidraw device, and are not queried again on reconnect.
+ * Set I1D3_CACHE_DIR to an empty string to disable the cache.
+ *
  * @param fd File descriptor
  * @return I1D3_SUCCESS on success, error code on failure
  */
 i1d3_error_t i1d3_init_sequence(int fd);
 
+/**
+ * @brief Get the USB serial of the hidraw device
+ *
+ * Read from sysfs (HID_UNIQ) during i1d3_init_sequence(). It keys the on-disk
+ * device caches.
+ *
+ * @param fd File descriptor
+ * @return Serial string, empty if unknown
+ */
+const char* i1d3_get_serial(int fd);
+
+/**
+ * @brief Get the raw reply to one of the init sequence commands
+ *
+ * The reply may come from the on-disk cache rather than the device.
+ *
+ * @param fd File descriptor
+ * @param index Init command, see i1d3_info_t
+ * @param reply Buffer receiving the 64-byte reply
+ * @return I1D3_SUCCESS on success, error code on failure
+ */
+i1d3_error_t i1d3_get_info_reply(int fd, int index, uint8_t reply[64]);
+
 /**
  * @brief Unlock the device using specific manufacturer keys
  *
@@ -104,11 +310,27 @@ i1d3_error_t i1d3_init_sequence(int fd);
  */
 i1d3_error_t i1d3_unlock(int fd, const uint32_t key[2]);
 
+/**
+ * @brief Compute the 0x9A response report for a 0x99 challenge report
+ *
+ * This is the calculation i1d3_unlock() performs; it is exposed so an
+ * emulator can check responses. challenge and response may be the same
+ * buffer.
+ *
+ * @param key Unlock key (two 32-bit values)
+ * @param challenge Reply to the 0x99 command
+ * @param response Output report to send
+ */
+void i1d3_unlock_response(const uint32_t key[2], const uint8_t challenge[64], uint8_t response[64]);
+
 /**
  * @brief Automatically find and apply the correct unlock key
  *
  * Tries all known manufacturer keys in sequence until one works.
  * This is the recommended way to unlock devices.
+ * The key that last unlocked the unit (cached per device serial next to the
+ * init sequence cache) is tried first, so the common case takes a single
+ * challenge/response round trip. Other keys follow without fixed delays.
  *
  * @param fd File descriptor
  * @return I1D3_SUCCESS on success, error code on failure
@@ -120,6 +342,8 @@ i1d3_error_t i1d3_auto_find_unlock(int fd);
  *
  * Takes a color measurement using the device's sensor and returns results
  * in XYZ, xy, CCT, and Lab color spaces. The device must be unlocked first.
+ * Returns as soon as the measurement report arrives; I1D3_ERROR_TIMEOUT is
+ * returned if it does not arrive within 500 ms after the integration window.
  *
  * @param fd File descriptor
  * @param res Pointer to structure to store measurement results
@@ -127,6 +351,877 @@ i1d3_error_t i1d3_auto_find_unlock(int fd);
  */
 i1d3_error_t i1d3_aio_measure(int fd, i1d3_color_results *res);
 
+/**
+ * @brief Perform a color measurement with an explicit integration time
+ *
+ * Same as i1d3_aio_measure() but overrides the integration time configured
+ * with i1d3_set_integration_time() for this measurement only.
+ *
+ * @param fd File descriptor
+ * @param seconds Integration time in seconds (I1D3_INTEGRATION_MIN..I1D3_INTEGRATION_MAX),
+ *                or I1D3_INTEGRATION_AUTO for auto-ranging
+ * @param res Pointer to structure to store measurement results
+ * @return I1D3_SUCCESS on success, error code on failure
+ */
+i1d3_error_t i1d3_aio_measure_ex(int fd, double seconds, i1d3_color_results *res);
+
+/**
+ * @brief Options for i1d3_measure_batch()
+ */
+typedef struct {
+    double integration_time; /**< Seconds per reading, or I1D3_INTEGRATION_AUTO (probed once per batch) */
+    double reject_sigma;     /**< Reject readings further than this many std devs from the running mean (0 = keep all) */
+    int max_failures;        /**< Failed readings tolerated before the batch is abandoned */
+} i1d3_batch_opts;
+
+/**
+ * @brief Statistics of a batch of readings
+ *
+ * std, min and max are indexed X, Y, Z.
+ */
+typedef struct {
+    i1d3_color_results mean;  /**< Mean XYZ of the accepted readings and its xy, CCT, Lab */
+    double std[3];            /**< Sample standard deviation of X, Y, Z */
+    double min[3];            /**< Smallest accepted X, Y, Z */
+    double max[3];            /**< Largest accepted X, Y, Z */
+    int count;                /**< Readings accepted */
+    int rejected;             /**< Readings rejected as outliers */
+    int failed;               /**< Readings that returned an error */
+    double integration_time;  /**< Integration time used (resolved value when auto-ranging) */
+    double elapsed_ms;        /**< Wall time of the whole batch */
+} i1d3_batch_stats;
+
+/**
+ * @brief Take n readings back to back and reduce them on the host
+ *
+ * The device is held for the whole batch and each measure command is sent
+ * as soon as the previous report arrives. Statistics are accumulated in a
+ * single pass (Welford). Once 5 readings are accepted, a reading whose X, Y
+ * or Z lies more than reject_sigma standard deviations from the running
+ * mean is counted as rejected and left out.
+ *
+ * @param dev Device handle in I1D3_STATE_UNLOCKED
+ * @param n Number of readings
+ * @param opts Options, or NULL for the device's integration time, 3 sigma and no failures
+ * @param out Statistics
+ * @return I1D3_SUCCESS if at least one reading was accepted within max_failures, error code otherwise
+ */
+i1d3_error_t i1d3_measure_batch(i1d3_device *dev, int n, const i1d3_batch_opts *opts, i1d3_batch_stats *out);
+
+/**
+ * @brief Convert the counts of a 0x04 measure report to XYZ
+ *
+ * Edge counts and clocks become per-channel frequencies, which the sensor
+ * matrix maps to XYZ. Together with i1d3_xyz_to_color() this is exactly
+ * what the measurement functions do with a report.
+ *
+ * @param report Measure reply (counts at bytes 2..13, clocks at 14..25)
+ * @param matrix Sensor correction matrix (see i1d3_get_default_matrix())
+ * @param xyz Output X, Y, Z
+ */
+void i1d3_counts_to_xyz(const uint8_t report[64], const double matrix[3][3], double xyz[3]);
+
+/**
+ * @brief Fill xy, CCT/Duv and Lab (D50) from XYZ
+ *
+ * Uses the same conversions as the measurement functions, e.g. for values
+ * averaged by the caller.
+ *
+ * @param X CIE X
+ * @param Y CIE Y
+ * @param Z CIE Z
+ * @param res Output; X, Y, Z are copied in as well
+ */
+void i1d3_xyz_to_color(double X, double Y, double Z, i1d3_color_results *res);
+
+/**
+ * @brief Correlated colour temperature and Duv of a chromaticity
+ *
+ * Robertson's method on a Planckian locus table generated at build time
+ * (1 mired steps, 1000..100000 K, CIE 1931 2 degree observer): a binary
+ * search finds the two isotemperature lines around the point in CIE 1960 uv,
+ * and CCT and the locus point are interpolated between them in mired.
+ * Duv is the signed uv distance to that locus point. CCT is only meaningful
+ * for |Duv| up to about 0.05.
+ *
+ * @param x CIE x
+ * @param y CIE y
+ * @param cct Optional, receives the CCT in Kelvin (0 on error)
+ * @param duv Optional, receives Duv (0 on error)
+ * @return I1D3_SUCCESS, or I1D3_ERROR_INVALID_PARAMETER if the point lies outside the table
+ */
+i1d3_error_t i1d3_xy_to_cct(double x, double y, double *cct, double *duv);
+
+/**
+ * @brief Raw readings in structure-of-arrays layout, as stored in a 0x04 report
+ */
+typedef struct {
+    const uint32_t *count[3]; /**< R, G, B edge counts (report bytes 2, 6, 10) */
+    const uint32_t *clock[3]; /**< R, G, B integration clocks (report bytes 14, 18, 22) */
+} i1d3_raw_soa;
+
+/**
+ * @brief Output columns of i1d3_convert_batch()
+ *
+ * X, Y and Z are required. Any other column may be NULL to skip it.
+ */
+typedef struct {
+    double *X, *Y, *Z;
+    double *x, *y;
+    double *CCT, *Duv;
+    double *L, *a, *b;
+} i1d3_color_soa;
+
+/**
+ * @brief Instruction set used by i1d3_convert_batch()
+ */
+typedef enum {
+    I1D3_SIMD_AUTO = 0,   /**< Best one supported by the CPU */
+    I1D3_SIMD_SCALAR = 1, /**< Portable C */
+    I1D3_SIMD_SSE2 = 2,   /**< 2 readings per step (x86) */
+    I1D3_SIMD_AVX2 = 3    /**< 4 readings per step (x86, detected at run time) */
+} i1d3_simd_t;
+
+/**
+ * @brief Convert many raw readings to XYZ, xy, CCT/Duv and Lab (D50)
+ *
+ * Same formulas as i1d3_counts_to_xyz() + i1d3_xyz_to_color(), vectorized
+ * over the readings, e.g. to reprocess archived counts with a new sensor
+ * matrix. The Lab cube root uses a bit-level estimate refined by two Halley
+ * steps and the Lab knee is selected without branching; results agree with
+ * i1d3_xyz_to_color() to within 1e-8 relative. CCT and Duv use
+ * i1d3_xy_to_cct() per reading after the vector pass.
+ *
+ * @param raw Input columns of n readings each
+ * @param n Number of readings
+ * @param matrix Sensor correction matrix (see i1d3_get_default_matrix())
+ * @param out Output columns of n entries each
+ * @return I1D3_SUCCESS on success, I1D3_ERROR_INVALID_PARAMETER on missing columns or n < 0
+ */
+i1d3_error_t i1d3_convert_batch(const i1d3_raw_soa *raw, int n, const double matrix[3][3], const i1d3_color_soa *out);
+
+/**
+ * @brief Force the instruction set of i1d3_convert_batch() (for testing and benchmarks)
+ *
+ * @param simd I1D3_SIMD_AUTO to go back to detection, or a specific set
+ * @return I1D3_SUCCESS, or I1D3_ERROR_INVALID_PARAMETER if the CPU or build does not support it
+ */
+i1d3_error_t i1d3_set_convert_simd(i1d3_simd_t simd);
+
+/**
+ * @brief Instruction set i1d3_convert_batch() currently uses
+ *
+ * @return I1D3_SIMD_SCALAR, I1D3_SIMD_SSE2 or I1D3_SIMD_AVX2
+ */
+i1d3_simd_t i1d3_get_convert_simd(void);
+
+/**
+ * @brief One patch measured by the reference instrument and by the i1d3
+ */
+typedef struct {
+    double ref[3];   /**< Reference XYZ */
+    double meas[3];  /**< i1d3 XYZ of the same patch */
+} i1d3_fcmm_sample;
+
+#define I1D3_FCMM_OFFSET 0x1    /**< Fit a 3x4 matrix: a constant offset per channel as well */
+#define I1D3_FCMM_RELATIVE 0x2  /**< Weight each patch by 1/Y_ref^2 so dark patches count as much as bright ones */
+
+/**
+ * @brief Sensor correction fitted by i1d3_fcmm_solve()
+ *
+ * corrected = matrix * meas + offset.
+ */
+typedef struct {
+    double matrix[3][3];  /**< Correction matrix */
+    double offset[3];     /**< Offset, zero unless fitted with I1D3_FCMM_OFFSET */
+    double rms;           /**< RMS XYZ residual of the corrected samples */
+    double max_duv;       /**< Largest u'v' distance between a corrected sample and its reference */
+    int count;            /**< Samples used */
+} i1d3_fcmm_fit;
+
+/**
+ * @brief Fit the forward colour matrix (FCMM) that maps i1d3 XYZ to reference XYZ
+ *
+ * Least squares over all samples, solved from the normal equations. With
+ * exactly 3 patches and no offset this is the classic ref * inv(meas).
+ * More patches (primaries, white, greys, mixtures) average out noise and
+ * spread the error across the gamut.
+ *
+ * @param samples Paired readings
+ * @param n Number of samples, at least 3 (4 with I1D3_FCMM_OFFSET)
+ * @param flags I1D3_FCMM_* flags, or 0 for a plain 3x3 fit
+ * @param fit Output correction and its residuals
+ * @return I1D3_SUCCESS, or I1D3_ERROR_INVALID_PARAMETER if the samples do not determine the fit
+ */
+i1d3_error_t i1d3_fcmm_solve(const i1d3_fcmm_sample *samples, int n, int flags, i1d3_fcmm_fit *fit);
+
+/**
+ * @brief Apply a fitted correction to one i1d3 reading
+ *
+ * @param fit Correction from i1d3_fcmm_solve()
+ * @param meas i1d3 XYZ
+ * @param xyz Corrected XYZ (may alias meas)
+ */
+void i1d3_fcmm_apply(const i1d3_fcmm_fit *fit, const double meas[3], double xyz[3]);
+
+/**
+ * @brief Colour difference metrics
+ */
+typedef enum {
+    I1D3_DE76 = 0,    /**< CIE 1976: Euclidean distance in Lab */
+    I1D3_DE94 = 1,    /**< CIE 1994, graphic arts weights, ref is the standard */
+    I1D3_DE2000 = 2,  /**< CIEDE2000 with kL = kC = kH = 1 */
+    I1D3_DE_ITP = 3   /**< ITU-R BT.2124 delta ICtCp; XYZ taken as absolute cd/m2 */
+} i1d3_delta_e_t;
+
+/**
+ * @brief Options for i1d3_delta_e_batch()
+ */
+typedef struct {
+    const double *white;  /**< Lab reference white XYZ (same units as the samples), NULL = D50 as in i1d3_xyz_to_color() */
+    int threads;          /**< Worker threads, 0 = one per online CPU */
+} i1d3_delta_e_opts;
+
+/**
+ * @brief Colour difference between a reference and a measured XYZ
+ *
+ * The Lab metrics use the same Lab as i1d3_xyz_to_color(), relative to
+ * the given white. Delta ICtCp ignores the white and needs absolute
+ * luminance, which is what the sensor reports.
+ *
+ * @param metric Metric
+ * @param ref Reference XYZ
+ * @param meas Measured XYZ
+ * @param white Lab reference white XYZ, NULL = D50
+ * @param de Receives the difference
+ * @return I1D3_SUCCESS on success, error code on failure
+ */
+i1d3_error_t i1d3_delta_e(i1d3_delta_e_t metric, const double ref[3], const double meas[3], const double white[3], double *de);
+
+/**
+ * @brief Colour differences of many XYZ pairs
+ *
+ * Pairs are converted in blocks of 256 and scored from the converted
+ * columns. Large batches are split across threads in contiguous slices;
+ * batches under 4096 pairs per thread stay on the calling thread. Results
+ * do not depend on the thread count.
+ *
+ * @param metric Metric
+ * @param ref n reference XYZ triples, packed (X0 Y0 Z0 X1 ...)
+ * @param meas n measured XYZ triples, packed
+ * @param n Number of pairs
+ * @param opts Options, or NULL for D50 and all CPUs
+ * @param out n differences
+ * @return I1D3_SUCCESS on success, error code on failure
+ */
+i1d3_error_t i1d3_delta_e_batch(i1d3_delta_e_t metric, const double *ref, const double *meas, int n,
+                                const i1d3_delta_e_opts *opts, double *out);
+
+/**
+ * @brief Start a measurement without waiting for it (split-phase API)
+ *
+ * Sends the measure command with the configured integration time and moves
+ * the device to I1D3_STATE_MEASURING. The caller is free to do other work
+ * (set the next patch, process the previous one) while the sensor integrates,
+ * then calls i1d3_measure_poll() and/or i1d3_measure_collect().
+ * i1d3_aio_measure() is i1d3_measure_start() followed by i1d3_measure_collect().
+ *
+ * @param fd File descriptor
+ * @return I1D3_SUCCESS on success, error code on failure
+ */
+i1d3_error_t i1d3_measure_start(int fd);
+
+/**
+ * @brief Check whether the measurement in flight has completed, without blocking
+ *
+ * With auto-ranging, a probe that turns out too dark is re-armed with a longer
+ * integration here, so keep polling until 1 is returned. Once the measurement
+ * deadline has passed without a report, I1D3_ERROR_TIMEOUT is returned. On error
+ * the device returns to I1D3_STATE_UNLOCKED.
+ *
+ * @param fd File descriptor
+ * @return 1 if the result is ready, 0 if still integrating, negative error code on failure
+ */
+int i1d3_measure_poll(int fd);
+
+/**
+ * @brief Wait for the measurement in flight and convert its result
+ *
+ * Blocks until the report arrives (or I1D3_ERROR_TIMEOUT) and returns the
+ * device to I1D3_STATE_UNLOCKED.
+ *
+ * @param fd File descriptor
+ * @param res Pointer to structure to store measurement results
+ * @return I1D3_SUCCESS on success, error code on failure
+ */
+i1d3_error_t i1d3_measure_collect(int fd, i1d3_color_results *res);
+
+/**
+ * @brief Set the integration time used by i1d3_aio_measure()
+ *
+ * Shorter integrations finish sooner but count fewer sensor edges, so dark
+ * patches lose precision. With I1D3_INTEGRATION_AUTO the driver first takes a
+ * 20 ms probe and only re-measures with a longer integration when the strongest
+ * channel has fewer counts than the auto-range precision requires.
+ * The default is 0.2 s.
+ *
+ * @param fd File descriptor
+ * @param seconds Integration time in seconds, or I1D3_INTEGRATION_AUTO
+ * @return I1D3_SUCCESS on success, error code on failure
+ */
+i1d3_error_t i1d3_set_integration_time(int fd, double seconds);
+
+/**
+ * @brief Get the integration time configured for the device
+ *
+ * @param fd File descriptor
+ * @return Integration time in seconds, or I1D3_INTEGRATION_AUTO
+ */
+double i1d3_get_integration_time(int fd);
+
+/**
+ * @brief Set the precision targeted by auto-ranging
+ *
+ * The precision is the relative resolution of the strongest channel, i.e.
+ * auto-ranging integrates until that channel has at least 1/precision counts
+ * (or I1D3_INTEGRATION_MAX is reached). The default is 0.001.
+ *
+ * @param fd File descriptor
+ * @param precision Relative resolution in (0, 1)
+ * @return I1D3_SUCCESS on success, error code on failure
+ */
+i1d3_error_t i1d3_set_auto_range_precision(int fd, double precision);
+
+#define I1D3_VENDOR_ID 0x0765  /**< X-Rite */
+#define I1D3_PRODUCT_ID 0x5020 /**< i1Display3 and its OEM variants */
+
+/**
+ * @brief A sensor found through sysfs
+ */
+typedef struct {
+    char path[64];        /**< Device node, e.g. "/dev/hidraw3" */
+    char serial[64];      /**< USB serial (HID_UNIQ), "" if unknown */
+    char name[128];       /**< HID name reported by the kernel */
+    uint16_t vendor_id;
+    uint16_t product_id;
+} i1d3_device_info;
+
+/**
+ * @brief Enumerate connected sensors
+ *
+ * Scans /sys/class/hidraw for X-Rite i1Display3 devices. Only sysfs is read;
+ * no device is opened.
+ *
+ * @param list Array receiving up to max entries, sorted by path
+ * @param max Size of list (may be 0 to only count)
+ * @return Number of sensors found (may exceed max), negative error code on failure
+ */
+int i1d3_discover(i1d3_device_info *list, int max);
+
+/**
+ * @brief Hotplug monitor
+ *
+ * Listens to kernel and udev uevents on a netlink socket and reports
+ * sensors being connected and disconnected. When udev is running, an
+ * arrival is reported once the device node is accessible (after the udev
+ * rules have been applied).
+ */
+typedef struct i1d3_monitor i1d3_monitor;
+
+typedef enum {
+    I1D3_HOTPLUG_ADD,
+    I1D3_HOTPLUG_REMOVE
+} i1d3_hotplug_action;
+
+typedef struct {
+    i1d3_hotplug_action action;
+    i1d3_device_info info; /**< Only path is set for I1D3_HOTPLUG_REMOVE */
+} i1d3_hotplug_event;
+
+/**
+ * @brief Start monitoring
+ *
+ * @param error Optional, receives the error code on failure
+ * @return Monitor, or NULL on failure
+ */
+i1d3_monitor *i1d3_monitor_create(i1d3_error_t *error);
+
+/**
+ * @brief Pollable fd, readable when events may be pending
+ *
+ * @param mon Monitor
+ * @return File descriptor, negative error code if mon is NULL
+ */
+int i1d3_monitor_fd(const i1d3_monitor *mon);
+
+/**
+ * @brief Get the next hotplug event without blocking
+ *
+ * Uevents of other devices are consumed and skipped.
+ *
+ * @param mon Monitor
+ * @param event Receives the event
+ * @return 1 if an event was stored, 0 if none is pending, negative error code on failure
+ */
+int i1d3_monitor_read(i1d3_monitor *mon, i1d3_hotplug_event *event);
+
+/**
+ * @brief Stop monitoring and free the monitor
+ *
+ * @param mon Monitor
+ */
+void i1d3_monitor_destroy(i1d3_monitor *mon);
+
+/**
+ * @brief Multi-sensor manager
+ *
+ * Drives several devices concurrently: measurements are started on all of
+ * them and their replies are collected from a single poll() loop, so N
+ * sensors take about as long as the slowest one instead of the sum.
+ */
+typedef struct i1d3_manager i1d3_manager;
+
+/**
+ * @brief Create an empty manager
+ *
+ * @return Manager, or NULL on allocation failure
+ */
+i1d3_manager *i1d3_manager_create(void);
+
+/**
+ * @brief Destroy a manager
+ *
+ * Devices opened by the manager (i1d3_manager_attach_all(),
+ * i1d3_manager_hotplug()) are closed; devices added by the caller are not.
+ *
+ * @param mgr Manager
+ */
+void i1d3_manager_destroy(i1d3_manager *mgr);
+
+/**
+ * @brief Add a device to the manager
+ *
+ * @param mgr Manager
+ * @param dev Device handle, owned by the caller
+ * @return I1D3_SUCCESS on success, error code on failure
+ */
+i1d3_error_t i1d3_manager_add(i1d3_manager *mgr, i1d3_device *dev);
+
+/**
+ * @brief Number of devices in the manager
+ *
+ * @param mgr Manager
+ * @return Device count
+ */
+int i1d3_manager_count(const i1d3_manager *mgr);
+
+/**
+ * @brief Remove a device from the manager
+ *
+ * Devices opened by the manager are closed, others are left to the caller.
+ * The indices of the devices after it shift down by one.
+ *
+ * @param mgr Manager
+ * @param dev Device handle
+ * @return I1D3_SUCCESS on success, I1D3_ERROR_INVALID_PARAMETER if dev is not in the manager
+ */
+i1d3_error_t i1d3_manager_remove(i1d3_manager *mgr, i1d3_device *dev);
+
+/**
+ * @brief Open and add every connected sensor
+ *
+ * Runs i1d3_discover() and opens each sensor whose path is not already in
+ * the manager. The manager owns the devices it opens.
+ *
+ * @param mgr Manager
+ * @return Number of devices added, negative error code if none could be opened
+ */
+int i1d3_manager_attach_all(i1d3_manager *mgr);
+
+/**
+ * @brief Apply pending hotplug events
+ *
+ * Opens and adds sensors that appeared, removes and closes sensors that
+ * disappeared. Call when i1d3_monitor_fd() is readable, or periodically.
+ * New devices still need i1d3_manager_prepare_all().
+ *
+ * @param mgr Manager
+ * @param mon Monitor
+ * @return Number of devices added or removed, negative error code on failure
+ */
+int i1d3_manager_hotplug(i1d3_manager *mgr, i1d3_monitor *mon);
+
+/**
+ * @brief Get a device by index (in the order they were added)
+ *
+ * @param mgr Manager
+ * @param index Device index
+ * @return Device handle, or NULL if out of range
+ */
+i1d3_device *i1d3_manager_device(const i1d3_manager *mgr, int index);
+
+/**
+ * @brief Run the init sequence and auto-unlock on all devices in parallel
+ *
+ * One thread per device; already unlocked devices are skipped.
+ *
+ * @param mgr Manager
+ * @param status Optional array of i1d3_manager_count() entries receiving each device's result
+ * @return I1D3_SUCCESS if all devices are unlocked, otherwise the first error
+ */
+i1d3_error_t i1d3_manager_prepare_all(i1d3_manager *mgr, i1d3_error_t *status);
+
+/**
+ * @brief Measure all devices concurrently
+ *
+ * Starts a measurement on every device, then collects the replies as they
+ * arrive from one poll() loop. A device that has not answered within the
+ * longest possible measurement gets I1D3_ERROR_TIMEOUT and does not hold up
+ * the others.
+ *
+ * @param mgr Manager
+ * @param results Array of i1d3_manager_count() results
+ * @param status Optional array of i1d3_manager_count() entries receiving each device's result
+ * @return I1D3_SUCCESS if all measurements succeeded, otherwise the first error
+ */
+i1d3_error_t i1d3_manager_measure_all(i1d3_manager *mgr, i1d3_color_results *results, i1d3_error_t *status);
+
+/**
+ * @brief One sample from a continuous acquisition stream
+ */
+typedef struct {
+    i1d3_color_results result; /**< Measurement (zeroed when status is an error) */
+    i1d3_error_t status;       /**< Result of this measurement */
+    uint64_t seq;              /**< Sample number; gaps mean samples were dropped */
+    int64_t start_us;          /**< Driver clock time (microseconds) the measurement was started */
+    int64_t end_us;            /**< Driver clock time the result was received */
+} i1d3_stream_sample;
+
+/**
+ * @brief Continuous acquisition stream
+ *
+ * A dedicated thread re-arms measurements back to back and publishes them
+ * into a preallocated single-producer/single-consumer ring. The consumer
+ * reads at its own pace; when the ring is full new samples are dropped
+ * and counted instead of blocking the producer.
+ */
+typedef struct i1d3_stream i1d3_stream;
+
+/**
+ * @brief Start streaming measurements from an unlocked device
+ *
+ * Each sample uses the device's integration time (see
+ * i1d3_set_integration_time()). Do not measure the device from elsewhere
+ * while it is streaming, and stop the stream before closing the device.
+ *
+ * @param dev Device handle in I1D3_STATE_UNLOCKED
+ * @param capacity Ring size in samples, rounded up to a power of two (0 = 256)
+ * @param error Optional error code output
+ * @return Stream, or NULL on failure
+ */
+i1d3_stream *i1d3_stream_start(i1d3_device *dev, int capacity, i1d3_error_t *error);
+
+/**
+ * @brief Copy pending samples out of the ring without blocking
+ *
+ * Only one thread may read a given stream.
+ *
+ * @param s Stream
+ * @param samples Output array
+ * @param max Capacity of samples
+ * @return Number of samples copied (0 if none), negative error code on failure
+ */
+int i1d3_stream_read(i1d3_stream *s, i1d3_stream_sample *samples, int max);
+
+/**
+ * @brief Wait for samples and copy them out of the ring
+ *
+ * @param s Stream
+ * @param samples Output array
+ * @param max Capacity of samples
+ * @param timeout_ms Maximum wait in milliseconds (-1 = no limit)
+ * @return Number of samples copied (0 on timeout or once the stream has ended), negative error code on failure
+ */
+int i1d3_stream_wait(i1d3_stream *s, i1d3_stream_sample *samples, int max, int timeout_ms);
+
+/**
+ * @brief File descriptor that polls readable while samples are pending
+ *
+ * Lets a stream share an existing poll()/epoll loop; drain it with
+ * i1d3_stream_read().
+ *
+ * @param s Stream
+ * @return File descriptor, negative error code on failure
+ */
+int i1d3_stream_fd(const i1d3_stream *s);
+
+/**
+ * @brief Check whether the acquisition thread is still running
+ *
+ * The thread exits on its own when the device is closed or stops
+ * responding; remaining samples can still be read.
+ *
+ * @param s Stream
+ * @return true while measurements are being taken
+ */
+bool i1d3_stream_running(const i1d3_stream *s);
+
+/**
+ * @brief Number of samples dropped because the ring was full
+ *
+ * @param s Stream
+ * @return Dropped sample count
+ */
+uint64_t i1d3_stream_dropped(const i1d3_stream *s);
+
+/**
+ * @brief Stop streaming and free the stream
+ *
+ * Waits for the measurement in flight to finish; the device is left
+ * unlocked and idle.
+ *
+ * @param s Stream
+ * @return I1D3_SUCCESS, or the error that ended the stream early
+ */
+i1d3_error_t i1d3_stream_stop(i1d3_stream *s);
+
+/**
+ * @brief Software i1Display3
+ *
+ * Implements the 0x99/0x9A challenge-response, the init/info commands and
+ * the 0x04 measure reply, so the whole stack can run without a sensor.
+ * Counts are derived from the panel XYZ through the inverse of the
+ * built-in correction matrix, so an emulated measurement reads back the
+ * configured XYZ (times the response, plus noise).
+ */
+typedef struct i1d3_emulator i1d3_emulator;
+
+/**
+ * @brief Panel callback: fills the XYZ the emulated sensor sees for one measurement
+ */
+typedef void (*i1d3_emulator_panel_fn)(void *user, double xyz[3]);
+
+/**
+ * @brief Emulator settings (start from i1d3_emulator_default_config())
+ */
+typedef struct {
+    double X, Y, Z;                 /**< Panel colour seen by the sensor */
+    i1d3_emulator_panel_fn panel;   /**< Optional: called per measurement instead of using X, Y, Z */
+    void *panel_user;               /**< Passed to panel */
+    double response[3][3];          /**< Spectral mismatch: the sensor responds to response * XYZ (identity = ideal unit) */
+    double noise;                   /**< Relative standard deviation of each channel (0 = noiseless) */
+    int latency_us;                 /**< Added to every reply (USB round trip) */
+    uint32_t key[2];                /**< Unlock key the emulated unit accepts */
+    const char *serial;             /**< Serial number (NULL = "EMU00001") */
+    uint64_t seed;                  /**< Seed for challenges and noise; equal seeds give equal runs */
+} i1d3_emulator_config;
+
+/**
+ * @brief Transports that connect a device handle to an emulator
+ */
+typedef enum {
+    I1D3_TRANSPORT_SOCKETPAIR = 0,  /**< SOCK_SEQPACKET pair; the emulator answers from its own thread */
+    I1D3_TRANSPORT_INPROC = 1       /**< No thread; replies are computed on send and released by a timerfd */
+} i1d3_transport_kind;
+
+/**
+ * @brief Default emulator settings
+ *
+ * D65 white at 100 cd/m2, identity response, no noise, 1 ms latency,
+ * Retail key, seed 1.
+ *
+ * @param cfg Output settings
+ */
+void i1d3_emulator_default_config(i1d3_emulator_config *cfg);
+
+/**
+ * @brief Create an emulator
+ *
+ * @param cfg Settings, or NULL for the defaults
+ * @return Emulator, or NULL on failure
+ */
+i1d3_emulator *i1d3_emulator_create(const i1d3_emulator_config *cfg);
+
+/**
+ * @brief Destroy an emulator (close its devices first)
+ *
+ * @param emu Emulator
+ */
+void i1d3_emulator_destroy(i1d3_emulator *emu);
+
+/**
+ * @brief Change the panel colour; takes effect from the next measurement
+ *
+ * @param emu Emulator
+ * @param X CIE X
+ * @param Y CIE Y
+ * @param Z CIE Z
+ */
+void i1d3_emulator_set_xyz(i1d3_emulator *emu, double X, double Y, double Z);
+
+/**
+ * @brief Compute the emulator's reply to one command report
+ *
+ * This is what the transports call; it can also be used directly.
+ *
+ * @param emu Emulator
+ * @param cmd Command report
+ * @param reply Reply report
+ * @param delay_us Time after which a real unit would deliver the reply
+ * @return 1 when a reply was produced, negative error code on failure
+ */
+int i1d3_emulator_process(i1d3_emulator *emu, const uint8_t cmd[64], uint8_t reply[64], int64_t *delay_us);
+
+/**
+ * @brief Connect a new device handle to the emulator
+ *
+ * The unit starts locked in I1D3_STATE_CONNECTED; run i1d3_init_sequence()
+ * and i1d3_auto_find_unlock() as for real hardware. Use one connection per
+ * emulator at a time.
+ *
+ * @param emu Emulator (must outlive the device)
+ * @param kind Transport
+ * @param error Optional error code output
+ * @return Device handle, or NULL on failure
+ */
+i1d3_device *i1d3_emulator_open(i1d3_emulator *emu, i1d3_transport_kind kind, i1d3_error_t *error);
+
+/**
+ * @brief Time source for every timestamp, deadline and wait in the driver
+ *
+ * The system clock reads CLOCK_MONOTONIC and sleeps for real. Under any
+ * other clock, a reply wait polls the fd for the remaining time as usual
+ * and, if nothing came, sleeps on the clock until its deadline; the INPROC
+ * emulator transport releases each reply at once and sleeps on the clock
+ * until it is due. With the virtual clock those sleeps only move time
+ * forward, so emulated runs take no wall time (a wait for a reply that
+ * never comes still costs its timeout in real time).
+ */
+typedef struct {
+    int64_t (*now_us)(void *ctx);                     /**< Monotonic time in microseconds */
+    void (*sleep_until_us)(void *ctx, int64_t when);  /**< Return once now_us() >= when */
+} i1d3_clock_ops;
+
+/**
+ * @brief CLOCK_MONOTONIC; ctx is unused
+ */
+extern const i1d3_clock_ops i1d3_system_clock;
+
+/**
+ * @brief Virtual time that only moves when slept on; ctx is an i1d3_virtual_clock
+ *
+ * Sleeping advances the clock to the wake-up time immediately. Concurrent
+ * sleepers are safe; time never goes backwards.
+ */
+extern const i1d3_clock_ops i1d3_virtual_clock_ops;
+
+/**
+ * @brief State of a virtual clock
+ */
+typedef struct {
+    int64_t now_us;  /**< Current virtual time (use i1d3_clock_now_us() to read it) */
+} i1d3_virtual_clock;
+
+/**
+ * @brief Install the driver clock
+ *
+ * Install it before opening devices and keep ctx alive until the clock is
+ * replaced; deadlines already running stay on the clock that set them.
+ *
+ * @param ops Clock, or NULL for i1d3_system_clock
+ * @param ctx Context passed to ops
+ */
+void i1d3_set_clock(const i1d3_clock_ops *ops, void *ctx);
+
+/**
+ * @brief Whether the installed clock is i1d3_system_clock
+ */
+bool i1d3_clock_is_system(void);
+
+/**
+ * @brief Current time on the driver clock, in microseconds
+ */
+int64_t i1d3_clock_now_us(void);
+
+/**
+ * @brief Sleep on the driver clock until the given time (no-op if it has passed)
+ *
+ * @param when Wake-up time in microseconds on the driver clock
+ */
+void i1d3_clock_sleep_until_us(int64_t when);
+
+/**
+ * @brief Driver operations covered by the built-in statistics
+ */
+typedef enum {
+    I1D3_OP_SEND = 0,     /**< One report written to the transport */
+    I1D3_OP_RECV = 1,     /**< One report read, including the wait for it */
+    I1D3_OP_INIT = 2,     /**< i1d3_init_sequence() */
+    I1D3_OP_UNLOCK = 3,   /**< One challenge/response attempt (i1d3_unlock() and each auto-unlock key) */
+    I1D3_OP_MEASURE = 4,  /**< One measurement, from start to result */
+    I1D3_OP_COUNT = 5
+} i1d3_op_t;
+
+#define I1D3_STATS_BUCKETS 32  /**< Histogram bucket k counts latencies in [2^k, 2^(k+1)) microseconds */
+#define I1D3_STATS_ERRORS 10   /**< errors[] is indexed by -i1d3_error_t */
+
+/**
+ * @brief Counters and latency histogram of one operation
+ */
+typedef struct {
+    uint64_t calls;                          /**< Completed calls, successful or not */
+    uint64_t errors[I1D3_STATS_ERRORS];      /**< Failures by error code (errors[-I1D3_ERROR_TIMEOUT], ...) */
+    uint64_t total_us;                       /**< Sum of latencies */
+    uint64_t max_us;                         /**< Largest latency */
+    uint64_t histogram[I1D3_STATS_BUCKETS];  /**< Log2-bucketed latencies */
+} i1d3_op_stats;
+
+/**
+ * @brief Statistics of all operations, indexed by i1d3_op_t
+ */
+typedef struct {
+    i1d3_op_stats op[I1D3_OP_COUNT];
+} i1d3_stats;
+
+/**
+ * @brief Snapshot the driver-wide statistics
+ *
+ * Counters cover all devices since start-up or the last i1d3_reset_stats().
+ * Recv timeouts are reported by the operation that gave up (init, unlock or
+ * measure), not as recv errors, because polling for a measurement that is
+ * still integrating is not a failure.
+ *
+ * @param stats Output snapshot
+ */
+void i1d3_get_stats(i1d3_stats *stats);
+
+/**
+ * @brief Reset the driver-wide statistics to zero
+ */
+void i1d3_reset_stats(void);
+
+/**
+ * @brief Name of an operation ("send", "recv", ...)
+ *
+ * @param op Operation
+ * @return Static string
+ */
+const char *i1d3_op_name(i1d3_op_t op);
+
+/**
+ * @brief Estimate a latency percentile from the histogram
+ *
+ * @param stats Operation statistics
+ * @param fraction Percentile as a fraction (0.5 = median)
+ * @return Upper bound of the bucket holding the percentile (capped at max_us), in microseconds
+ */
+double i1d3_stats_percentile(const i1d3_op_stats *stats, double fraction);
+
+/**
+ * @brief Print a per-operation summary (calls, errors, mean/p50/p99/max latency) to stdout
+ */
+void i1d3_print_stats(void);
+
 /**
  * @brief Get the current state of the device
  *
@@ -0,0 +1,256 @@
+/* Microbenchmarks for the driver hot paths. Output: CSV "name,ns_per_op,ops_per_s" */
+#define _DEFAULT_SOURCE // clock_gettime() under -std=c99
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "i1d3.h"
+
+#define BENCH_MIN_NS 50000000.0 // Grow the iteration count until one run takes 50 ms
+#define BENCH_RUNS 5            // Report the fastest of this many runs
+
+typedef void (*bench_fn)(void *arg, long iterations);
+
+static volatile double bench_sink; // Keeps results observable so loops are not optimized away
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void run_bench(const char *name, bench_fn fn, void *arg) {
+    long iterations = 1;
+    double elapsed;
+
+    for (;;) {
+        double start = now_ns();
+        fn(arg, iterations);
+        elapsed = now_ns() - start;
+        if (elapsed >= BENCH_MIN_NS || iterations > (1L << 40)) break;
+        iterations *= (elapsed > BENCH_MIN_NS / 100) ? 2 : 10;
+    }
+
+    double best = elapsed / iterations;
+    for (int run = 1; run < BENCH_RUNS; run++) {
+        double start = now_ns();
+        fn(arg, iterations);
+        double ns = (now_ns() - start) / iterations;
+        if (ns < best) best = ns;
+    }
+    printf("%s,%.2f,%.0f\n", name, best, 1e9 / best);
+}
+
+// --- Fixtures ---
+
+typedef struct {
+    uint8_t report[64];
+    double matrix[3][3];
+} report_fixture;
+
+static void bench_counts_to_xyz(void *arg, long iterations) {
+    report_fixture *f = arg;
+    double xyz[3], sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        f->report[2] ^= (uint8_t)i; // Vary the input a little
+        i1d3_counts_to_xyz(f->report, (const double (*)[3])f->matrix, xyz);
+        sum += xyz[1];
+    }
+    bench_sink = sum;
+}
+
+static void bench_xyz_to_color(void *arg, long iterations) {
+    (void)arg;
+    i1d3_color_results res;
+    double sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        i1d3_xyz_to_color(95.047 + (i & 15) * 0.01, 100.0, 108.883, &res);
+        sum += res.CCT + res.L;
+    }
+    bench_sink = sum;
+}
+
+static void bench_decode(void *arg, long iterations) {
+    report_fixture *f = arg;
+    i1d3_color_results res;
+    double xyz[3], sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        f->report[2] ^= (uint8_t)i;
+        i1d3_counts_to_xyz(f->report, (const double (*)[3])f->matrix, xyz);
+        i1d3_xyz_to_color(xyz[0], xyz[1], xyz[2], &res);
+        sum += res.CCT;
+    }
+    bench_sink = sum;
+}
+
+static void bench_unlock_response(void *arg, long iterations) {
+    uint8_t *challenge = arg;
+    uint8_t response[64];
+    const uint32_t key[2] = {0xe9622e9f, 0x8d63e133};
+    double sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        challenge[35] = (uint8_t)i;
+        i1d3_unlock_response(key, challenge, response);
+        sum += response[24];
+    }
+    bench_sink = sum;
+}
+
+static void bench_emulator_measure(void *arg, long iterations) {
+    i1d3_emulator *emu = arg;
+    uint8_t cmd[64] = {0x04, 0x00, 0x9F, 0x24, 0x00, 0x00, 0x07, 0xE8, 0x03}; // 0.2 s
+    uint8_t reply[64];
+    int64_t delay_us;
+    double sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        i1d3_emulator_process(emu, cmd, reply, &delay_us);
+        sum += reply[2];
+    }
+    bench_sink = sum;
+}
+
+#define BATCH_CHUNK 1024 // Readings per i1d3_convert_batch() call
+
+typedef struct {
+    uint32_t count[3][BATCH_CHUNK], clock[3][BATCH_CHUNK];
+    double out[10][BATCH_CHUNK];
+    double matrix[3][3];
+} batch_fixture;
+
+// One iteration = one reading converted to all columns
+static void bench_convert_batch(void *arg, long iterations) {
+    batch_fixture *f = arg;
+    i1d3_raw_soa raw = {{f->count[0], f->count[1], f->count[2]}, {f->clock[0], f->clock[1], f->clock[2]}};
+    i1d3_color_soa out = {f->out[0], f->out[1], f->out[2], f->out[3], f->out[4], f->out[5], f->out[6], f->out[7], f->out[8], f->out[9]};
+    for (long done = 0; done < iterations; done += BATCH_CHUNK) {
+        long n = iterations - done < BATCH_CHUNK ? iterations - done : BATCH_CHUNK;
+        i1d3_convert_batch(&raw, (int)n, (const double (*)[3])f->matrix, &out);
+    }
+    bench_sink = f->out[9][0];
+}
+
+#define DE_CHUNK 1024          // Pairs per i1d3_delta_e_batch() call in the per-pair benchmarks
+#define DE_GRID 47             // 47^3 = 103823 colours in the grid benchmark
+
+typedef struct {
+    i1d3_delta_e_t metric;
+    int threads;
+    int n;
+    double *ref, *meas, *out;
+} delta_e_fixture;
+
+// One iteration = one pair (threads = 1) or one whole grid (threads = 0)
+static void bench_delta_e(void *arg, long iterations) {
+    delta_e_fixture *f = arg;
+    i1d3_delta_e_opts opts = {NULL, f->threads};
+    if (f->threads == 0) {
+        for (long i = 0; i < iterations; i++) i1d3_delta_e_batch(f->metric, f->ref, f->meas, f->n, &opts, f->out);
+    } else {
+        for (long done = 0; done < iterations; done += f->n) {
+            long n = iterations - done < f->n ? iterations - done : f->n;
+            i1d3_delta_e_batch(f->metric, f->ref, f->meas, (int)n, &opts, f->out);
+        }
+    }
+    bench_sink = f->out[0];
+}
+
+// An RGB grid through sRGB primaries, and the same grid through slightly rotated primaries
+static bool delta_e_grid(delta_e_fixture *f, int steps) {
+    f->n = steps * steps * steps;
+    f->ref = malloc(3 * sizeof(double) * f->n);
+    f->meas = malloc(3 * sizeof(double) * f->n);
+    f->out = malloc(sizeof(double) * f->n);
+    if (!f->ref || !f->meas || !f->out) return false;
+    static const double SRGB[3][3] = {{41.24, 35.76, 18.05}, {21.26, 71.52, 7.22}, {1.93, 11.92, 95.05}};
+    static const double SKEW[3][3] = {{1.01, 0.01, -0.005}, {0.004, 0.995, 0.006}, {-0.003, 0.012, 0.985}};
+    for (int i = 0; i < f->n; i++) {
+        double rgb[3] = {(i % steps) / (steps - 1.0), (i / steps % steps) / (steps - 1.0), (i / steps / steps) / (steps - 1.0)};
+        for (int r = 0; r < 3; r++) {
+            double v = 0.05 + SRGB[r][0] * rgb[0] + SRGB[r][1] * rgb[1] + SRGB[r][2] * rgb[2];
+            f->ref[3 * i + r] = v;
+        }
+        for (int r = 0; r < 3; r++) {
+            const double *x = &f->ref[3 * i];
+            f->meas[3 * i + r] = SKEW[r][0] * x[0] + SKEW[r][1] * x[1] + SKEW[r][2] * x[2];
+        }
+    }
+    return true;
+}
+
+int main(void) {
+    // A real measure reply for D65 white, produced by the noiseless emulator
+    i1d3_emulator *emu = i1d3_emulator_create(NULL);
+    if (!emu) {
+        fprintf(stderr, "[FATAL] Failed to create emulator\n");
+        return 1;
+    }
+    uint8_t challenge_cmd[64] = {0x99}, challenge[64], response[64], reply[64];
+    uint8_t measure_cmd[64] = {0x04, 0x00, 0x9F, 0x24, 0x00, 0x00, 0x07, 0xE8, 0x03};
+    const uint32_t retail[2] = {0xe9622e9f, 0x8d63e133};
+    int64_t delay_us;
+    i1d3_emulator_process(emu, challenge_cmd, challenge, &delay_us);
+    i1d3_unlock_response(retail, challenge, response);
+    i1d3_emulator_process(emu, response, reply, &delay_us);
+
+    report_fixture fixture;
+    i1d3_emulator_process(emu, measure_cmd, fixture.report, &delay_us);
+    i1d3_get_default_matrix(fixture.matrix);
+
+    printf("name,ns_per_op,ops_per_s\n");
+    run_bench("counts_to_xyz", bench_counts_to_xyz, &fixture);
+    run_bench("xyz_to_color", bench_xyz_to_color, NULL);
+    run_bench("decode_report", bench_decode, &fixture);
+    run_bench("unlock_response", bench_unlock_response, challenge);
+    run_bench("emulator_measure", bench_emulator_measure, emu);
+
+    // Batch conversion of the same reading with small variations, per instruction set
+    static batch_fixture batch;
+    for (int i = 0; i < BATCH_CHUNK; i++) {
+        for (int c = 0; c < 3; c++) {
+            memcpy(&batch.count[c][i], &fixture.report[2 + 4 * c], sizeof(uint32_t));
+            memcpy(&batch.clock[c][i], &fixture.report[14 + 4 * c], sizeof(uint32_t));
+            batch.count[c][i] += (uint32_t)(i & 63);
+        }
+    }
+    i1d3_get_default_matrix(batch.matrix);
+    static const struct { i1d3_simd_t simd; const char *name; } sets[] = {
+        {I1D3_SIMD_SCALAR, "convert_batch_scalar"},
+        {I1D3_SIMD_SSE2, "convert_batch_sse2"},
+        {I1D3_SIMD_AVX2, "convert_batch_avx2"},
+    };
+    for (size_t i = 0; i < sizeof(sets) / sizeof(sets[0]); i++) {
+        if (i1d3_set_convert_simd(sets[i].simd) == I1D3_SUCCESS) run_bench(sets[i].name, bench_convert_batch, &batch);
+    }
+    i1d3_set_convert_simd(I1D3_SIMD_AUTO);
+
+    // Colour differences: per pair on one thread, then a 100k colour grid on all CPUs
+    delta_e_fixture de = {0};
+    if (!delta_e_grid(&de, DE_GRID)) {
+        fprintf(stderr, "[FATAL] Out of memory\n");
+        i1d3_emulator_destroy(emu);
+        return 1;
+    }
+    static const struct { i1d3_delta_e_t metric; const char *name; } metrics[] = {
+        {I1D3_DE76, "delta_e76"},
+        {I1D3_DE94, "delta_e94"},
+        {I1D3_DE2000, "delta_e2000"},
+        {I1D3_DE_ITP, "delta_itp"},
+    };
+    int grid = de.n;
+    for (size_t i = 0; i < sizeof(metrics) / sizeof(metrics[0]); i++) {
+        de.metric = metrics[i].metric;
+        de.threads = 1;
+        de.n = DE_CHUNK;
+        run_bench(metrics[i].name, bench_delta_e, &de);
+    }
+    de.metric = I1D3_DE2000;
+    de.threads = 0;
+    de.n = grid;
+    run_bench("delta_e2000_grid_103823", bench_delta_e, &de);
+    free(de.ref);
+    free(de.meas);
+    free(de.out);
+
+    i1d3_emulator_destroy(emu);
+    return 0;
+}
@@ -0,0 +1,225 @@
+/* Colour difference metrics (dE76, dE94, CIEDE2000, dICtCp) over batches of XYZ pairs */
+#define _DEFAULT_SOURCE // sysconf() under -std=c99
+#include "i1d3.h"
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define I1D3_DE_BLOCK 256              // Pairs converted together before scoring (fits in L1)
+#define I1D3_DE_MIN_PER_THREAD 4096    // Fewer pairs per thread do not pay for the thread
+#define I1D3_DE_MAX_THREADS 64
+#define I1D3_LAB_KNEE 0.008856         // Same Lab as i1d3_xyz_to_color()
+#define I1D3_LAB_SLOPE 7.787
+#define I1D3_LAB_OFFSET (16.0 / 116.0)
+#define I1D3_POW25_7 6103515625.0      // 25^7 of the CIEDE2000 chroma terms
+#define I1D3_PQ_M1 0.1593017578125     // SMPTE ST 2084 inverse EOTF
+#define I1D3_PQ_M2 78.84375
+#define I1D3_PQ_C1 0.8359375
+#define I1D3_PQ_C2 18.8515625
+#define I1D3_PQ_C3 18.6875
+#define I1D3_PQ_PEAK 10000.0           // cd/m2 at PQ code value 1
+
+static const double I1D3_D50[3] = {96.42, 100.0, 82.49};
+
+// XYZ -> LMS of ICtCp (BT.2100 RGB -> LMS applied to XYZ -> BT.2020 RGB)
+static const double I1D3_XYZ_TO_LMS[3][3] = {
+    {0.359283, 0.697605, -0.035892},
+    {-0.192081, 1.100477, 0.075375},
+    {0.007080, 0.074840, 0.843327},
+};
+
+typedef struct {
+    i1d3_delta_e_t metric;
+    const double *ref, *meas;  // Packed XYZ triples
+    const double *white;
+    double *out;
+    int begin, end;
+} i1d3_de_job;
+
+// --- Colour spaces (one sample, three output columns) ---
+
+static double i1d3_de_lab_f(double t) {
+    return t > I1D3_LAB_KNEE ? cbrt(t) : I1D3_LAB_SLOPE * t + I1D3_LAB_OFFSET;
+}
+
+static void i1d3_de_lab(const double xyz[3], const double white[3], double *L, double *a, double *b) {
+    double fx = i1d3_de_lab_f(xyz[0] / white[0]);
+    double fy = i1d3_de_lab_f(xyz[1] / white[1]);
+    double fz = i1d3_de_lab_f(xyz[2] / white[2]);
+    *L = 116.0 * fy - 16.0;
+    *a = 500.0 * (fx - fy);
+    *b = 200.0 * (fy - fz);
+}
+
+static double i1d3_de_pq(double cd) {
+    double y = cd / I1D3_PQ_PEAK;
+    if (!(y > 0)) return 0.0;
+    double p = pow(y, I1D3_PQ_M1);
+    return pow((I1D3_PQ_C1 + I1D3_PQ_C2 * p) / (1.0 + I1D3_PQ_C3 * p), I1D3_PQ_M2);
+}
+
+// I, T = Ct / 2 and P = Cp, the scaled coordinates of BT.2124
+static void i1d3_de_itp(const double xyz[3], double *I, double *T, double *P) {
+    double lms[3];
+    for (int i = 0; i < 3; i++) {
+        lms[i] = i1d3_de_pq(I1D3_XYZ_TO_LMS[i][0] * xyz[0] + I1D3_XYZ_TO_LMS[i][1] * xyz[1] + I1D3_XYZ_TO_LMS[i][2] * xyz[2]);
+    }
+    *I = 0.5 * lms[0] + 0.5 * lms[1];
+    *T = 0.5 * (6610.0 * lms[0] - 13613.0 * lms[1] + 7003.0 * lms[2]) / 4096.0;
+    *P = (17933.0 * lms[0] - 17390.0 * lms[1] - 543.0 * lms[2]) / 4096.0;
+}
+
+// --- Metrics on converted pairs ---
+
+static double i1d3_de94(double L1, double a1, double b1, double L2, double a2, double b2) {
+    double C1 = sqrt(a1 * a1 + b1 * b1), C2 = sqrt(a2 * a2 + b2 * b2);
+    double dL = L2 - L1, dC = C2 - C1, da = a2 - a1, db = b2 - b1;
+    double dH2 = da * da + db * db - dC * dC;
+    if (dH2 < 0) dH2 = 0;
+    double SC = 1.0 + 0.045 * C1, SH = 1.0 + 0.015 * C1;
+    return sqrt(dL * dL + (dC / SC) * (dC / SC) + dH2 / (SH * SH));
+}
+
+// CIEDE2000 with kL = kC = kH = 1 (Sharma, Wu, Dalal 2005). The hue terms come from
+// dot and cross products and multiple-angle identities instead of per-term trig.
+static double i1d3_de2000(double L1, double a1, double b1, double L2, double a2, double b2) {
+    double Cm = 0.5 * (sqrt(a1 * a1 + b1 * b1) + sqrt(a2 * a2 + b2 * b2));
+    double Cm7 = Cm * Cm * Cm; Cm7 = Cm7 * Cm7 * Cm;
+    double G = 0.5 * (1.0 - sqrt(Cm7 / (Cm7 + I1D3_POW25_7)));
+    double ap1 = (1.0 + G) * a1, ap2 = (1.0 + G) * a2;
+    double Cp1 = sqrt(ap1 * ap1 + b1 * b1), Cp2 = sqrt(ap2 * ap2 + b2 * b2);
+
+    // dH' = 2 sqrt(C1'C2') sin(dh'/2): its square is 2 (C1'C2' - a1'a2' - b1 b2), its sign that of dh'
+    double dot = ap1 * ap2 + b1 * b2, cross = ap1 * b2 - ap2 * b1;
+    double dH2 = 2.0 * (Cp1 * Cp2 - dot);
+    double dL = L2 - L1, dC = Cp2 - Cp1, dH = copysign(sqrt(dH2 > 0 ? dH2 : 0), cross);
+
+    // Mean hue: the bisector of the shorter arc, or the hue of the chromatic sample
+    double c, s;
+    if (Cp1 * Cp2 == 0) {
+        double x = ap1 + ap2, y = b1 + b2, r = sqrt(x * x + y * y); // One of them is zero
+        c = r > 0 ? x / r : 1.0;
+        s = r > 0 ? y / r : 0.0;
+    } else {
+        double x = ap1 / Cp1 + ap2 / Cp2, y = b1 / Cp1 + b2 / Cp2, r = sqrt(x * x + y * y);
+        if (r > 1e-12) {
+            c = x / r;
+            s = y / r;
+        } else { // Opposite hues: the standard averages the two angles without wrapping
+            double h = 0.5 * (atan2(b1, ap1) + atan2(b2, ap2));
+            h += (atan2(b1, ap1) < 0) ? M_PI : 0;
+            h += (atan2(b2, ap2) < 0) ? M_PI : 0;
+            c = cos(h);
+            s = sin(h);
+        }
+    }
+    double hm = atan2(s, c) * (180.0 / M_PI);
+    if (hm < 0) hm += 360.0;
+
+    double c2 = c * c - s * s, s2 = 2.0 * s * c;
+    double c3 = c * (4.0 * c * c - 3.0), s3 = s * (3.0 - 4.0 * s * s);
+    double c4 = c2 * c2 - s2 * s2, s4 = 2.0 * s2 * c2;
+    double T = 1.0 - 0.17 * (c * 0.8660254037844386 + s * 0.5)              // cos(h - 30)
+                   + 0.24 * c2                                              // cos(2h)
+                   + 0.32 * (c3 * 0.9945218953682733 - s3 * 0.10452846326765347)  // cos(3h + 6)
+                   - 0.20 * (c4 * 0.45399049973954675 + s4 * 0.8910065241883679); // cos(4h - 63)
+
+    double Lm = 0.5 * (L1 + L2) - 50.0, Cpm = 0.5 * (Cp1 + Cp2);
+    double Cpm7 = Cpm * Cpm * Cpm; Cpm7 = Cpm7 * Cpm7 * Cpm;
+    double SL = 1.0 + 0.015 * Lm * Lm / sqrt(20.0 + Lm * Lm);
+    double SC = 1.0 + 0.045 * Cpm, SH = 1.0 + 0.015 * Cpm * T;
+    double dtheta = (M_PI / 6.0) * exp(-((hm - 275.0) / 25.0) * ((hm - 275.0) / 25.0));
+    double RT = -sin(2.0 * dtheta) * 2.0 * sqrt(Cpm7 / (Cpm7 + I1D3_POW25_7));
+
+    double tL = dL / SL, tC = dC / SC, tH = dH / SH;
+    return sqrt(tL * tL + tC * tC + tH * tH + RT * tC * tH);
+}
+
+// --- Batch ---
+
+static void i1d3_de_run(const i1d3_de_job *job) {
+    double p[2][3][I1D3_DE_BLOCK]; // Converted ref / meas, one column per coordinate
+
+    for (int base = job->begin; base < job->end; base += I1D3_DE_BLOCK) {
+        int n = job->end - base < I1D3_DE_BLOCK ? job->end - base : I1D3_DE_BLOCK;
+        for (int side = 0; side < 2; side++) {
+            const double *xyz = (side ? job->meas : job->ref) + 3 * (long)base;
+            for (int i = 0; i < n; i++) {
+                if (job->metric == I1D3_DE_ITP) {
+                    i1d3_de_itp(&xyz[3 * i], &p[side][0][i], &p[side][1][i], &p[side][2][i]);
+                } else {
+                    i1d3_de_lab(&xyz[3 * i], job->white, &p[side][0][i], &p[side][1][i], &p[side][2][i]);
+                }
+            }
+        }
+
+        double *out = job->out + base;
+        switch (job->metric) {
+        case I1D3_DE76:
+        case I1D3_DE_ITP:
+            for (int i = 0; i < n; i++) {
+                double d0 = p[1][0][i] - p[0][0][i], d1 = p[1][1][i] - p[0][1][i], d2 = p[1][2][i] - p[0][2][i];
+                out[i] = sqrt(d0 * d0 + d1 * d1 + d2 * d2);
+            }
+            if (job->metric == I1D3_DE_ITP) {
+                for (int i = 0; i < n; i++) out[i] *= 720.0;
+            }
+            break;
+        case I1D3_DE94:
+            for (int i = 0; i < n; i++) out[i] = i1d3_de94(p[0][0][i], p[0][1][i], p[0][2][i], p[1][0][i], p[1][1][i], p[1][2][i]);
+            break;
+        case I1D3_DE2000:
+            for (int i = 0; i < n; i++) out[i] = i1d3_de2000(p[0][0][i], p[0][1][i], p[0][2][i], p[1][0][i], p[1][1][i], p[1][2][i]);
+            break;
+        }
+    }
+}
+
+static void *i1d3_de_worker(void *arg) {
+    i1d3_de_run(arg);
+    return NULL;
+}
+
+static bool i1d3_de_valid(i1d3_delta_e_t metric, const double *white) {
+    if (metric < I1D3_DE76 || metric > I1D3_DE_ITP) return false;
+    return !white || (white[0] > 0 && white[1] > 0 && white[2] > 0);
+}
+
+i1d3_error_t i1d3_delta_e(i1d3_delta_e_t metric, const double ref[3], const double meas[3], const double white[3], double *de) {
+    if (!ref || !meas || !de || !i1d3_de_valid(metric, white)) return I1D3_ERROR_INVALID_PARAMETER;
+    i1d3_de_job job = {metric, ref, meas, white ? white : I1D3_D50, de, 0, 1};
+    i1d3_de_run(&job);
+    return I1D3_SUCCESS;
+}
+
+i1d3_error_t i1d3_delta_e_batch(i1d3_delta_e_t metric, const double *ref, const double *meas, int n,
+                                const i1d3_delta_e_opts *opts, double *out) {
+    const double *white = opts ? opts->white : NULL;
+    if (!ref || !meas || !out || n < 0 || !i1d3_de_valid(metric, white)) return I1D3_ERROR_INVALID_PARAMETER;
+
+    long threads = (opts && opts->threads > 0) ? opts->threads : sysconf(_SC_NPROCESSORS_ONLN);
+    long useful = n / I1D3_DE_MIN_PER_THREAD;
+    if (threads > useful) threads = useful;
+    if (threads > I1D3_DE_MAX_THREADS) threads = I1D3_DE_MAX_THREADS;
+    if (threads < 1) threads = 1;
+
+    // Contiguous slices; the calling thread takes the first one
+    i1d3_de_job jobs[I1D3_DE_MAX_THREADS];
+    pthread_t tids[I1D3_DE_MAX_THREADS];
+    bool started[I1D3_DE_MAX_THREADS] = {false};
+    for (int t = 0; t < threads; t++) {
+        i1d3_de_job job = {metric, ref, meas, white ? white : I1D3_D50, out,
+                           (int)((long)n * t / threads), (int)((long)n * (t + 1) / threads)};
+        jobs[t] = job;
+    }
+    for (int t = 1; t < threads; t++) started[t] = pthread_create(&tids[t], NULL, i1d3_de_worker, &jobs[t]) == 0;
+    i1d3_de_run(&jobs[0]);
+    for (int t = 1; t < threads; t++) {
+        if (started[t]) {
+            pthread_join(tids[t], NULL);
+        } else {
+            i1d3_de_run(&jobs[t]); // No thread available: do the slice here
+        }
+    }
+    return I1D3_SUCCESS;
+}
@@ -0,0 +1,122 @@
+/* Reference checks for the colour difference engine. Exit status 1 on any mismatch. */
+#include <stdio.h>
+#include <math.h>
+#include "i1d3.h"
+
+#define CHECK_TOLERANCE 5e-5 // Reference values are published to 4 decimals
+
+static const double d50[3] = {96.42, 100.0, 82.49};
+
+// CIEDE2000 test data of Sharma, Wu and Dalal (2005), Table 1: L1 a1 b1 L2 a2 b2 dE00
+static const double sharma[][7] = {
+    {50.0000, 2.6772, -79.7751, 50.0000, 0.0000, -82.7485, 2.0425},
+    {50.0000, 3.1571, -77.2803, 50.0000, 0.0000, -82.7485, 2.8615},
+    {50.0000, 2.8361, -74.0200, 50.0000, 0.0000, -82.7485, 3.4412},
+    {50.0000, -1.3802, -84.2814, 50.0000, 0.0000, -82.7485, 1.0000},
+    {50.0000, -1.1848, -84.8006, 50.0000, 0.0000, -82.7485, 1.0000},
+    {50.0000, -0.9009, -85.5211, 50.0000, 0.0000, -82.7485, 1.0000},
+    {50.0000, 0.0000, 0.0000, 50.0000, -1.0000, 2.0000, 2.3669},
+    {50.0000, -1.0000, 2.0000, 50.0000, 0.0000, 0.0000, 2.3669},
+    {50.0000, 2.4900, -0.0010, 50.0000, -2.4900, 0.0009, 7.1792},
+    {50.0000, 2.4900, -0.0010, 50.0000, -2.4900, 0.0010, 7.1792},
+    {50.0000, 2.4900, -0.0010, 50.0000, -2.4900, 0.0011, 7.2195},
+    {50.0000, 2.4900, -0.0010, 50.0000, -2.4900, 0.0012, 7.2195},
+    {50.0000, -0.0010, 2.4900, 50.0000, 0.0009, -2.4900, 4.8045},
+    {50.0000, -0.0010, 2.4900, 50.0000, 0.0010, -2.4900, 4.8045},
+    {50.0000, -0.0010, 2.4900, 50.0000, 0.0011, -2.4900, 4.7461},
+    {50.0000, 2.5000, 0.0000, 50.0000, 0.0000, -2.5000, 4.3065},
+    {50.0000, 2.5000, 0.0000, 73.0000, 25.0000, -18.0000, 27.1492},
+    {50.0000, 2.5000, 0.0000, 61.0000, -5.0000, 29.0000, 22.8977},
+    {50.0000, 2.5000, 0.0000, 56.0000, -27.0000, -3.0000, 31.9030},
+    {50.0000, 2.5000, 0.0000, 58.0000, 24.0000, 15.0000, 19.4535},
+    {50.0000, 2.5000, 0.0000, 50.0000, 3.1736, 0.5854, 1.0000},
+    {50.0000, 2.5000, 0.0000, 50.0000, 3.2972, 0.0000, 1.0000},
+    {50.0000, 2.5000, 0.0000, 50.0000, 1.8634, 0.5757, 1.0000},
+    {50.0000, 2.5000, 0.0000, 50.0000, 3.2592, 0.3350, 1.0000},
+    {60.2574, -34.0099, 36.2677, 60.4626, -34.1751, 39.4387, 1.2644},
+    {63.0109, -31.0961, -5.8663, 62.8187, -29.7946, -4.0864, 1.2630},
+    {61.2901, 3.7196, -5.3901, 61.4292, 2.2480, -4.9620, 1.8731},
+    {35.0831, -44.1164, 3.7933, 35.0232, -40.0716, 1.5901, 1.8645},
+    {22.7233, 20.0904, -46.6940, 23.0331, 14.9730, -42.5619, 2.0373},
+    {36.4612, 47.8580, 18.3852, 36.2715, 50.5065, 21.2231, 1.4146},
+    {90.8027, -2.0831, 1.4410, 91.1528, -1.6435, 0.0447, 1.4441},
+    {90.9257, -0.5406, -0.9208, 88.6381, -0.8985, -0.7239, 1.5381},
+    {6.7747, -0.2908, -2.4247, 5.8714, -0.0985, -2.2286, 0.6377},
+    {2.0776, 0.0795, -1.1350, 0.9033, -0.0636, -0.5514, 0.9082},
+};
+#define SHARMA_PAIRS ((int)(sizeof(sharma) / sizeof(sharma[0])))
+
+// CIE 1994 (graphic arts, first sample as the standard), from the formula: L1 a1 b1 L2 a2 b2 dE94
+static const double de94_ref[][7] = {
+    {50.0000, 2.6772, -79.7751, 50.0000, 0.0000, -82.7485, 1.3950},
+    {60.2574, -34.0099, 36.2677, 60.4626, -34.1751, 39.4387, 1.3910},
+    {90.8027, -2.0831, 1.4410, 91.1528, -1.6435, 0.0447, 1.4195},
+};
+
+// BT.2124 delta ICtCp of absolute XYZ (cd/m2), from the BT.2100 definition: X1 Y1 Z1 X2 Y2 Z2 dEITP
+static const double itp_ref[][7] = {
+    {95.047, 100.0, 108.883, 96.0, 100.0, 105.0, 3.5120},
+    {19.0, 20.0, 21.0, 19.5, 20.0, 22.0, 3.3246},
+    {950.47, 1000.0, 1088.83, 960.0, 1010.0, 1080.0, 1.4690},
+};
+
+// Inverse of the driver's Lab (same knee as i1d3_xyz_to_color()), so the pairs go in as XYZ
+static void lab_to_xyz(const double lab[3], double xyz[3]) {
+    double f[3];
+    f[1] = (lab[0] + 16.0) / 116.0;
+    f[0] = f[1] + lab[1] / 500.0;
+    f[2] = f[1] - lab[2] / 200.0;
+    for (int i = 0; i < 3; i++) {
+        double t = f[i] > cbrt(0.008856) ? f[i] * f[i] * f[i] : (f[i] - 16.0 / 116.0) / 7.787;
+        xyz[i] = t * d50[i];
+    }
+}
+
+static int failures = 0;
+
+static void expect(const char *what, int pair, double got, double want) {
+    if (!(fabs(got - want) <= CHECK_TOLERANCE)) {
+        printf("FAIL %s pair %d: got %.6f, expected %.4f\n", what, pair + 1, got, want);
+        failures++;
+    }
+}
+
+// One metric over a table, pair by pair and as one batch on every thread
+static void check_table(const char *what, i1d3_delta_e_t metric, const double (*table)[7], int n, int lab) {
+    double ref[3 * 64], meas[3 * 64], out[64];
+    for (int i = 0; i < n; i++) {
+        if (lab) {
+            lab_to_xyz(&table[i][0], &ref[3 * i]);
+            lab_to_xyz(&table[i][3], &meas[3 * i]);
+        } else {
+            for (int k = 0; k < 3; k++) {
+                ref[3 * i + k] = table[i][k];
+                meas[3 * i + k] = table[i][3 + k];
+            }
+        }
+        double de = NAN;
+        if (i1d3_delta_e(metric, &ref[3 * i], &meas[3 * i], NULL, &de) != I1D3_SUCCESS) de = NAN;
+        expect(what, i, de, table[i][6]);
+    }
+
+    i1d3_delta_e_opts opts = {NULL, 0};
+    if (i1d3_delta_e_batch(metric, ref, meas, n, &opts, out) != I1D3_SUCCESS) {
+        printf("FAIL %s batch\n", what);
+        failures++;
+        return;
+    }
+    for (int i = 0; i < n; i++) expect(what, i, out[i], table[i][6]);
+    printf("%s: %d pairs checked\n", what, n);
+}
+
+int main(void) {
+    check_table("CIEDE2000 (Sharma et al.)", I1D3_DE2000, sharma, SHARMA_PAIRS, 1);
+    check_table("dE94", I1D3_DE94, de94_ref, (int)(sizeof(de94_ref) / sizeof(de94_ref[0])), 1);
+    check_table("dICtCp", I1D3_DE_ITP, itp_ref, (int)(sizeof(itp_ref) / sizeof(itp_ref[0])), 0);
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All colour difference checks passed\n");
+    return 0;
+}
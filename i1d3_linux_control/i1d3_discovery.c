@@ -0,0 +1,303 @@
+/* Sensor discovery (sysfs) and hotplug monitoring (netlink uevents) */
+#define _GNU_SOURCE // struct ucred / SCM_CREDENTIALS, SOCK_CLOEXEC
+#include "i1d3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+
+#ifndef I1D3_SYSFS_HIDRAW
+#define I1D3_SYSFS_HIDRAW "/sys/class/hidraw"
+#endif
+
+#define I1D3_UEVENT_BUFFER 8192
+#define I1D3_UEVENT_KERNEL 1          // Netlink group of raw kernel uevents
+#define I1D3_UEVENT_UDEV 2            // Netlink group of uevents re-sent by udevd after its rules ran
+#define I1D3_UDEV_MAGIC 0xfeedcafeU   // libudev netlink header magic (network byte order on the wire)
+#define I1D3_RESYNC_MAX 64            // Sensors compared after a monitor buffer overflow
+
+// --- Discovery ---
+
+// Fill info from /sys/class/hidraw/<name>/device/uevent; false if it is not an i1Display3
+static bool i1d3_read_sysfs_info(const char *name, i1d3_device_info *info) {
+    char path[320], line[256];
+    unsigned bus, vendor = 0, product = 0;
+    bool have_id = false;
+
+    if (strncmp(name, "hidraw", 6) != 0 || strlen(name) >= 32) return false;
+    snprintf(path, sizeof(path), "%s/%s/device/uevent", I1D3_SYSFS_HIDRAW, name);
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+
+    memset(info, 0, sizeof(*info));
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (sscanf(line, "HID_ID=%x:%x:%x", &bus, &vendor, &product) == 3) {
+            have_id = true;
+        } else if (strncmp(line, "HID_NAME=", 9) == 0) {
+            snprintf(info->name, sizeof(info->name), "%.127s", line + 9);
+        } else if (strncmp(line, "HID_UNIQ=", 9) == 0) {
+            snprintf(info->serial, sizeof(info->serial), "%.63s", line + 9);
+        }
+    }
+    fclose(f);
+
+    if (!have_id || vendor != I1D3_VENDOR_ID || product != I1D3_PRODUCT_ID) return false;
+    info->vendor_id = (uint16_t)vendor;
+    info->product_id = (uint16_t)product;
+    snprintf(info->path, sizeof(info->path), "/dev/%.32s", name);
+    return true;
+}
+
+// Order by hidraw index so "hidraw10" follows "hidraw9"
+static int i1d3_compare_info(const void *a, const void *b) {
+    int ia = atoi(((const i1d3_device_info *)a)->path + strlen("/dev/hidraw"));
+    int ib = atoi(((const i1d3_device_info *)b)->path + strlen("/dev/hidraw"));
+    return (ia > ib) - (ia < ib);
+}
+
+int i1d3_discover(i1d3_device_info *list, int max) {
+    if (max < 0 || (max > 0 && !list)) return I1D3_ERROR_INVALID_PARAMETER;
+
+    DIR *dir = opendir(I1D3_SYSFS_HIDRAW);
+    if (!dir) return errno == ENOENT ? 0 : I1D3_ERROR_OPEN_FAILED; // No hidraw driver, no sensors
+
+    int count = 0;
+    struct dirent *entry;
+    i1d3_device_info info;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!i1d3_read_sysfs_info(entry->d_name, &info)) continue;
+        if (count < max) list[count] = info;
+        count++;
+    }
+    closedir(dir);
+
+    if (max > 0) qsort(list, count < max ? count : max, sizeof(*list), i1d3_compare_info);
+    return count;
+}
+
+// --- Hotplug monitor ---
+
+struct i1d3_monitor {
+    int fd;           // NETLINK_KOBJECT_UEVENT socket, kernel + udev groups
+    char (*known)[64]; // Paths of sensors reported as present
+    int known_count;
+    int known_capacity;
+    bool resync;      // Events were lost; diff sysfs against known before reading more
+};
+
+static int i1d3_known_index(const i1d3_monitor *mon, const char *path) {
+    for (int i = 0; i < mon->known_count; i++) {
+        if (strcmp(mon->known[i], path) == 0) return i;
+    }
+    return -1;
+}
+
+static bool i1d3_known_add(i1d3_monitor *mon, const char *path) {
+    if (mon->known_count == mon->known_capacity) {
+        int capacity = mon->known_capacity ? mon->known_capacity * 2 : 8;
+        char (*grown)[64] = realloc(mon->known, capacity * sizeof(*grown));
+        if (!grown) return false;
+        mon->known = grown;
+        mon->known_capacity = capacity;
+    }
+    snprintf(mon->known[mon->known_count++], sizeof(mon->known[0]), "%s", path);
+    return true;
+}
+
+static void i1d3_known_remove(i1d3_monitor *mon, int index) {
+    memmove(mon->known[index], mon->known[index + 1], (mon->known_count - index - 1) * sizeof(mon->known[0]));
+    mon->known_count--;
+}
+
+i1d3_monitor *i1d3_monitor_create(i1d3_error_t *error) {
+    i1d3_error_t result = I1D3_SUCCESS;
+    i1d3_monitor *mon = calloc(1, sizeof(*mon));
+    if (!mon) {
+        result = I1D3_ERROR_OPEN_FAILED;
+        goto out;
+    }
+
+    mon->fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    struct sockaddr_nl addr = {0};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = I1D3_UEVENT_KERNEL | I1D3_UEVENT_UDEV;
+    int on = 1;
+    if (mon->fd < 0 || bind(mon->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        setsockopt(mon->fd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on)) < 0) {
+        result = (errno == EACCES || errno == EPERM) ? I1D3_ERROR_PERMISSION_DENIED : I1D3_ERROR_OPEN_FAILED;
+        goto out;
+    }
+
+    // Sensors already connected count as known, so their removal is reported
+    i1d3_device_info present[I1D3_RESYNC_MAX];
+    int n = i1d3_discover(present, I1D3_RESYNC_MAX);
+    for (int i = 0; i < n && i < I1D3_RESYNC_MAX; i++) {
+        if (!i1d3_known_add(mon, present[i].path)) {
+            result = I1D3_ERROR_OPEN_FAILED;
+            goto out;
+        }
+    }
+
+out:
+    if (result != I1D3_SUCCESS && mon) {
+        i1d3_monitor_destroy(mon);
+        mon = NULL;
+    }
+    if (error) *error = result;
+    return mon;
+}
+
+void i1d3_monitor_destroy(i1d3_monitor *mon) {
+    if (!mon) return;
+    if (mon->fd >= 0) close(mon->fd);
+    free(mon->known);
+    free(mon);
+}
+
+int i1d3_monitor_fd(const i1d3_monitor *mon) {
+    return mon ? mon->fd : I1D3_ERROR_INVALID_PARAMETER;
+}
+
+// One step of resynchronization after lost events: report the first difference
+// between sysfs and the known set. Returns 1 with an event, 0 when in sync.
+static int i1d3_monitor_resync(i1d3_monitor *mon, i1d3_hotplug_event *event) {
+    i1d3_device_info present[I1D3_RESYNC_MAX];
+    int n = i1d3_discover(present, I1D3_RESYNC_MAX);
+    if (n < 0) return n;
+    if (n > I1D3_RESYNC_MAX) n = I1D3_RESYNC_MAX;
+
+    for (int k = 0; k < mon->known_count; k++) {
+        int i = 0;
+        while (i < n && strcmp(present[i].path, mon->known[k]) != 0) i++;
+        if (i == n) {
+            memset(event, 0, sizeof(*event));
+            event->action = I1D3_HOTPLUG_REMOVE;
+            snprintf(event->info.path, sizeof(event->info.path), "%s", mon->known[k]);
+            i1d3_known_remove(mon, k);
+            return 1;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        if (i1d3_known_index(mon, present[i].path) >= 0) continue;
+        if (!i1d3_known_add(mon, present[i].path)) return I1D3_ERROR_OPEN_FAILED;
+        event->action = I1D3_HOTPLUG_ADD;
+        event->info = present[i];
+        return 1;
+    }
+    mon->resync = false;
+    return 0;
+}
+
+// Find KEY=value in a NUL-separated property block
+static const char *i1d3_uevent_get(const char *props, size_t len, const char *key) {
+    size_t key_len = strlen(key);
+    for (const char *p = props; p < props + len; p += strlen(p) + 1) {
+        if (strncmp(p, key, key_len) == 0 && p[key_len] == '=') return p + key_len + 1;
+    }
+    return NULL;
+}
+
+// Turn one uevent into a hotplug event. Returns true if it should be reported.
+static bool i1d3_monitor_handle(i1d3_monitor *mon, const char *props, size_t len, bool from_udev,
+                                i1d3_hotplug_event *event) {
+    const char *action = i1d3_uevent_get(props, len, "ACTION");
+    const char *subsystem = i1d3_uevent_get(props, len, "SUBSYSTEM");
+    const char *devname = i1d3_uevent_get(props, len, "DEVNAME");
+    if (!action || !subsystem || !devname || strcmp(subsystem, "hidraw") != 0) return false;
+
+    // The kernel sends "hidraw3", udev sends "/dev/hidraw3"
+    const char *name = strrchr(devname, '/') ? strrchr(devname, '/') + 1 : devname;
+    char path[64];
+    snprintf(path, sizeof(path), "/dev/%.32s", name);
+    int known = i1d3_known_index(mon, path);
+
+    if (strcmp(action, "add") == 0) {
+        if (known >= 0) return false; // Already reported by the other group
+        if (!i1d3_read_sysfs_info(name, &event->info)) return false;
+        // Wait for udev to apply the rules unless the node is already usable
+        if (!from_udev && access(path, R_OK | W_OK) != 0) return false;
+        if (!i1d3_known_add(mon, path)) return false;
+        event->action = I1D3_HOTPLUG_ADD;
+        return true;
+    }
+    if (strcmp(action, "remove") == 0) {
+        if (known < 0) return false;
+        i1d3_known_remove(mon, known);
+        memset(event, 0, sizeof(*event));
+        event->action = I1D3_HOTPLUG_REMOVE;
+        snprintf(event->info.path, sizeof(event->info.path), "%s", path);
+        return true;
+    }
+    return false;
+}
+
+int i1d3_monitor_read(i1d3_monitor *mon, i1d3_hotplug_event *event) {
+    if (!mon || !event) return I1D3_ERROR_INVALID_PARAMETER;
+
+    char buf[I1D3_UEVENT_BUFFER];
+    char control[CMSG_SPACE(sizeof(struct ucred))];
+    for (;;) {
+        if (mon->resync) {
+            int result = i1d3_monitor_resync(mon, event);
+            if (result != 0) return result;
+        }
+
+        struct sockaddr_nl sender;
+        struct iovec iov = {buf, sizeof(buf) - 1};
+        struct msghdr msg = {0};
+        msg.msg_name = &sender;
+        msg.msg_namelen = sizeof(sender);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t n = recvmsg(mon->fd, &msg, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            if (errno == ENOBUFS) { // Socket buffer overflowed, events were dropped
+                mon->resync = true;
+                continue;
+            }
+            return I1D3_ERROR_OPEN_FAILED;
+        }
+        buf[n] = '\0';
+
+        // Only trust the kernel (port 0) and root-owned udevd
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (!cmsg || cmsg->cmsg_type != SCM_CREDENTIALS) continue;
+        struct ucred cred;
+        memcpy(&cred, CMSG_DATA(cmsg), sizeof(cred));
+        if (cred.uid != 0) continue;
+
+        const char *props;
+        size_t len;
+        bool from_udev = sender.nl_groups == I1D3_UEVENT_UDEV;
+        if (from_udev) {
+            // libudev header: "libudev\0", magic, header size, properties offset, properties length
+            uint32_t header[4];
+            if (n < 8 + (ssize_t)sizeof(header) || strcmp(buf, "libudev") != 0) continue;
+            memcpy(header, buf + 8, sizeof(header));
+            uint32_t off = header[2], plen = header[3];
+            if (ntohl(header[0]) != I1D3_UDEV_MAGIC || off > (size_t)n || plen > (size_t)n - off) continue;
+            props = buf + off;
+            len = plen;
+        } else {
+            if (sender.nl_pid != 0) continue;
+            // "action@devpath\0KEY=value\0..."
+            size_t head = strlen(buf) + 1;
+            if (head >= (size_t)n) continue;
+            props = buf + head;
+            len = n - head;
+        }
+
+        if (i1d3_monitor_handle(mon, props, len, from_udev, event)) return 1;
+    }
+}
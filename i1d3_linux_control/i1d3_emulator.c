@@ -0,0 +1,408 @@
+/* Software i1Display3: protocol emulator and its socketpair / in-process transports */
+#define _DEFAULT_SOURCE // timerfd and pthreads under -std=c99
+#include "i1d3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#define I1D3_EMU_CLOCK_FREQ 12000000.0   // Integration clock of the measure command (Hz)
+#define I1D3_EMU_COUNT_CLOCK 48000000.0  // Reference clock reported with the counts (Hz)
+#define I1D3_EMU_LATENCY_DEFAULT 1000    // One USB full-speed frame per reply (us)
+#define I1D3_EMU_QUEUE 8                 // Replies the in-process transport can hold
+
+struct i1d3_emulator {
+    pthread_mutex_t lock;    // Guards everything below
+    i1d3_emulator_config cfg;
+    char serial[32];
+    double inverse[3][3];    // XYZ -> sensor frequency (inverse of the correction matrix times the response)
+    uint64_t rng;            // xorshift64 state
+    uint8_t challenge[64];   // Last 0x99 reply
+    bool challenged;
+    bool unlocked;
+};
+
+static int64_t i1d3_emu_now_us(void) {
+    return i1d3_clock_now_us();
+}
+
+// --- Deterministic random source (seeded, independent of libc) ---
+
+static uint64_t i1d3_emu_next(i1d3_emulator *emu) {
+    uint64_t x = emu->rng;
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+    return emu->rng = x;
+}
+
+static double i1d3_emu_uniform(i1d3_emulator *emu) {
+    return ((i1d3_emu_next(emu) >> 11) + 0.5) / 9007199254740992.0; // (0, 1)
+}
+
+static double i1d3_emu_gauss(i1d3_emulator *emu) {
+    // Box-Muller
+    double u1 = i1d3_emu_uniform(emu), u2 = i1d3_emu_uniform(emu);
+    return sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+}
+
+// --- Emulator core ---
+
+void i1d3_emulator_default_config(i1d3_emulator_config *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->X = 95.047; cfg->Y = 100.0; cfg->Z = 108.883; // D65 white at 100 cd/m2
+    for (int i = 0; i < 3; i++) cfg->response[i][i] = 1.0;
+    cfg->latency_us = I1D3_EMU_LATENCY_DEFAULT;
+    cfg->key[0] = 0xe9622e9f; cfg->key[1] = 0x8d63e133; // Retail
+    cfg->seed = 1;
+}
+
+static bool i1d3_emu_invert(const double m[3][3], double inv[3][3]) {
+    double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+               - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+               + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    if (fabs(det) < 1e-15) return false;
+
+    inv[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) / det;
+    inv[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) / det;
+    inv[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) / det;
+    inv[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) / det;
+    inv[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) / det;
+    inv[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) / det;
+    inv[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) / det;
+    inv[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) / det;
+    inv[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) / det;
+    return true;
+}
+
+i1d3_emulator *i1d3_emulator_create(const i1d3_emulator_config *cfg) {
+    i1d3_emulator *emu = calloc(1, sizeof(*emu));
+    if (!emu) return NULL;
+
+    if (cfg) {
+        emu->cfg = *cfg;
+    } else {
+        i1d3_emulator_default_config(&emu->cfg);
+    }
+    snprintf(emu->serial, sizeof(emu->serial), "%s", emu->cfg.serial ? emu->cfg.serial : "EMU00001");
+    emu->cfg.serial = emu->serial;
+
+    // An ideal unit responds like the one the built-in matrix was made for;
+    // the configured response models the spectral mismatch of a real one
+    double matrix[3][3], inverse[3][3];
+    i1d3_get_default_matrix(matrix);
+    if (!i1d3_emu_invert((const double (*)[3])matrix, inverse)) {
+        free(emu);
+        return NULL;
+    }
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            emu->inverse[i][j] = inverse[i][0] * emu->cfg.response[0][j]
+                               + inverse[i][1] * emu->cfg.response[1][j]
+                               + inverse[i][2] * emu->cfg.response[2][j];
+        }
+    }
+
+    emu->rng = emu->cfg.seed ? emu->cfg.seed : 1;
+    pthread_mutex_init(&emu->lock, NULL);
+    return emu;
+}
+
+void i1d3_emulator_destroy(i1d3_emulator *emu) {
+    if (!emu) return;
+    pthread_mutex_destroy(&emu->lock);
+    free(emu);
+}
+
+void i1d3_emulator_set_xyz(i1d3_emulator *emu, double X, double Y, double Z) {
+    if (!emu) return;
+    pthread_mutex_lock(&emu->lock);
+    emu->cfg.X = X; emu->cfg.Y = Y; emu->cfg.Z = Z;
+    pthread_mutex_unlock(&emu->lock);
+}
+
+// Fill reply bytes 2.. with an ASCII string (info commands)
+static void i1d3_emu_text(uint8_t *reply, const char *text) {
+    strncpy((char *)reply + 2, text, 62);
+}
+
+static void i1d3_emu_measure(i1d3_emulator *emu, const uint8_t *cmd, uint8_t *reply, int64_t *delay_us) {
+    uint32_t clks = cmd[1] | (cmd[2] << 8) | (cmd[3] << 16) | ((uint32_t)cmd[4] << 24);
+    double seconds = clks / I1D3_EMU_CLOCK_FREQ;
+    double xyz[3] = {emu->cfg.X, emu->cfg.Y, emu->cfg.Z};
+
+    if (emu->cfg.panel) emu->cfg.panel(emu->cfg.panel_user, xyz);
+
+    reply[1] = 0x04;
+    uint32_t clk = (uint32_t)(seconds * I1D3_EMU_COUNT_CLOCK + 0.5);
+    for (int c = 0; c < 3; c++) {
+        double hz = emu->inverse[c][0] * xyz[0] + emu->inverse[c][1] * xyz[1] + emu->inverse[c][2] * xyz[2];
+        if (emu->cfg.noise > 0) hz *= 1.0 + emu->cfg.noise * i1d3_emu_gauss(emu);
+        if (hz < 0) hz = 0;
+
+        // Edges counted over the window, plus the leading edge toHz() discards
+        double edges = floor(hz * 4.0 * seconds + 0.5) + 1.0;
+        uint32_t cnt = (edges > 4294967295.0) ? 0xFFFFFFFFu : (uint32_t)edges;
+        memcpy(&reply[2 + 4 * c], &cnt, 4);
+        memcpy(&reply[14 + 4 * c], &clk, 4);
+    }
+    *delay_us += (int64_t)(seconds * 1000000.0);
+}
+
+int i1d3_emulator_process(i1d3_emulator *emu, const uint8_t cmd[64], uint8_t reply[64], int64_t *delay_us) {
+    if (!emu || !cmd || !reply || !delay_us) return I1D3_ERROR_INVALID_PARAMETER;
+
+    pthread_mutex_lock(&emu->lock);
+    memset(reply, 0, 64);
+    reply[0] = 0x00;
+    reply[1] = cmd[1];
+    *delay_us = emu->cfg.latency_us;
+
+    switch (cmd[0]) {
+        case 0x99: // Get challenge
+            reply[1] = 0x99;
+            reply[2] = (uint8_t)i1d3_emu_next(emu);
+            reply[3] = (uint8_t)i1d3_emu_next(emu);
+            for (int i = 0; i < 8; i++) reply[35 + i] = (uint8_t)i1d3_emu_next(emu);
+            memcpy(emu->challenge, reply, 64);
+            emu->challenged = true;
+            break;
+
+        case 0x9A: { // Response: 0x77 unlocks
+            uint8_t expected[64];
+            bool ok = false;
+            if (emu->challenged) {
+                i1d3_unlock_response(emu->cfg.key, emu->challenge, expected);
+                ok = memcmp(&cmd[24], &expected[24], 16) == 0;
+            }
+            emu->challenged = false;
+            emu->unlocked = emu->unlocked || ok;
+            reply[1] = 0x9A;
+            reply[2] = ok ? 0x77 : 0x00;
+            break;
+        }
+
+        case 0x04: // Measure (locked units do not answer with a measurement)
+            if (emu->unlocked) {
+                i1d3_emu_measure(emu, cmd, reply, delay_us);
+            } else {
+                reply[1] = 0x00;
+            }
+            break;
+
+        case 0x00:
+            switch (cmd[1]) {
+                case 0x10: i1d3_emu_text(reply, "i1Display3 "); break;
+                case 0x11: i1d3_emu_text(reply, "Emulated"); break;
+                case 0x12: i1d3_emu_text(reply, "v2.28"); break;
+                case 0x13: i1d3_emu_text(reply, "01Jan2020"); break;
+                case 0x20: reply[2] = emu->unlocked ? 0x00 : 0x01; break;
+                default: break; // Status / undocumented: all zero
+            }
+            break;
+
+        case 0x10: // Serial number
+            i1d3_emu_text(reply, emu->serial);
+            break;
+
+        default:
+            break;
+    }
+    pthread_mutex_unlock(&emu->lock);
+    return 1;
+}
+
+// --- socketpair transport: the emulator answers from its own thread ---
+
+typedef struct {
+    i1d3_emulator *emu;
+    int fd;          // Driver side
+    int peer;        // Emulator side
+    pthread_t thread;
+} i1d3_emu_socket;
+
+static void i1d3_emu_sleep_us(int64_t us) {
+    if (us > 0) i1d3_clock_sleep_until_us(i1d3_emu_now_us() + us);
+}
+
+static void *i1d3_emu_serve(void *arg) {
+    i1d3_emu_socket *sock = arg;
+    uint8_t cmd[64], reply[64];
+    int64_t delay_us;
+
+    // One report per datagram; a closed driver side ends the thread
+    while (read(sock->peer, cmd, sizeof(cmd)) == (ssize_t)sizeof(cmd)) {
+        if (i1d3_emulator_process(sock->emu, cmd, reply, &delay_us) != 1) continue;
+        i1d3_emu_sleep_us(delay_us);
+        if (write(sock->peer, reply, sizeof(reply)) != (ssize_t)sizeof(reply)) break;
+    }
+    return NULL;
+}
+
+static int i1d3_emu_socket_send(void *ctx, const uint8_t *buf, int len) {
+    return (int)write(((i1d3_emu_socket *)ctx)->fd, buf, len);
+}
+
+static int i1d3_emu_socket_recv(void *ctx, uint8_t *buf, int maxlen) {
+    return (int)read(((i1d3_emu_socket *)ctx)->fd, buf, maxlen);
+}
+
+static int i1d3_emu_socket_close(void *ctx) {
+    i1d3_emu_socket *sock = ctx;
+    shutdown(sock->fd, SHUT_RDWR);
+    pthread_join(sock->thread, NULL);
+    int result = close(sock->fd);
+    close(sock->peer);
+    free(sock);
+    return result;
+}
+
+static const i1d3_transport_ops i1d3_emu_socket_transport = {
+    "socketpair", i1d3_emu_socket_send, i1d3_emu_socket_recv, i1d3_emu_socket_close
+};
+
+static i1d3_device *i1d3_emu_open_socket(i1d3_emulator *emu, i1d3_error_t *error) {
+    int sv[2];
+    i1d3_emu_socket *sock = calloc(1, sizeof(*sock));
+    if (!sock || socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) != 0) {
+        free(sock);
+        if (error) *error = I1D3_ERROR_OPEN_FAILED;
+        return NULL;
+    }
+    sock->emu = emu;
+    sock->fd = sv[0];
+    sock->peer = sv[1];
+    if (pthread_create(&sock->thread, NULL, i1d3_emu_serve, sock) != 0) {
+        close(sv[0]); close(sv[1]); free(sock);
+        if (error) *error = I1D3_ERROR_OPEN_FAILED;
+        return NULL;
+    }
+
+    i1d3_device *dev = i1d3_device_open_transport(&i1d3_emu_socket_transport, sock, sock->fd, emu->serial, error);
+    if (!dev) i1d3_emu_socket_close(sock);
+    return dev;
+}
+
+// --- In-process transport: replies computed on send, released by a timerfd ---
+// Under a clock other than the system clock the timer fires at once and recv()
+// sleeps on the driver clock until the reply is due instead.
+
+typedef struct {
+    i1d3_emulator *emu;
+    int timer_fd;                          // Readable once the head reply is due
+    uint8_t queue[I1D3_EMU_QUEUE][64];
+    int64_t due_us[I1D3_EMU_QUEUE];
+    int head, count;
+} i1d3_emu_inproc;
+
+// Arm the timer for the reply at the head of the queue (or disarm it)
+static void i1d3_emu_inproc_arm(i1d3_emu_inproc *ip) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (ip->count > 0) {
+        int64_t due = i1d3_clock_is_system() ? ip->due_us[ip->head] : 0;
+        its.it_value.tv_sec = (time_t)(due / 1000000);
+        its.it_value.tv_nsec = (long)(due % 1000000) * 1000;
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) its.it_value.tv_nsec = 1; // 0 would disarm
+    }
+    timerfd_settime(ip->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static int i1d3_emu_inproc_send(void *ctx, const uint8_t *buf, int len) {
+    i1d3_emu_inproc *ip = ctx;
+    uint8_t cmd[64] = {0};
+    int64_t delay_us;
+
+    if (ip->count == I1D3_EMU_QUEUE) {
+        errno = EAGAIN;
+        return -1;
+    }
+    memcpy(cmd, buf, len < 64 ? len : 64);
+    int slot = (ip->head + ip->count) % I1D3_EMU_QUEUE;
+    if (i1d3_emulator_process(ip->emu, cmd, ip->queue[slot], &delay_us) != 1) return len;
+
+    // Replies leave in order, so a reply is never due before the one ahead of it
+    int64_t due = i1d3_emu_now_us() + delay_us;
+    if (ip->count > 0) {
+        int64_t prev = ip->due_us[(slot + I1D3_EMU_QUEUE - 1) % I1D3_EMU_QUEUE];
+        if (due < prev) due = prev;
+    }
+    ip->due_us[slot] = due;
+    if (ip->count++ == 0) i1d3_emu_inproc_arm(ip);
+    return len;
+}
+
+static int i1d3_emu_inproc_recv(void *ctx, uint8_t *buf, int maxlen) {
+    i1d3_emu_inproc *ip = ctx;
+    uint64_t expirations;
+
+    if (read(ip->timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) return -1;
+    if (ip->count == 0 || (i1d3_clock_is_system() && ip->due_us[ip->head] > i1d3_emu_now_us())) {
+        i1d3_emu_inproc_arm(ip);
+        errno = EAGAIN;
+        return -1;
+    }
+    i1d3_clock_sleep_until_us(ip->due_us[ip->head]);
+
+    int len = maxlen < 64 ? maxlen : 64;
+    memcpy(buf, ip->queue[ip->head], len);
+    ip->head = (ip->head + 1) % I1D3_EMU_QUEUE;
+    ip->count--;
+    i1d3_emu_inproc_arm(ip);
+    return len;
+}
+
+static int i1d3_emu_inproc_close(void *ctx) {
+    i1d3_emu_inproc *ip = ctx;
+    int result = close(ip->timer_fd);
+    free(ip);
+    return result;
+}
+
+static const i1d3_transport_ops i1d3_emu_inproc_transport = {
+    "inproc", i1d3_emu_inproc_send, i1d3_emu_inproc_recv, i1d3_emu_inproc_close
+};
+
+static i1d3_device *i1d3_emu_open_inproc(i1d3_emulator *emu, i1d3_error_t *error) {
+    i1d3_emu_inproc *ip = calloc(1, sizeof(*ip));
+    if (!ip) {
+        if (error) *error = I1D3_ERROR_OPEN_FAILED;
+        return NULL;
+    }
+    ip->emu = emu;
+    ip->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (ip->timer_fd < 0) {
+        free(ip);
+        if (error) *error = I1D3_ERROR_OPEN_FAILED;
+        return NULL;
+    }
+
+    i1d3_device *dev = i1d3_device_open_transport(&i1d3_emu_inproc_transport, ip, ip->timer_fd, emu->serial, error);
+    if (!dev) i1d3_emu_inproc_close(ip);
+    return dev;
+}
+
+i1d3_device *i1d3_emulator_open(i1d3_emulator *emu, i1d3_transport_kind kind, i1d3_error_t *error) {
+    if (!emu) {
+        if (error) *error = I1D3_ERROR_INVALID_PARAMETER;
+        return NULL;
+    }
+
+    // Every connection starts locked, like a freshly plugged unit
+    pthread_mutex_lock(&emu->lock);
+    emu->unlocked = false;
+    emu->challenged = false;
+    pthread_mutex_unlock(&emu->lock);
+
+    switch (kind) {
+        case I1D3_TRANSPORT_SOCKETPAIR: return i1d3_emu_open_socket(emu, error);
+        case I1D3_TRANSPORT_INPROC: return i1d3_emu_open_inproc(emu, error);
+        default:
+            if (error) *error = I1D3_ERROR_INVALID_PARAMETER;
+            return NULL;
+    }
+}
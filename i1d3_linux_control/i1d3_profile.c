@@ -0,0 +1,312 @@
+/* i1d3_profile: fit sensor correction matrices (FCMM) for one or many i1d3 units */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "i1d3.h"
+
+#define MAX_SENSORS 16  // Reference plus targets in one capture
+#define MAX_SETS 256    // Sensors in one file
+
+// All samples of one sensor, in file or capture order
+typedef struct {
+    char id[64];
+    i1d3_fcmm_sample *samples;
+    int count, capacity;
+    double matrix[3][3];  // Raw frequency -> XYZ matrix the readings were taken with
+} sensor_set;
+
+static void usage(const char *prog) {
+    printf("Usage: %s [--offset] [--relative] FILE\n", prog);
+    printf("       %s [--offset] [--relative] [--save FILE] --capture N REF DEVICE...\n", prog);
+    printf("       %s [--offset] [--relative] [--save FILE] --capture N --emulate K\n", prog);
+    printf("  FILE        paired readings, one per line: id Xref Yref Zref X Y Z ('-' = stdin)\n");
+    printf("  --capture N measure N patches with the reference and every target at once\n");
+    printf("  --emulate K use K emulated targets with random spectral mismatch\n");
+    printf("  --save FILE also write the captured readings to FILE\n");
+    printf("  --offset    fit a 3x4 matrix (per-channel offset)\n");
+    printf("  --relative  weight patches by 1/Y^2 instead of absolute XYZ error\n");
+}
+
+static sensor_set *find_set(sensor_set *sets, int *count, const char *id) {
+    for (int i = 0; i < *count; i++) {
+        if (strcmp(sets[i].id, id) == 0) return &sets[i];
+    }
+    if (*count == MAX_SETS) return NULL;
+    sensor_set *set = &sets[(*count)++];
+    memset(set, 0, sizeof(*set));
+    snprintf(set->id, sizeof(set->id), "%s", id);
+    i1d3_get_default_matrix(set->matrix);
+    return set;
+}
+
+static bool add_sample(sensor_set *set, const double ref[3], const double meas[3]) {
+    if (set->count == set->capacity) {
+        int capacity = set->capacity ? set->capacity * 2 : 32;
+        i1d3_fcmm_sample *grown = realloc(set->samples, capacity * sizeof(*grown));
+        if (!grown) return false;
+        set->samples = grown;
+        set->capacity = capacity;
+    }
+    i1d3_fcmm_sample *s = &set->samples[set->count++];
+    memcpy(s->ref, ref, sizeof(s->ref));
+    memcpy(s->meas, meas, sizeof(s->meas));
+    return true;
+}
+
+static int load_file(const char *path, sensor_set *sets, int *count) {
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!f) {
+        printf("[FATAL] Cannot open %s\n", path);
+        return -1;
+    }
+    char line[512];
+    int lineno = 0, result = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char id[64];
+        double ref[3], meas[3];
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+        if (sscanf(p, "%63s %lf %lf %lf %lf %lf %lf", id, &ref[0], &ref[1], &ref[2], &meas[0], &meas[1], &meas[2]) != 7) {
+            printf("[FATAL] %s:%d: expected id and 6 numbers\n", path, lineno);
+            result = -1;
+            break;
+        }
+        sensor_set *set = find_set(sets, count, id);
+        if (!set || !add_sample(set, ref, meas)) {
+            printf("[FATAL] %s:%d: too many sensors or out of memory\n", path, lineno);
+            result = -1;
+            break;
+        }
+    }
+    if (f != stdin) fclose(f);
+    return result;
+}
+
+// --- Live capture ---
+
+// Patch set for emulated runs: primaries, secondaries, white, a grey ramp, then mixtures
+static void patch_xyz(int index, double xyz[3]) {
+    static const double SRGB[3][3] = { // Linear sRGB -> XYZ (D65), Y of white = 100
+        {41.24, 35.76, 18.05},
+        {21.26, 71.52, 7.22},
+        {1.93, 11.92, 95.05},
+    };
+    static const double FIXED[][3] = {
+        {1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0, 1, 1}, {1, 0, 1}, {1, 1, 0},
+        {1, 1, 1}, {0.5, 0.5, 0.5}, {0.2, 0.2, 0.2}, {0.05, 0.05, 0.05},
+    };
+    double rgb[3];
+    int fixed = (int)(sizeof(FIXED) / sizeof(FIXED[0]));
+    if (index < fixed) {
+        memcpy(rgb, FIXED[index], sizeof(rgb));
+    } else {
+        for (int c = 0; c < 3; c++) rgb[c] = 0.02 + ((index * (7 + 6 * c)) % 11) / 10.5;
+    }
+    for (int r = 0; r < 3; r++) xyz[r] = SRGB[r][0] * rgb[0] + SRGB[r][1] * rgb[1] + SRGB[r][2] * rgb[2];
+}
+
+typedef struct {
+    int patch;  // Patch all emulated sensors currently see
+} emulated_panel;
+
+static void emulated_panel_xyz(void *user, double xyz[3]) {
+    patch_xyz(((emulated_panel *)user)->patch, xyz);
+}
+
+static int open_sensor(i1d3_device **dev, const char *path, i1d3_emulator *emu) {
+    i1d3_error_t error = I1D3_SUCCESS;
+    *dev = emu ? i1d3_emulator_open(emu, I1D3_TRANSPORT_INPROC, &error) : i1d3_device_open(path, &error);
+    if (!*dev) {
+        printf("[FATAL] Failed to open %s: %s\n", emu ? "emulator" : path, i1d3_error_string(error));
+        return -1;
+    }
+    int fd = i1d3_device_fd(*dev);
+    if ((error = i1d3_init_sequence(fd)) != I1D3_SUCCESS || (error = i1d3_auto_find_unlock(fd)) != I1D3_SUCCESS) {
+        printf("[FATAL] %s did not initialize: %s\n", emu ? "emulator" : path, i1d3_error_string(error));
+        return -1;
+    }
+    return 0;
+}
+
+// Capture n patches; sensors[0] is the reference, every other sensor gets a set
+static int capture(int n, int emulated, const char **paths, int count, FILE *save, sensor_set *sets, int *set_count) {
+    i1d3_emulator *emus[MAX_SENSORS] = {NULL};
+    i1d3_device *devs[MAX_SENSORS] = {NULL};
+    sensor_set *targets[MAX_SENSORS] = {NULL};
+    emulated_panel panel = {0};
+    uint64_t rng = 0x9e3779b97f4a7c15ull;
+    int result = -1;
+
+    for (int i = 0; i < count; i++) {
+        if (emulated) {
+            i1d3_emulator_config cfg;
+            char serial[32];
+            i1d3_emulator_default_config(&cfg);
+            snprintf(serial, sizeof(serial), i ? "EMU%05d" : "EMUREF", i);
+            cfg.serial = serial;
+            cfg.panel = emulated_panel_xyz;
+            cfg.panel_user = &panel;
+            cfg.noise = 0.0005;
+            cfg.latency_us = 0;
+            cfg.seed = i + 1;
+            for (int r = 0; r < 3 && i > 0; r++) {
+                for (int c = 0; c < 3; c++) { // Up to +-3% crosstalk between channels
+                    rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+                    cfg.response[r][c] += ((rng >> 11) / 9007199254740992.0 - 0.5) * 0.06;
+                }
+            }
+            emus[i] = i1d3_emulator_create(&cfg);
+            if (!emus[i]) {
+                printf("[FATAL] Emulator setup failed\n");
+                goto done;
+            }
+        }
+        if (open_sensor(&devs[i], paths ? paths[i] : NULL, emus[i]) < 0) goto done;
+        if (i == 0) continue;
+        const char *serial = i1d3_get_serial(i1d3_device_fd(devs[i]));
+        targets[i] = find_set(sets, set_count, serial && serial[0] ? serial : i1d3_device_path(devs[i]));
+        if (!targets[i]) goto done;
+        i1d3_device_get_matrix(devs[i], targets[i]->matrix);
+    }
+
+    for (int p = 0; p < n; p++) {
+        if (emulated) {
+            panel.patch = p;
+        } else {
+            printf("[PATCH %d/%d] Show the next patch and press Enter...", p + 1, n);
+            fflush(stdout);
+            int ch;
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+        }
+        // All sensors integrate over the same interval
+        i1d3_color_results res[MAX_SENSORS];
+        i1d3_error_t error = I1D3_SUCCESS;
+        for (int i = 0; i < count && error == I1D3_SUCCESS; i++) error = i1d3_measure_start(i1d3_device_fd(devs[i]));
+        for (int i = 0; i < count && error == I1D3_SUCCESS; i++) error = i1d3_measure_collect(i1d3_device_fd(devs[i]), &res[i]);
+        if (error != I1D3_SUCCESS) {
+            printf("[FATAL] Patch %d failed: %s\n", p + 1, i1d3_error_string(error));
+            goto done;
+        }
+        double ref[3] = {res[0].X, res[0].Y, res[0].Z};
+        for (int i = 1; i < count; i++) {
+            double meas[3] = {res[i].X, res[i].Y, res[i].Z};
+            if (!add_sample(targets[i], ref, meas)) goto done;
+            if (save) {
+                fprintf(save, "%s %.6f %.6f %.6f %.6f %.6f %.6f\n", targets[i]->id,
+                        ref[0], ref[1], ref[2], meas[0], meas[1], meas[2]);
+            }
+        }
+    }
+    result = 0;
+
+done:
+    for (int i = 0; i < count; i++) {
+        if (devs[i]) i1d3_device_close(devs[i]);
+        i1d3_emulator_destroy(emus[i]);
+    }
+    return result;
+}
+
+// --- Output ---
+
+static void print_matrix(const char *name, const double m[3][3]) {
+    printf("static const double %s[3][3] = {\n", name);
+    for (int r = 0; r < 3; r++) printf("    {%.9f, %.9f, %.9f},\n", m[r][0], m[r][1], m[r][2]);
+    printf("};\n");
+}
+
+static int fit_set(const sensor_set *set, int flags) {
+    i1d3_fcmm_fit fit;
+    i1d3_error_t error = i1d3_fcmm_solve(set->samples, set->count, flags, &fit);
+    if (error != I1D3_SUCCESS) {
+        printf("[ERROR] %s: %d samples do not determine a fit (too few, or not independent)\n", set->id, set->count);
+        return -1;
+    }
+    printf("[FIT ] %s: %d samples, rms %.4f, max du'v' %.5f\n", set->id, fit.count, fit.rms, fit.max_duv);
+    print_matrix("CORRECTION", (const double (*)[3])fit.matrix);
+    if (flags & I1D3_FCMM_OFFSET) {
+        printf("static const double OFFSET[3] = {%.6f, %.6f, %.6f};\n", fit.offset[0], fit.offset[1], fit.offset[2]);
+    } else {
+        // Folded into the raw frequency matrix: paste as MATRIX or pass to i1d3_device_set_matrix()
+        double m[3][3];
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) {
+                m[r][c] = fit.matrix[r][0] * set->matrix[0][c] + fit.matrix[r][1] * set->matrix[1][c]
+                        + fit.matrix[r][2] * set->matrix[2][c];
+            }
+        }
+        print_matrix("MATRIX", (const double (*)[3])m);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *file = NULL, *save_path = NULL;
+    const char *paths[MAX_SENSORS];
+    int path_count = 0, patches = 0, emulated = 0, flags = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "--offset") == 0) {
+            flags |= I1D3_FCMM_OFFSET;
+        } else if (strcmp(argv[i], "--relative") == 0) {
+            flags |= I1D3_FCMM_RELATIVE;
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            patches = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--emulate") == 0 && i + 1 < argc) {
+            emulated = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            save_path = argv[++i];
+        } else if (patches > 0 && path_count < MAX_SENSORS) {
+            paths[path_count++] = argv[i];
+        } else if (!file && patches == 0) {
+            file = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    bool capturing = patches > 0 && (emulated > 0 || path_count >= 2);
+    if (!capturing && (!file || patches > 0 || emulated > 0)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (emulated >= MAX_SENSORS) {
+        printf("[FATAL] At most %d emulated targets\n", MAX_SENSORS - 1);
+        return 1;
+    }
+
+    sensor_set *sets = calloc(MAX_SETS, sizeof(*sets));
+    int set_count = 0, result = 0;
+    if (!sets) return 1;
+
+    if (capturing) {
+        FILE *save = save_path ? fopen(save_path, "w") : NULL;
+        if (save_path && !save) {
+            printf("[FATAL] Cannot write %s\n", save_path);
+            free(sets);
+            return 1;
+        }
+        if (save) fprintf(save, "# id Xref Yref Zref X Y Z\n");
+        int count = emulated > 0 ? emulated + 1 : path_count;
+        printf("[SYS] Capturing %d patches with %d target(s)...\n", patches, count - 1);
+        result = capture(patches, emulated > 0, emulated > 0 ? NULL : paths, count, save, sets, &set_count);
+        if (save) fclose(save);
+    } else {
+        result = load_file(file, sets, &set_count);
+    }
+
+    int failed = 0;
+    for (int i = 0; result == 0 && i < set_count; i++) {
+        if (fit_set(&sets[i], flags) < 0) failed++;
+    }
+    if (result == 0) printf("[SYS] %d sensor(s) fitted, %d failed\n", set_count - failed, failed);
+
+    for (int i = 0; i < set_count; i++) free(sets[i].samples);
+    free(sets);
+    return (result == 0 && failed == 0) ? 0 : 1;
+}
@@ -1,13 +1,107 @@
 /* ver:2026_01_13__10_00 - Updated for enhanced error handling */
 #include <stdio.h>
-#include <unistd.h>
+#include <string.h>
+#include <poll.h>
 #include "i1d3.h"
 
-int main(void) {
-    const char *dev = "/dev/hidraw0";
-    int fd = i1d3_open(dev);
+static void usage(const char *prog) {
+    printf("Usage: %s [--list | --watch] [--emulate] [--stats] [device]\n", prog);
+    printf("  device     hidraw node of the sensor (default: first one found)\n");
+    printf("  --list     list connected sensors and exit\n");
+    printf("  --watch    report sensors being plugged in and out until interrupted\n");
+    printf("  --emulate  run against the built-in software i1Display3\n");
+    printf("  --stats    print per-operation counters and latencies at exit\n");
+}
+
+static int list_sensors(void) {
+    i1d3_device_info info[16];
+    int n = i1d3_discover(info, 16);
+    if (n < 0) {
+        printf("[FATAL] Discovery failed: %s\n", i1d3_error_string(n));
+        return 1;
+    }
+    for (int i = 0; i < n && i < 16; i++) {
+        printf("%s  %04x:%04x  serial=%s  %s\n", info[i].path, info[i].vendor_id, info[i].product_id,
+               info[i].serial[0] ? info[i].serial : "-", info[i].name);
+    }
+    printf("[SYS] %d sensor(s) found\n", n);
+    return 0;
+}
+
+static int watch_sensors(void) {
+    i1d3_error_t error;
+    i1d3_monitor *mon = i1d3_monitor_create(&error);
+    if (!mon) {
+        printf("[FATAL] Hotplug monitor failed: %s\n", i1d3_error_string(error));
+        return 1;
+    }
+    printf("[SYS] Watching for sensors (Ctrl-C to stop)...\n");
+    struct pollfd pfd = {i1d3_monitor_fd(mon), POLLIN, 0};
+    while (poll(&pfd, 1, -1) >= 0) {
+        i1d3_hotplug_event event;
+        int ready;
+        while ((ready = i1d3_monitor_read(mon, &event)) > 0) {
+            if (event.action == I1D3_HOTPLUG_ADD) {
+                printf("[ADD] %s serial=%s\n", event.info.path, event.info.serial[0] ? event.info.serial : "-");
+            } else {
+                printf("[REMOVE] %s\n", event.info.path);
+            }
+            fflush(stdout);
+        }
+        if (ready < 0) {
+            printf("[ERROR] %s\n", i1d3_error_string(ready));
+            break;
+        }
+    }
+    i1d3_monitor_destroy(mon);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *dev = NULL;
+    bool emulate = false;
+    bool print_stats = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "--list") == 0) {
+            return list_sensors();
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            return watch_sensors();
+        } else if (strcmp(argv[i], "--emulate") == 0) {
+            emulate = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            print_stats = true;
+        } else {
+            dev = argv[i];
+        }
+    }
+
+    i1d3_emulator *emu = NULL;
+    int fd;
+    if (emulate) {
+        i1d3_error_t error;
+        emu = i1d3_emulator_create(NULL);
+        i1d3_device *handle = emu ? i1d3_emulator_open(emu, I1D3_TRANSPORT_INPROC, &error) : NULL;
+        fd = handle ? i1d3_device_fd(handle) : (emu ? error : I1D3_ERROR_OPEN_FAILED);
+        dev = "emulator";
+    } else {
+        i1d3_device_info found;
+        if (!dev) {
+            int n = i1d3_discover(&found, 1);
+            if (n <= 0) {
+                printf("[FATAL] No i1Display3 found: %s\n", n < 0 ? i1d3_error_string(n) : "is it plugged in?");
+                return 1;
+            }
+            dev = found.path;
+        }
+        fd = i1d3_open(dev);
+    }
     if (fd < 0) {
         printf("[FATAL] Failed to open device %s: %s\n", dev, i1d3_error_string(fd));
+        i1d3_emulator_destroy(emu);
         return 1;
     }
 
@@ -16,6 +110,7 @@ int main(void) {
     if (result != I1D3_SUCCESS) {
         printf("[FATAL] Initialization failed: %s\n", i1d3_error_string(result));
         i1d3_close(fd);
+        i1d3_emulator_destroy(emu);
         return 1;
     }
 
@@ -24,23 +119,26 @@ int main(void) {
     if (result != I1D3_SUCCESS) {
         printf("[FATAL] Auto-unlock failed: %s\n", i1d3_error_string(result));
         i1d3_close(fd);
+        i1d3_emulator_destroy(emu);
         return 1;
     }
 
-    printf("[SYS] Taking measurements (3 times)...\n");
-    i1d3_color_results res;
-    for (int i = 0; i < 3; i++) {
-        result = i1d3_aio_measure(fd, &res);
-        if (result == I1D3_SUCCESS) {
-            printf("[%d] XYZ: %.2f, %.2f, %.2f | xy: %.4f, %.4f | CCT: %.0fK | Lab: %.1f, %.1f, %.1f\n", 
-                   i+1, res.X, res.Y, res.Z, res.x, res.y, res.CCT, res.L, res.a, res.b);
-        } else {
-            printf("[%d] Measurement failed: %s\n", i+1, i1d3_error_string(result));
-        }
-        sleep(1);
+    printf("[SYS] Taking measurements (batch of 3)...\n");
+    i1d3_batch_stats stats;
+    result = i1d3_measure_batch(i1d3_device_from_fd(fd), 3, NULL, &stats);
+    if (result == I1D3_SUCCESS) {
+        i1d3_color_results *res = &stats.mean;
+        printf("[MEAN] XYZ: %.2f, %.2f, %.2f | xy: %.4f, %.4f | CCT: %.0fK Duv: %+.4f | Lab: %.1f, %.1f, %.1f\n",
+               res->X, res->Y, res->Z, res->x, res->y, res->CCT, res->Duv, res->L, res->a, res->b);
+        printf("[STD ] XYZ: %.3f, %.3f, %.3f | %d used, %d rejected, %.0f ms\n",
+               stats.std[0], stats.std[1], stats.std[2], stats.count, stats.rejected, stats.elapsed_ms);
+    } else {
+        printf("[ERROR] Measurement failed: %s\n", i1d3_error_string(result));
     }
 
     i1d3_close(fd);
+    i1d3_emulator_destroy(emu);
+    if (print_stats) i1d3_print_stats();
     printf("[SYS] Finished.\n");
     return 0;
 }